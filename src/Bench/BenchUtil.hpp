@@ -0,0 +1,161 @@
+#pragma once
+
+#include <Common/defines.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Helpers shared by the benchmark executables: option parsing, timing and the
+// JSON report. Each bench supplies its own options, workloads and columns.
+namespace Bench
+{
+    // Splits a comma-separated list, skipping empty items.
+    inline std::vector<std::string> SplitList(const char* list)
+    {
+        std::vector<std::string> items;
+        std::string item;
+        for (const char* c = list;; ++c)
+        {
+            if (*c == ',' || *c == '\0')
+            {
+                if (!item.empty())
+                {
+                    items.push_back(item);
+                }
+                item.clear();
+                if (*c == '\0')
+                {
+                    break;
+                }
+            }
+            else
+            {
+                item += *c;
+            }
+        }
+        return items;
+    }
+
+    inline std::vector<i32> ParseInts(const char* list)
+    {
+        std::vector<i32> values;
+        for (const std::string& item : SplitList(list))
+        {
+            values.push_back(atoi(item.c_str()));
+        }
+        return values;
+    }
+
+    // Prints error (if any) and the usage text to stderr and exits, with
+    // failure if there was an error.
+    [[noreturn]] inline void Usage(const char* program, const char* usage, const char* error)
+    {
+        if (error)
+        {
+            fprintf(stderr, "%s: %s\n", program, error);
+        }
+        fputs(usage, stderr);
+        exit(error ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+
+    // Walks "--option value" pairs. --help / -h and a missing value end in
+    // usage(); parse(arg, value) handles one option and returns false for an
+    // unknown one.
+    template <typename UsageFn, typename ParseFn>
+    void ParseArgs(i32 argc, char** argv, UsageFn usage, ParseFn parse)
+    {
+        for (i32 i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--help" || arg == "-h")
+            {
+                usage(nullptr);
+            }
+            if (i + 1 >= argc)
+            {
+                usage(("missing value for " + arg).c_str());
+            }
+            if (!parse(arg, argv[++i]))
+            {
+                usage(("unknown option " + arg).c_str());
+            }
+        }
+    }
+
+    // Median seconds per call of fn over five batches, each sized to take about
+    // a fifth of minTime, after one warm-up call. Reports the calls made.
+    inline f64 TimeCalls(const std::function<void()>& fn, f64 minTime, u64& calls)
+    {
+        using Clock = std::chrono::steady_clock;
+        auto seconds = [](Clock::time_point start) { return std::chrono::duration<f64>(Clock::now() - start).count(); };
+
+        fn();
+        auto start = Clock::now();
+        fn();
+        f64 once = std::max(seconds(start), 1e-9);
+        u64 batch = std::max<u64>(1, (u64)(minTime / 5.0 / once));
+
+        std::vector<f64> perCall;
+        calls = 2;
+        for (i32 b = 0; b < 5; ++b)
+        {
+            start = Clock::now();
+            for (u64 i = 0; i < batch; ++i)
+            {
+                fn();
+            }
+            perCall.push_back(seconds(start) / batch);
+            calls += batch;
+        }
+        std::sort(perCall.begin(), perCall.end());
+        return perCall[perCall.size() / 2];
+    }
+
+    // Where the results table goes: stderr when the JSON report is written to
+    // stdout ("--json -"), so that stdout parses.
+    inline FILE* TableStream(const std::string& jsonPath)
+    {
+        return jsonPath == "-" ? stderr : stdout;
+    }
+
+    // Writes {"benchmark": program, "format_version": 1, ..., "results": [...]}
+    // to path, or to stdout for "-". fields(out) writes the bench's own
+    // top-level fields, each line ending in ",\n"; result(out, r) writes
+    // result r as one object, without separator or newline. Returns false, after
+    // saying so, if path cannot be written.
+    template <typename FieldsFn, typename ResultFn>
+    bool WriteJson(const std::string& path, const char* program, size_t resultCount, FieldsFn fields,
+                   ResultFn result)
+    {
+        FILE* out = path == "-" ? stdout : fopen(path.c_str(), "w");
+        if (out == nullptr)
+        {
+            fprintf(stderr, "%s: cannot write %s\n", program, path.c_str());
+            return false;
+        }
+
+        fprintf(out, "{\n");
+        fprintf(out, "  \"benchmark\": \"%s\",\n", program);
+        fprintf(out, "  \"format_version\": 1,\n");
+        fields(out);
+        fprintf(out, "  \"results\": [\n");
+        for (size_t r = 0; r < resultCount; ++r)
+        {
+            fprintf(out, "    ");
+            result(out, r);
+            fprintf(out, "%s\n", r + 1 < resultCount ? "," : "");
+        }
+        fprintf(out, "  ]\n");
+        fprintf(out, "}\n");
+
+        if (out != stdout)
+        {
+            fclose(out);
+        }
+        return true;
+    }
+}
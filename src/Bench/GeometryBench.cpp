@@ -0,0 +1,414 @@
+// geometry_bench: cost of procedural mesh generation in GeometryGenerator, and
+// how much of it goes to the heap.
+//
+//   geometry_bench [--shapes box,sphere,geosphere,cylinder,grid] [--detail low,high]
+//                  [--modes mesh,span] [--threads 1,2] [--count N] [--min-time 0.25]
+//                  [--json results.json]
+//
+// Each call generates a batch of --count shapes (default 1000 at low detail,
+// 4 at high detail):
+//   mesh  the MeshData overloads, each shape in vectors of its own that are
+//         freed again before the next one;
+//   span  the Span overloads, writing the whole batch back to back into one
+//         arena allocated before timing.
+//
+// Allocations are counted by replacing the global operator new for the whole
+// program; the count covers one batch after a warm-up batch, so the edge
+// table the Span overloads keep in the generator has already grown (the
+// MeshData overloads subdivide with a table of their own per shape).
+//
+// Grids above GridBlockVertices vertices are built across the JobSystem, whose
+// ParallelFor queues (and so allocates) jobs once the pool has workers. The
+// grid runs once per --threads count (default 1 and the hardware, at least 2),
+// resizing the pool in between; the other shapes do not use the pool and run
+// once, at the first count.
+//
+// --json - writes the JSON to stdout and moves the table to stderr.
+
+#include <Bench/BenchUtil.hpp>
+#include <Common/GeometryGenerator.hpp>
+#include <Common/JobSystem.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    std::atomic<u64> gAllocations{ 0 };
+    std::atomic<u64> gAllocatedBytes{ 0 };
+
+    void* CountedAllocate(size_t bytes, size_t alignment)
+    {
+        gAllocations.fetch_add(1, std::memory_order_relaxed);
+        gAllocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+        void* data = nullptr;
+        if (alignment <= alignof(std::max_align_t))
+        {
+            data = malloc(bytes ? bytes : 1);
+        }
+        else
+        {
+            // aligned_alloc wants a multiple of the alignment.
+            data = aligned_alloc(alignment, (bytes + alignment - 1) / alignment * alignment);
+        }
+        if (data == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return data;
+    }
+}
+
+void* operator new(size_t bytes) { return CountedAllocate(bytes, alignof(std::max_align_t)); }
+void* operator new(size_t bytes, std::align_val_t alignment) { return CountedAllocate(bytes, (size_t)alignment); }
+void operator delete(void* data) noexcept { free(data); }
+void operator delete(void* data, size_t) noexcept { free(data); }
+void operator delete(void* data, std::align_val_t) noexcept { free(data); }
+void operator delete(void* data, size_t, std::align_val_t) noexcept { free(data); }
+
+namespace
+{
+    enum class Shape
+    {
+        Box,
+        Sphere,
+        Geosphere,
+        Cylinder,
+        Grid
+    };
+
+    const Shape AllShapes[] = { Shape::Box, Shape::Sphere, Shape::Geosphere, Shape::Cylinder, Shape::Grid };
+
+    const char* ShapeName(Shape shape)
+    {
+        switch (shape)
+        {
+            case Shape::Box: return "box";
+            case Shape::Sphere: return "sphere";
+            case Shape::Geosphere: return "geosphere";
+            case Shape::Cylinder: return "cylinder";
+            case Shape::Grid: return "grid";
+        }
+        return "?";
+    }
+
+    // Tessellation of one shape: subdivisions for box and geosphere, slices and
+    // stacks for sphere and cylinder, rows and columns for grid.
+    struct Detail
+    {
+        std::string Name;
+        u32 Subdivisions;
+        u32 Slices;
+        u32 Stacks;
+        u32 GridSize;
+        u32 Count;
+    };
+
+    const Detail LowDetail = { "low", 2, 16, 16, 16, 1000 };
+    const Detail HighDetail = { "high", 6, 256, 128, 512, 4 };
+
+    struct Options
+    {
+        std::vector<Shape> Shapes = { std::begin(AllShapes), std::end(AllShapes) };
+        std::vector<Detail> Details = { LowDetail, HighDetail };
+        std::vector<std::string> Modes = { "mesh", "span" };
+        std::vector<i32> Threads;
+        u32 Count = 0;
+        f64 MinTime = 0.25;
+        std::string JsonPath;
+    };
+
+    struct Result
+    {
+        Shape Kind = Shape::Box;
+        std::string DetailName;
+        std::string Mode;
+        i32 Threads = 0;
+        u32 Count = 0;
+        size_t VertexCount = 0;
+        size_t IndexCount = 0;
+        u64 Calls = 0;
+        f64 SecondsPerCall = 0.0;
+        f64 AllocationsPerShape = 0.0;
+        f64 AllocatedBytesPerShape = 0.0;
+    };
+
+    const char* const UsageText =
+        "usage: geometry_bench [--shapes box,sphere,geosphere,cylinder,grid] [--detail low,high]\n"
+        "                      [--modes mesh,span] [--threads N,...] [--count N] [--min-time seconds]\n"
+        "                      [--json path|-]\n";
+
+    [[noreturn]] void Usage(const char* error)
+    {
+        Bench::Usage("geometry_bench", UsageText, error);
+    }
+
+    Options ParseOptions(i32 argc, char** argv)
+    {
+        Options options;
+        Bench::ParseArgs(argc, argv, Usage, [&options](const std::string& arg, const char* value)
+        {
+            if (arg == "--shapes")
+            {
+                options.Shapes.clear();
+                for (const std::string& name : Bench::SplitList(value))
+                {
+                    bool found = false;
+                    for (Shape shape : AllShapes)
+                    {
+                        if (name == ShapeName(shape))
+                        {
+                            options.Shapes.push_back(shape);
+                            found = true;
+                        }
+                    }
+                    if (!found)
+                    {
+                        Usage(("unknown shape " + name).c_str());
+                    }
+                }
+            }
+            else if (arg == "--detail")
+            {
+                options.Details.clear();
+                for (const std::string& name : Bench::SplitList(value))
+                {
+                    if (name == LowDetail.Name)
+                    {
+                        options.Details.push_back(LowDetail);
+                    }
+                    else if (name == HighDetail.Name)
+                    {
+                        options.Details.push_back(HighDetail);
+                    }
+                    else
+                    {
+                        Usage(("unknown detail " + name).c_str());
+                    }
+                }
+            }
+            else if (arg == "--modes")
+            {
+                options.Modes = Bench::SplitList(value);
+                for (const std::string& mode : options.Modes)
+                {
+                    if (mode != "mesh" && mode != "span")
+                    {
+                        Usage(("unknown mode " + mode).c_str());
+                    }
+                }
+            }
+            else if (arg == "--threads")
+            {
+                options.Threads = Bench::ParseInts(value);
+            }
+            else if (arg == "--count")
+            {
+                options.Count = (u32)std::max(1, atoi(value));
+            }
+            else if (arg == "--min-time")
+            {
+                options.MinTime = atof(value);
+            }
+            else if (arg == "--json")
+            {
+                options.JsonPath = value;
+            }
+            else
+            {
+                return false;
+            }
+            return true;
+        });
+
+        // Without workers the grid never reaches the job system, so the
+        // default always includes a pool that has some.
+        if (options.Threads.empty())
+        {
+            options.Threads = { 1, (i32)std::max(2u, std::thread::hardware_concurrency()) };
+        }
+        for (i32 threads : options.Threads)
+        {
+            if (threads < 1)
+            {
+                Usage("thread counts must be at least 1");
+            }
+        }
+        return options;
+    }
+
+    GeometryGenerator::MeshSize ShapeSize(Shape shape, const Detail& detail)
+    {
+        switch (shape)
+        {
+            case Shape::Box: return GeometryGenerator::BoxSize(detail.Subdivisions);
+            case Shape::Sphere: return GeometryGenerator::SphereSize(detail.Slices, detail.Stacks);
+            case Shape::Geosphere: return GeometryGenerator::GeosphereSize(detail.Subdivisions);
+            case Shape::Cylinder: return GeometryGenerator::CylinderSize(detail.Slices, detail.Stacks);
+            case Shape::Grid: return GeometryGenerator::GridSize(detail.GridSize, detail.GridSize);
+        }
+        return {};
+    }
+
+    // Generates the shape through the MeshData overloads; returns its vertex
+    // count so the work cannot be optimized away.
+    size_t CreateMesh(GeometryGenerator& generator, Shape shape, const Detail& detail)
+    {
+        switch (shape)
+        {
+            case Shape::Box: return generator.CreateBox(1.0f, 1.0f, 1.0f, detail.Subdivisions).Vertices.size();
+            case Shape::Sphere: return generator.CreateSphere(1.0f, detail.Slices, detail.Stacks).Vertices.size();
+            case Shape::Geosphere: return generator.CreateGeosphere(1.0f, detail.Subdivisions).Vertices.size();
+            case Shape::Cylinder:
+                return generator.CreateCylinder(0.5f, 0.3f, 3.0f, detail.Slices, detail.Stacks).Vertices.size();
+            case Shape::Grid:
+                return generator.CreateGrid(100.0f, 100.0f, detail.GridSize, detail.GridSize).Vertices.size();
+        }
+        return 0;
+    }
+
+    void CreateInto(GeometryGenerator& generator, Shape shape, const Detail& detail,
+        Span<GeometryGenerator::Vertex> vertices, Span<u32> indices)
+    {
+        switch (shape)
+        {
+            case Shape::Box: generator.CreateBox(1.0f, 1.0f, 1.0f, detail.Subdivisions, vertices, indices); break;
+            case Shape::Sphere: generator.CreateSphere(1.0f, detail.Slices, detail.Stacks, vertices, indices); break;
+            case Shape::Geosphere: generator.CreateGeosphere(1.0f, detail.Subdivisions, vertices, indices); break;
+            case Shape::Cylinder:
+                generator.CreateCylinder(0.5f, 0.3f, 3.0f, detail.Slices, detail.Stacks, vertices, indices);
+                break;
+            case Shape::Grid:
+                generator.CreateGrid(100.0f, 100.0f, detail.GridSize, detail.GridSize, vertices, indices);
+                break;
+        }
+    }
+
+    void Run(Shape shape, const Detail& detail, const std::string& mode, i32 threads, u32 count, f64 minTime,
+        Result& result)
+    {
+        GeometryGenerator::MeshSize size = ShapeSize(shape, detail);
+        result.Kind = shape;
+        result.DetailName = detail.Name;
+        result.Mode = mode;
+        result.Threads = threads;
+        result.Count = count;
+        result.VertexCount = size.VertexCount;
+        result.IndexCount = size.IndexCount;
+
+        GeometryGenerator generator;
+        std::vector<GeometryGenerator::Vertex> vertexArena;
+        std::vector<u32> indexArena;
+        volatile size_t sink = 0;
+
+        std::function<void()> batch;
+        if (mode == "mesh")
+        {
+            batch = [&]
+            {
+                for (u32 i = 0; i < count; ++i)
+                {
+                    sink = sink + CreateMesh(generator, shape, detail);
+                }
+            };
+        }
+        else
+        {
+            vertexArena.resize(count * size.VertexCount);
+            indexArena.resize(count * size.IndexCount);
+            batch = [&]
+            {
+                for (u32 i = 0; i < count; ++i)
+                {
+                    Span<GeometryGenerator::Vertex> vertices(vertexArena.data() + i * size.VertexCount, size.VertexCount);
+                    Span<u32> indices(indexArena.data() + i * size.IndexCount, size.IndexCount);
+                    CreateInto(generator, shape, detail, vertices, indices);
+                }
+            };
+        }
+
+        batch();
+        u64 allocations = gAllocations.load();
+        u64 bytes = gAllocatedBytes.load();
+        batch();
+        result.AllocationsPerShape = (f64)(gAllocations.load() - allocations) / count;
+        result.AllocatedBytesPerShape = (f64)(gAllocatedBytes.load() - bytes) / count;
+
+        result.SecondsPerCall = Bench::TimeCalls(batch, minTime, result.Calls);
+    }
+
+    bool WriteJson(const Options& options, const std::vector<Result>& results)
+    {
+        auto fields = [&options](FILE* out)
+        {
+            fprintf(out, "  \"min_time_s\": %g,\n", options.MinTime);
+            fprintf(out, "  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+        };
+        auto result = [&results](FILE* out, size_t r)
+        {
+            const Result& result = results[r];
+            f64 nsPerShape = result.SecondsPerCall * 1e9 / result.Count;
+            fprintf(out,
+                "{\"shape\": \"%s\", \"detail\": \"%s\", \"mode\": \"%s\", \"threads\": %d, "
+                "\"shapes_per_call\": %u, "
+                "\"vertices\": %llu, \"indices\": %llu, \"calls\": %llu, \"ns_per_shape\": %.1f, "
+                "\"ns_per_vertex\": %.3f, \"allocations_per_shape\": %.3f, \"allocated_bytes_per_shape\": %.1f}",
+                ShapeName(result.Kind), result.DetailName.c_str(), result.Mode.c_str(), result.Threads, result.Count,
+                (unsigned long long)result.VertexCount, (unsigned long long)result.IndexCount,
+                (unsigned long long)result.Calls, nsPerShape, nsPerShape / result.VertexCount,
+                result.AllocationsPerShape, result.AllocatedBytesPerShape);
+        };
+        return Bench::WriteJson(options.JsonPath, "geometry_bench", results.size(), fields, result);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options = ParseOptions(argc, argv);
+
+    FILE* table = Bench::TableStream(options.JsonPath);
+    fprintf(table, "%-10s %-6s %-5s %7s %6s %9s %14s %10s %12s %14s\n", "shape", "detail", "mode", "threads", "count",
+        "vertices", "ns/shape", "ns/vertex", "allocs/shape", "bytes/shape");
+
+    std::vector<Result> results;
+    for (const Detail& detail : options.Details)
+    {
+        for (Shape shape : options.Shapes)
+        {
+            for (const std::string& mode : options.Modes)
+            {
+                size_t threadRuns = shape == Shape::Grid ? options.Threads.size() : 1;
+                for (size_t t = 0; t < threadRuns; ++t)
+                {
+                    i32 threads = options.Threads[t];
+                    JobSystem::ResizeGlobal((u32)threads);
+
+                    Result result;
+                    Run(shape, detail, mode, threads, options.Count ? options.Count : detail.Count, options.MinTime,
+                        result);
+
+                    f64 nsPerShape = result.SecondsPerCall * 1e9 / result.Count;
+                    fprintf(table, "%-10s %-6s %-5s %7d %6u %9llu %14.1f %10.3f %12.2f %14.1f\n", ShapeName(shape),
+                        detail.Name.c_str(), mode.c_str(), threads, result.Count,
+                        (unsigned long long)result.VertexCount, nsPerShape, nsPerShape / result.VertexCount,
+                        result.AllocationsPerShape, result.AllocatedBytesPerShape);
+                    fflush(table);
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+
+    if (!options.JsonPath.empty() && !WriteJson(options, results))
+    {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
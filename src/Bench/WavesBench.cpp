@@ -0,0 +1,483 @@
+// waves_bench: throughput of the Waves simulation across grid sizes, thread
+// counts, storage modes and update pipelines.
+//
+//   waves_bench [--sizes 128,256,512,1024,2048] [--threads 1,2,4] [--storage planar,half]
+//               [--pipeline twopass,fused] [--workloads update,normals] [--isa scalar|sse|avx2]
+//               [--min-time 0.25] [--pages heap|pages|thp|hugetlb] [--json results.json]
+//
+// Workloads (each on a grid that has been disturbed and stepped for a while):
+//   update           Waves::Update by one time step (stencil + normal pass), once
+//                    per --pipeline; the other workloads do not depend on it.
+//   normals          The normal pass alone (Waves::UpdateNormals).
+//   disturb          Waves::Disturb at scattered interior points.
+//   write_vertices   Full Waves::WriteVertices into a vertex array.
+//   write_heightmap  Full Waves::WriteHeightmap, R16F heights + octahedral normals.
+//
+// For every run the table and the JSON report the time per call, ns per item
+// (grid cell, or impulse for disturb), GB/s over the bytes the workload moves
+// and the scaling efficiency against the first thread count of the same case
+// (1 unless --threads starts elsewhere).
+// The byte counts are models of DRAM traffic. update counts the stencil's
+// reads of the two height planes and write of the next one, plus the normal
+// pass's normals and tangents written; the two-pass pipeline also reads the
+// new height plane back in its second sweep, which the fused one finds in
+// cache. normals counts the height plane read plus the normals written, the
+// output workloads the bytes stored.
+//
+// --pages moves the simulation state to the given PagePolicy before timing;
+// the table's tlb column and the JSON report the translations (base plus huge
+// pages) needed to cover the resident state, see Waves::StatePageStats.
+//
+// --json - writes the JSON to stdout and moves the table to stderr.
+
+#include <Bench/BenchUtil.hpp>
+#include <Common/JobSystem.hpp>
+#include <Common/Waves.hpp>
+#include <Common/WavesKernels.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        std::vector<i32> Sizes = { 128, 256, 512, 1024, 2048 };
+        std::vector<i32> Threads;
+        std::vector<WavesStorage> Storages = { WavesStorage::Interleaved, WavesStorage::Planar,
+                                               WavesStorage::Half, WavesStorage::Fixed16 };
+        std::vector<WavesPipeline> Pipelines = { WavesPipeline::TwoPass, WavesPipeline::Fused };
+        std::vector<std::string> Workloads = { "update", "normals", "disturb", "write_vertices", "write_heightmap" };
+        WavesKernels::Isa Isa = WavesKernels::BestIsa();
+        f64 MinTime = 0.25;
+        PagePolicy Pages = PagePolicy::Heap;
+        std::string JsonPath;
+    };
+
+    struct Result
+    {
+        std::string Workload;
+        WavesStorage Storage = WavesStorage::Planar;
+        WavesPipeline Pipeline = WavesPipeline::TwoPass;
+        i32 Size = 0;
+        i32 Threads = 0;
+        u64 Calls = 0;
+        f64 SecondsPerCall = 0.0;
+        f64 ItemsPerCall = 0.0;
+        f64 BytesPerCall = 0.0;
+        f64 ScalingEfficiency = 0.0;
+        u64 TlbEntries = 0;
+        u64 HugePageBytes = 0;
+    };
+
+    const char* StorageName(WavesStorage storage)
+    {
+        switch (storage)
+        {
+            case WavesStorage::Interleaved: return "interleaved";
+            case WavesStorage::Planar: return "planar";
+            case WavesStorage::Half: return "half";
+            case WavesStorage::Fixed16: return "fixed16";
+        }
+        return "?";
+    }
+
+    const char* PipelineName(WavesPipeline pipeline)
+    {
+        switch (pipeline)
+        {
+            case WavesPipeline::TwoPass: return "twopass";
+            case WavesPipeline::Fused: return "fused";
+        }
+        return "?";
+    }
+
+    const char* PagePolicyName(PagePolicy policy)
+    {
+        switch (policy)
+        {
+            case PagePolicy::Heap: return "heap";
+            case PagePolicy::Pages: return "pages";
+            case PagePolicy::TransparentHuge: return "thp";
+            case PagePolicy::HugeTlb: return "hugetlb";
+        }
+        return "?";
+    }
+
+    const char* const UsageText =
+        "usage: waves_bench [--sizes N,...] [--threads N,...] [--storage interleaved,planar,half,fixed16]\n"
+        "                   [--pipeline twopass,fused]\n"
+        "                   [--workloads update,normals,disturb,write_vertices,write_heightmap]\n"
+        "                   [--isa scalar|sse|avx2] [--min-time seconds] [--pages heap|pages|thp|hugetlb]\n"
+        "                   [--json path|-]\n";
+
+    [[noreturn]] void Usage(const char* error)
+    {
+        Bench::Usage("waves_bench", UsageText, error);
+    }
+
+    Options ParseOptions(i32 argc, char** argv)
+    {
+        Options options;
+        Bench::ParseArgs(argc, argv, Usage, [&options](const std::string& arg, const char* value)
+        {
+            if (arg == "--sizes")
+            {
+                options.Sizes = Bench::ParseInts(value);
+            }
+            else if (arg == "--threads")
+            {
+                options.Threads = Bench::ParseInts(value);
+            }
+            else if (arg == "--storage")
+            {
+                options.Storages.clear();
+                for (const std::string& name : Bench::SplitList(value))
+                {
+                    WavesStorage storage = WavesStorage::Interleaved;
+                    bool found = false;
+                    for (WavesStorage candidate : { WavesStorage::Interleaved, WavesStorage::Planar,
+                                                    WavesStorage::Half, WavesStorage::Fixed16 })
+                    {
+                        if (name == StorageName(candidate))
+                        {
+                            storage = candidate;
+                            found = true;
+                        }
+                    }
+                    if (!found)
+                    {
+                        Usage(("unknown storage mode " + name).c_str());
+                    }
+                    options.Storages.push_back(storage);
+                }
+            }
+            else if (arg == "--pipeline")
+            {
+                options.Pipelines.clear();
+                for (const std::string& name : Bench::SplitList(value))
+                {
+                    WavesPipeline pipeline = WavesPipeline::TwoPass;
+                    bool found = false;
+                    for (WavesPipeline candidate : { WavesPipeline::TwoPass, WavesPipeline::Fused })
+                    {
+                        if (name == PipelineName(candidate))
+                        {
+                            pipeline = candidate;
+                            found = true;
+                        }
+                    }
+                    if (!found)
+                    {
+                        Usage(("unknown pipeline " + name).c_str());
+                    }
+                    options.Pipelines.push_back(pipeline);
+                }
+                if (options.Pipelines.empty())
+                {
+                    Usage("--pipeline needs at least one pipeline");
+                }
+            }
+            else if (arg == "--workloads")
+            {
+                options.Workloads = Bench::SplitList(value);
+            }
+            else if (arg == "--isa")
+            {
+                std::string name = value;
+                if (name == "scalar")
+                {
+                    options.Isa = WavesKernels::Isa::Scalar;
+                }
+                else if (name == "sse")
+                {
+                    options.Isa = WavesKernels::Isa::SSE;
+                }
+                else if (name == "avx2")
+                {
+                    options.Isa = WavesKernels::Isa::AVX2;
+                }
+                else
+                {
+                    Usage(("unknown isa " + name).c_str());
+                }
+            }
+            else if (arg == "--min-time")
+            {
+                options.MinTime = atof(value);
+            }
+            else if (arg == "--pages")
+            {
+                std::string name = value;
+                bool found = false;
+                for (PagePolicy policy : { PagePolicy::Heap, PagePolicy::Pages, PagePolicy::TransparentHuge,
+                                           PagePolicy::HugeTlb })
+                {
+                    if (name == PagePolicyName(policy))
+                    {
+                        options.Pages = policy;
+                        found = true;
+                    }
+                }
+                if (!found)
+                {
+                    Usage(("unknown page policy " + name).c_str());
+                }
+            }
+            else if (arg == "--json")
+            {
+                options.JsonPath = value;
+            }
+            else
+            {
+                return false;
+            }
+            return true;
+        });
+
+        // Powers of two up to the hardware, plus the hardware count itself.
+        if (options.Threads.empty())
+        {
+            i32 hardware = (i32)std::max(1u, std::thread::hardware_concurrency());
+            for (i32 threads = 1; threads < hardware; threads *= 2)
+            {
+                options.Threads.push_back(threads);
+            }
+            options.Threads.push_back(hardware);
+        }
+
+        for (i32 threads : options.Threads)
+        {
+            if (threads < 1)
+            {
+                Usage("thread counts must be at least 1");
+            }
+        }
+        for (i32 size : options.Sizes)
+        {
+            if (size < 5)
+            {
+                Usage("grid sizes must be at least 5");
+            }
+        }
+        return options;
+    }
+
+    // Bytes per grid point of one height plane in the given storage mode.
+    f64 HeightBytes(WavesStorage storage)
+    {
+        switch (storage)
+        {
+            case WavesStorage::Interleaved: return sizeof(DirectX::XMFLOAT3);
+            case WavesStorage::Planar: return sizeof(f32);
+            default: return sizeof(u16);
+        }
+    }
+
+    // Bytes per grid point of the normal pass's output in the given storage mode.
+    f64 NormalBytes(WavesStorage storage)
+    {
+        bool compact = storage == WavesStorage::Half || storage == WavesStorage::Fixed16;
+        return compact ? sizeof(u16) : 2 * sizeof(DirectX::XMFLOAT3);
+    }
+
+    // Modelled DRAM bytes of one update step; see the header comment.
+    f64 UpdateBytes(WavesStorage storage, WavesPipeline pipeline, f64 cells)
+    {
+        f64 heights = HeightBytes(storage);
+        f64 stencil = 3.0 * heights;
+        f64 normals = NormalBytes(storage) + (pipeline == WavesPipeline::TwoPass ? heights : 0.0);
+        return cells * (stencil + normals);
+    }
+
+    // Runs one workload on one grid; false for an unknown workload name.
+    bool RunWorkload(const std::string& workload, Waves& waves, f64 minTime, Result& result)
+    {
+        const f64 cells = (f64)waves.VertexCount();
+        const f32 timeStep = 0.03f;
+
+        if (workload == "update")
+        {
+            result.SecondsPerCall = Bench::TimeCalls([&] { waves.Update(timeStep); }, minTime, result.Calls);
+            result.ItemsPerCall = cells;
+            result.BytesPerCall = UpdateBytes(waves.Storage(), waves.Pipeline(), cells);
+        }
+        else if (workload == "normals")
+        {
+            result.SecondsPerCall = Bench::TimeCalls([&] { waves.UpdateNormals(); }, minTime, result.Calls);
+            result.ItemsPerCall = cells;
+            result.BytesPerCall = cells * (HeightBytes(waves.Storage()) + NormalBytes(waves.Storage()));
+        }
+        else if (workload == "disturb")
+        {
+            // A fixed pseudo-random walk over the interior, 1024 impulses per call.
+            const i32 impulses = 1024;
+            const i32 rows = waves.RowCount() - 4;
+            const i32 cols = waves.ColumnCount() - 4;
+            u32 state = 12345u;
+            result.SecondsPerCall = Bench::TimeCalls([&]
+            {
+                for (i32 k = 0; k < impulses; ++k)
+                {
+                    state = state * 1664525u + 1013904223u;
+                    i32 i = 2 + (i32)((state >> 8) % (u32)rows);
+                    i32 j = 2 + (i32)((state >> 20) % (u32)cols);
+                    waves.Disturb(i, j, 1e-4f);
+                }
+            }, minTime, result.Calls);
+            result.ItemsPerCall = impulses;
+            result.BytesPerCall = 0.0;
+        }
+        else if (workload == "write_vertices")
+        {
+            std::vector<WavesVertex> vertices(waves.VertexCount());
+            Span<WavesVertex> dst(vertices.data(), vertices.size());
+            result.SecondsPerCall = Bench::TimeCalls([&] { waves.WriteVertices(dst); }, minTime, result.Calls);
+            result.ItemsPerCall = cells;
+            result.BytesPerCall = cells * sizeof(WavesVertex);
+        }
+        else if (workload == "write_heightmap")
+        {
+            u32 heightPitch = waves.HeightmapRowPitch(WavesHeightFormat::R16F);
+            u32 normalPitch = waves.NormalmapRowPitch();
+            size_t rows = (size_t)waves.RowCount();
+            std::vector<u8> heights(rows * heightPitch);
+            std::vector<u8> normals(rows * normalPitch);
+
+            WavesHeightmap dst;
+            dst.Heights = Span<u8>(heights.data(), heights.size());
+            dst.HeightRowPitch = heightPitch;
+            dst.HeightFormat = WavesHeightFormat::R16F;
+            dst.Normals = Span<u8>(normals.data(), normals.size());
+            dst.NormalRowPitch = normalPitch;
+            result.SecondsPerCall = Bench::TimeCalls([&] { waves.WriteHeightmap(dst); }, minTime, result.Calls);
+            result.ItemsPerCall = cells;
+            result.BytesPerCall = cells * (2 * sizeof(u16));
+        }
+        else
+        {
+            return false;
+        }
+        return true;
+    }
+
+    bool WriteJson(const Options& options, const std::vector<Result>& results)
+    {
+        auto fields = [&options](FILE* out)
+        {
+            fprintf(out, "  \"isa\": \"%s\",\n", WavesKernels::IsaName(WavesKernels::ActiveIsa()));
+            fprintf(out, "  \"hardware_threads\": %u,\n", std::thread::hardware_concurrency());
+            fprintf(out, "  \"min_time_s\": %g,\n", options.MinTime);
+            fprintf(out, "  \"pages\": \"%s\",\n", PagePolicyName(options.Pages));
+        };
+        auto result = [&results](FILE* out, size_t r)
+        {
+            const Result& result = results[r];
+            f64 ns = result.SecondsPerCall * 1e9;
+            fprintf(out,
+                "{\"workload\": \"%s\", \"storage\": \"%s\", \"pipeline\": \"%s\", \"size\": %d, \"threads\": %d, \"calls\": %llu, "
+                "\"ns_per_call\": %.1f, \"ns_per_item\": %.4f, \"bytes_per_call\": %.0f, \"gb_per_s\": %.3f, \"scaling_efficiency\": %.3f, \"tlb_entries\": %llu, \"huge_page_bytes\": %llu}",
+                result.Workload.c_str(), StorageName(result.Storage), PipelineName(result.Pipeline), result.Size,
+                result.Threads, (unsigned long long)result.Calls, ns, ns / result.ItemsPerCall, result.BytesPerCall,
+                result.BytesPerCall / result.SecondsPerCall * 1e-9, result.ScalingEfficiency,
+                (unsigned long long)result.TlbEntries, (unsigned long long)result.HugePageBytes);
+        };
+        return Bench::WriteJson(options.JsonPath, "waves_bench", results.size(), fields, result);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options = ParseOptions(argc, argv);
+    WavesKernels::SetIsa(options.Isa);
+
+    FILE* table = Bench::TableStream(options.JsonPath);
+    fprintf(table, "waves_bench  isa %s  hardware threads %u  pages %s\n",
+        WavesKernels::IsaName(WavesKernels::ActiveIsa()), std::thread::hardware_concurrency(),
+        PagePolicyName(options.Pages));
+    fprintf(table, "%-16s %-12s %-8s %6s %7s %14s %10s %8s %9s %8s %8s\n", "workload", "storage", "pipeline", "size",
+        "threads", "ns/call", "ns/item", "B/item", "GB/s", "scaling", "tlb");
+
+    std::vector<Result> results;
+    for (const std::string& workload : options.Workloads)
+    {
+        // Only update depends on the pipeline; the rest run under the first one.
+        std::vector<WavesPipeline> pipelines = options.Pipelines;
+        if (workload != "update")
+        {
+            pipelines.resize(1);
+        }
+
+        for (WavesStorage storage : options.Storages)
+        {
+            for (WavesPipeline pipeline : pipelines)
+            {
+                for (i32 size : options.Sizes)
+                {
+                    f64 baseCost = 0.0;
+                    for (i32 threads : options.Threads)
+                    {
+                        JobSystem::ResizeGlobal((u32)threads);
+
+                        // A grid in motion: a few drops, then enough steps to spread them.
+                        Waves waves(size, size, 1.0f, 0.03f, 4.0f, 0.2f, storage);
+                        waves.SetPipeline(pipeline);
+                        if (options.Pages != PagePolicy::Heap)
+                        {
+                            waves.SetStatePagePolicy(options.Pages);
+                        }
+                        for (i32 k = 1; k <= 8; ++k)
+                        {
+                            waves.Disturb(2 + k * (size - 4) / 9, 2 + (9 - k) * (size - 4) / 9, 0.5f);
+                        }
+                        waves.Step(20);
+
+                        Result result;
+                        result.Workload = workload;
+                        result.Storage = storage;
+                        result.Pipeline = pipeline;
+                        result.Size = size;
+                        result.Threads = threads;
+                        if (!RunWorkload(workload, waves, options.MinTime, result))
+                        {
+                            Usage(("unknown workload " + workload).c_str());
+                        }
+
+                        // Efficiency against the first (normally single-thread) run:
+                        // ideal scaling keeps threads * time constant.
+                        f64 cost = result.SecondsPerCall * threads;
+                        if (baseCost == 0.0)
+                        {
+                            baseCost = cost;
+                        }
+                        result.ScalingEfficiency = baseCost / cost;
+
+                        PageStats pages = waves.StatePageStats();
+                        result.TlbEntries = pages.TlbEntries;
+                        result.HugePageBytes = pages.HugePageBytes;
+
+                        f64 ns = result.SecondsPerCall * 1e9;
+                        fprintf(table, "%-16s %-12s %-8s %6d %7d %14.1f %10.3f %8.1f %9.2f %7.0f%% %8llu\n", workload.c_str(),
+                            StorageName(storage), PipelineName(pipeline), size, threads, ns, ns / result.ItemsPerCall,
+                            result.BytesPerCall / result.ItemsPerCall, result.BytesPerCall / result.SecondsPerCall * 1e-9,
+                            result.ScalingEfficiency * 100.0, (unsigned long long)result.TlbEntries);
+                        fflush(table);
+                        results.push_back(result);
+                    }
+                }
+            }
+        }
+    }
+
+    if (!options.JsonPath.empty() && !WriteJson(options, results))
+    {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -3,7 +3,7 @@
 #include <Common/UploadBuffer.hpp>
 #include <Common/GeometryGenerator.hpp>
 #include <Chapter7/LandWave/FrameResource.hpp>
-#include <Chapter7/LandWave/Waves.hpp>
+#include <Common/FixedWaves.hpp>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -109,7 +109,7 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(i32)RenderLayer::Count];
 
-	std::unique_ptr<Waves> mWaves;
+	std::unique_ptr<WavesSurface> mWaves;
 
     PassConstants mMainPassCB;
 
@@ -169,7 +169,7 @@ bool LandAndWavesApp::Initialize()
     // Reset the command list to prep for initialization commands.
     ThrowIfFailed(mCommandList->Reset(mDirectCmdListAlloc.Get(), nullptr));
 
-	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	mWaves = MakeWaves<WavesDemoParams>(128, 128);
 
     BuildRootSignature();
     BuildShadersAndInputLayout();
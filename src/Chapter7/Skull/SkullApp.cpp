@@ -1,7 +1,9 @@
 #include <Chapter7/Skull/SkullApp.hpp>
+#include <Common/MeshOptimizer.hpp>
 #include <io/FileUtil.hpp>
 #include <io/StringUtil.hpp>
 #include <ppl.h>
+#include <cstdio>
 
 
 
@@ -504,6 +506,33 @@ void SkullApp::BuildShapeGeometry()
     AddIndices(indices, index_str);
     StringUtil::ClearStrings(strings);
 
+    // Reorder the triangles for the post-transform cache, then in clusters so
+    // that the outside of the skull tends to draw before what it hides, then
+    // the vertices for fetch locality. Debug builds also log what the passes
+    // gained; the overdraw estimate renders the mesh from 16 views each time.
+    const u32 vertexCount = (u32)vertices.size();
+#if defined(DEBUG) || defined(_DEBUG)
+    MeshOptimizer::CacheStats cacheBefore = MeshOptimizer::AnalyzeVertexCache(Span<const u16>(indices), vertexCount);
+    MeshOptimizer::OverdrawStats overdrawBefore = MeshOptimizer::EstimateOverdraw(
+        vertices.data(), vertexCount, sizeof(Vertex), Span<const u16>(indices));
+#endif
+
+    MeshOptimizer::OptimizeVertexCache(Span<u16>(indices), vertexCount);
+    MeshOptimizer::OptimizeOverdraw(vertices.data(), vertexCount, sizeof(Vertex), Span<u16>(indices));
+    MeshOptimizer::OptimizeVertexFetch(vertices.data(), vertexCount, sizeof(Vertex), Span<u16>(indices));
+
+#if defined(DEBUG) || defined(_DEBUG)
+    MeshOptimizer::CacheStats cacheAfter = MeshOptimizer::AnalyzeVertexCache(Span<const u16>(indices), vertexCount);
+    MeshOptimizer::OverdrawStats overdrawAfter = MeshOptimizer::EstimateOverdraw(
+        vertices.data(), vertexCount, sizeof(Vertex), Span<const u16>(indices));
+
+    char cacheText[160];
+    snprintf(cacheText, sizeof(cacheText), "skull: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, overdraw %.3f -> %.3f\n",
+        cacheBefore.Acmr, cacheAfter.Acmr, cacheBefore.Atvr, cacheAfter.Atvr, overdrawBefore.Overdraw,
+        overdrawAfter.Overdraw);
+    ::OutputDebugStringA(cacheText);
+#endif
+
     SubmeshGeometry skull_submesh;
     skull_submesh.IndexCount = (u32)indices.size();
     skull_submesh.StartIndexLocation = 0;
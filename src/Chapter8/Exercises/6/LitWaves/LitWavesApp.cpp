@@ -3,7 +3,7 @@
 #include <Common/UploadBuffer.hpp>
 #include <Common/GeometryGenerator.hpp>
 #include <Chapter8/Exercises/6/LitWaves/FrameResource.hpp>
-#include <Chapter8/Exercises/6/LitWaves/Waves.hpp>
+#include <Common/FixedWaves.hpp>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -115,7 +115,7 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mRitemLayer[(i32)RenderLayer::Count];
 
-	std::unique_ptr<Waves> mWaves;
+	std::unique_ptr<WavesSurface> mWaves;
 
     PassConstants mMainPassCB;
 
@@ -179,7 +179,7 @@ bool LitWavesApp::Initialize()
     // to query this information.
     mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-	mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+	mWaves = MakeWaves<WavesDemoParams>(128, 128);
 
     BuildRootSignature();
     BuildShadersAndInputLayout();
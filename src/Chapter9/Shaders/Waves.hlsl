@@ -0,0 +1,37 @@
+//***************************************************************************************
+// Waves.hlsl
+//
+// Vertex shader for waves drawn from Waves::WriteHeightmap output: the vertex buffer
+// holds the flat grid and the heights and normals are read from textures, one texel
+// per grid point. Uses the pixel shader and constants of Default.hlsl.
+//***************************************************************************************
+
+#include "Default.hlsl"
+
+Texture2D<float>  gWavesHeightMap : register(t1);
+Texture2D<float2> gWavesNormalMap : register(t2);
+
+// Inverse of WavesKernels::EncodeOct; the R8G8_SNORM view already maps the
+// bytes to [-1, 1].
+float3 DecodeOctahedral(float2 e)
+{
+    float3 n = float3(e.x, 1.0f - abs(e.x) - abs(e.y), e.y);
+    if(n.y < 0.0f)
+    {
+        n.xz = (1.0f - abs(n.zx)) * (n.xz >= 0.0f ? 1.0f : -1.0f);
+    }
+    return normalize(n);
+}
+
+VertexOut WavesVS(VertexIn vin, uint vertexId : SV_VertexID)
+{
+    // Grid point i*n + j is texel (j, i).
+    uint width, height;
+    gWavesHeightMap.GetDimensions(width, height);
+    int3 texel = int3(vertexId % width, vertexId / width, 0);
+
+    vin.PosL.y = gWavesHeightMap.Load(texel);
+    vin.NormalL = DecodeOctahedral(gWavesNormalMap.Load(texel));
+
+    return VS(vin);
+}
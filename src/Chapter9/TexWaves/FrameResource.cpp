@@ -1,6 +1,7 @@
 #include <Chapter9/TexWaves/FrameResource.hpp>
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount)
+FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount,
+    UINT wavesHeightmapByteSize)
 {
     ThrowIfFailed(device->CreateCommandAllocator(
         D3D12_COMMAND_LIST_TYPE_DIRECT,
@@ -11,7 +12,10 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
     MaterialCB = std::make_unique<UploadBuffer<MaterialConstants>>(device, materialCount, true);
     ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
 
-    WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, waveVertCount, false);
+    if(waveVertCount > 0)
+        WavesVB = std::make_unique<UploadBuffer<Vertex>>(device, waveVertCount, false);
+    if(wavesHeightmapByteSize > 0)
+        WavesHeightmap = std::make_unique<UploadBuffer<std::uint8_t>>(device, wavesHeightmapByteSize, false);
 }
 
 FrameResource::~FrameResource()
@@ -49,7 +49,8 @@ struct FrameResource
 {
 public:
     
-    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount);
+    FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount, UINT materialCount, UINT waveVertCount,
+        UINT wavesHeightmapByteSize = 0);
     FrameResource(const FrameResource& rhs) = delete;
     FrameResource& operator=(const FrameResource& rhs) = delete;
     ~FrameResource();
@@ -69,6 +70,20 @@ public:
     // the commands that reference it.  So each frame needs their own.
     std::unique_ptr<UploadBuffer<Vertex>> WavesVB = nullptr;
 
+    // With heightmap output the waves VB is static and this holds the height and
+    // normal planes instead, copied into the wave textures each frame.
+    std::unique_ptr<UploadBuffer<std::uint8_t>> WavesHeightmap = nullptr;
+
+    // Waves::Version() the contents of WavesVB / WavesHeightmap correspond to, so
+    // unchanged (sleeping) wave tiles are not rewritten.
+    std::uint64_t WavesVersion = 0;
+
+    // WavesFrame::Serial copied in when the simulation runs asynchronously.
+    std::uint64_t WavesSerial = 0;
+
+    // Bytes of WavesVB / WavesHeightmap rewritten the last time this resource was used.
+    std::uint64_t WavesBytesWritten = 0;
+
     // Fence value to mark commands up to this fence point.  This lets us
     // check if these frame resources are still in use by the GPU.
     UINT64 Fence = 0;
@@ -3,7 +3,10 @@
 #include <Common/UploadBuffer.hpp>
 #include <Common/GeometryGenerator.hpp>
 #include <Chapter9/TexWaves/FrameResource.hpp>
-#include <Chapter9/TexWaves/Waves.hpp>
+#include <Common/Waves.hpp>
+#include <Common/AsyncWaves.hpp>
+#include <Common/OceanWaves.hpp>
+#include <cstring>
 
 using Microsoft::WRL::ComPtr;
 using namespace DirectX;
@@ -14,6 +17,14 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// The pond is saved here on exit and picked up again on the next start.
+const char* gWavesSnapshotPath = "TexWaves.wavesnap";
+
+// Waves::WriteVertices fills the wave VB in place, so the layouts must agree.
+static_assert(sizeof(Vertex) == sizeof(WavesVertex), "Vertex must match WavesVertex.");
+static_assert(offsetof(Vertex, Normal) == offsetof(WavesVertex, Normal), "Vertex must match WavesVertex.");
+static_assert(offsetof(Vertex, TexC) == offsetof(WavesVertex, TexC), "Vertex must match WavesVertex.");
+
 // Lightweight structure stores parameters to draw a shape.  This will
 // vary from app-to-app.
 struct RenderItem
@@ -51,6 +62,7 @@ struct RenderItem
 enum class RenderLayer : int
 {
 	Opaque = 0,
+	WavesHeightmap,
 	Count
 };
 
@@ -82,6 +94,7 @@ private:
 	void UpdateWaves(const GameTimer& gt); 
 
 	void LoadTextures();
+	void BuildWavesTextures();
     void BuildRootSignature();
 	void BuildDescriptorHeaps();
     void BuildShadersAndInputLayout();
@@ -99,6 +112,11 @@ private:
     float GetHillsHeight(float x, float z)const;
     XMFLOAT3 GetHillsNormal(float x, float z)const;
 
+    // Batched form of the two above, as a CreateGrid height function: sets
+    // Position.y and Normal of each vertex from its x and z, four vertices at
+    // a time with the sines and cosines shared between height and normal.
+    void ApplyHills(Span<GeometryGenerator::Vertex> vertices)const;
+
 private:
 
     std::vector<std::unique_ptr<FrameResource>> mFrameResources;
@@ -128,6 +146,40 @@ private:
 	std::vector<RenderItem*> mRitemLayer[(int)RenderLayer::Count];
 
 	std::unique_ptr<Waves> mWaves;
+	bool mWavesSnapshotEnabled = true;
+
+	// Steps mWaves on a background thread while the frame is recorded; null runs
+	// the simulation synchronously in UpdateWaves. Declared after mWaves so the
+	// worker is stopped before the simulation goes away.
+	bool mAsyncWavesEnabled = true;
+	std::unique_ptr<AsyncWaves> mAsyncWaves;
+
+	// Replaces the pond with an FFT-evaluated OceanWaves patch, written into the
+	// dynamic VB every frame (no heightmap output, worker thread or drops).
+	bool mOceanEnabled = false;
+	std::unique_ptr<OceanWaves> mOcean;
+
+	// The surface the waves geometry is built from: mOcean or mWaves.
+	WavesSurface* mWavesSurface = nullptr;
+
+	// Heightmap output: the waves grid sits in a static VB and WavesVS displaces
+	// it with height/normal textures, which are refreshed every frame from the
+	// frame resource's upload planes. Otherwise the whole VB is re-uploaded.
+	bool mWavesHeightmapEnabled = true;
+	WavesHeightFormat mWavesHeightFormat = WavesHeightFormat::R16F;
+	ComPtr<ID3D12Resource> mWavesHeightMap;
+	ComPtr<ID3D12Resource> mWavesNormalMap;
+	UINT mWavesHeightRowPitch = 0;
+	UINT mWavesNormalRowPitch = 0;
+	UINT64 mWavesNormalOffset = 0;
+	UINT mWavesSrvHeapIndex = 3;
+
+	// Rows and bytes the last UpdateWaves wrote into the current frame resource;
+	// with heightmap output only these rows are copied into the textures.
+	WavesWriteStats mWavesWriteStats;
+	std::uint64_t mWavesBytesPerSecond = 0;
+	std::uint64_t mWavesStatFrames = 0;
+	float mWavesStatTime = 0.0f;
 
     PassConstants mMainPassCB;
 
@@ -174,6 +226,15 @@ TexWavesApp::~TexWavesApp()
 {
     if(md3dDevice != nullptr)
         FlushCommandQueue();
+
+    // The restored pond may still be mapped from the file being replaced.
+    if(mAsyncWaves)
+        mAsyncWaves->Wait();
+    if(mWaves && mWavesSnapshotEnabled)
+    {
+        mWaves->ReleaseSnapshot();
+        mWaves->SaveSnapshot(gWavesSnapshotPath);
+    }
 }
 
 bool TexWavesApp::Initialize()
@@ -188,9 +249,39 @@ bool TexWavesApp::Initialize()
 	// so we have to query this information.
     mCbvSrvDescriptorSize = md3dDevice->GetDescriptorHandleIncrementSize(D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV);
 
-    mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f);
+    if(mOceanEnabled)
+    {
+        // Twice the pond's resolution over the same area.
+        OceanParams ocean;
+        ocean.Size = 256;
+        ocean.PatchSize = 128.0f;
+        ocean.WindSpeed = 8.0f;
+        ocean.WindDirection = XM_PIDIV4;
+        mOcean = std::make_unique<OceanWaves>(ocean);
+        mWavesSurface = mOcean.get();
+        mWavesHeightmapEnabled = false;
+        mAsyncWavesEnabled = false;
+    }
+    else
+    {
+        // Continue from the last session's pond instead of a flat one.
+        if(mWavesSnapshotEnabled)
+            mWaves = Waves::LoadSnapshot(gWavesSnapshotPath);
+        if(!mWaves)
+            mWaves = std::make_unique<Waves>(128, 128, 1.0f, 0.03f, 4.0f, 0.2f, WavesStorage::Planar);
+        mWaves->SetPipeline(WavesPipeline::Fused);
+        mWaves->SetTemporalBlocking(64, 4);
+        mWaves->SetQuiescence(16, 1e-4f, 1e-4f);
+        mWavesSurface = mWaves.get();
+    }
+    if(mAsyncWavesEnabled)
+    {
+        mAsyncWaves = std::make_unique<AsyncWaves>(*mWaves,
+            mWavesHeightmapEnabled ? WavesOutput::Heightmap : WavesOutput::Vertices, mWavesHeightFormat);
+    }
  
 	LoadTextures();
+	BuildWavesTextures();
     BuildRootSignature();
 	BuildDescriptorHeaps();
     BuildShadersAndInputLayout();
@@ -284,6 +375,59 @@ void TexWavesApp::Draw(const GameTimer& gt)
 
     DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::Opaque]);
 
+	if(mWavesHeightmapEnabled)
+	{
+		// Refresh the changed rows of the wave textures from this frame's upload planes.
+		auto upload = mCurrFrameResource->WavesHeightmap->Resource();
+		DXGI_FORMAT heightFormat = mWavesHeightMap->GetDesc().Format;
+
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT heightFootprint = {};
+		heightFootprint.Offset = 0;
+		heightFootprint.Footprint = CD3DX12_SUBRESOURCE_FOOTPRINT(heightFormat,
+			mWaves->ColumnCount(), mWaves->RowCount(), 1, mWavesHeightRowPitch);
+
+		D3D12_PLACED_SUBRESOURCE_FOOTPRINT normalFootprint = {};
+		normalFootprint.Offset = mWavesNormalOffset;
+		normalFootprint.Footprint = CD3DX12_SUBRESOURCE_FOOTPRINT(DXGI_FORMAT_R8G8_SNORM,
+			mWaves->ColumnCount(), mWaves->RowCount(), 1, mWavesNormalRowPitch);
+
+		// The textures hold last frame's solution; every row that changed since
+		// then was rewritten in this frame's planes as well.
+		for(const WavesRowRange& range : mWavesWriteStats.DirtyRows)
+		{
+			D3D12_BOX rows = { 0, (UINT)range.First, 0, (UINT)mWaves->ColumnCount(), (UINT)range.Last, 1 };
+			mCommandList->CopyTextureRegion(&CD3DX12_TEXTURE_COPY_LOCATION(mWavesHeightMap.Get(), 0), 0, range.First, 0,
+				&CD3DX12_TEXTURE_COPY_LOCATION(upload, heightFootprint), &rows);
+			mCommandList->CopyTextureRegion(&CD3DX12_TEXTURE_COPY_LOCATION(mWavesNormalMap.Get(), 0), 0, range.First, 0,
+				&CD3DX12_TEXTURE_COPY_LOCATION(upload, normalFootprint), &rows);
+		}
+
+		D3D12_RESOURCE_BARRIER toShader[] =
+		{
+			CD3DX12_RESOURCE_BARRIER::Transition(mWavesHeightMap.Get(),
+				D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+			CD3DX12_RESOURCE_BARRIER::Transition(mWavesNormalMap.Get(),
+				D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE),
+		};
+		mCommandList->ResourceBarrier(_countof(toShader), toShader);
+
+		CD3DX12_GPU_DESCRIPTOR_HANDLE wavesMaps(mSrvDescriptorHeap->GetGPUDescriptorHandleForHeapStart());
+		wavesMaps.Offset(mWavesSrvHeapIndex, mCbvSrvDescriptorSize);
+		mCommandList->SetGraphicsRootDescriptorTable(4, wavesMaps);
+
+		mCommandList->SetPipelineState(mPSOs["wavesHeightmap"].Get());
+		DrawRenderItems(mCommandList.Get(), mRitemLayer[(int)RenderLayer::WavesHeightmap]);
+
+		D3D12_RESOURCE_BARRIER toCopy[] =
+		{
+			CD3DX12_RESOURCE_BARRIER::Transition(mWavesHeightMap.Get(),
+				D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+			CD3DX12_RESOURCE_BARRIER::Transition(mWavesNormalMap.Get(),
+				D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST),
+		};
+		mCommandList->ResourceBarrier(_countof(toCopy), toCopy);
+	}
+
     // Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier(1, &CD3DX12_RESOURCE_BARRIER::Transition(CurrentBackBuffer(),
 		D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT));
@@ -489,42 +633,101 @@ void TexWavesApp::UpdateMainPassCB(const GameTimer& gt)
 
 void TexWavesApp::UpdateWaves(const GameTimer& gt)
 {
-	// Every quarter second, generate a random wave.
+	// Every quarter second, generate a random wave (the ocean has no drops).
 	static float t_base = 0.0f;
-	if((mTimer.TotalTime() - t_base) >= 0.25f)
+	if(mWaves && (mTimer.TotalTime() - t_base) >= 0.25f)
 	{
 		t_base += 0.25f;
 
-		int i = MathHelper::Rand(4, mWaves->RowCount() - 5);
-		int j = MathHelper::Rand(4, mWaves->ColumnCount() - 5);
-
-		float r = MathHelper::RandF(0.2f, 0.5f);
-
-		mWaves->Disturb(i, j, r);
+		// A cosine bump of radius 2 matches the old five-point stencil (half the
+		// magnitude on the direct neighbours) and also feeds the diagonals.
+		WavesImpulse drop;
+		drop.Row = (float)MathHelper::Rand(4, mWaves->RowCount() - 5);
+		drop.Col = (float)MathHelper::Rand(4, mWaves->ColumnCount() - 5);
+		drop.Magnitude = MathHelper::RandF(0.2f, 0.5f);
+		drop.Radius = 2.0f;
+		drop.Shape = WavesImpulseShape::Cosine;
+
+		if(mAsyncWaves)
+			mAsyncWaves->Disturb(drop);
+		else
+			mWaves->DisturbBatch(Span<const WavesImpulse>(&drop, 1));
 	}
 
-	// Update the wave simulation.
-	mWaves->Update(gt.DeltaTime());
-
-	// Update the wave vertex buffer with the new solution.
-	auto currWavesVB = mCurrFrameResource->WavesVB.get();
-	for (int i = 0; i < mWaves->VertexCount(); ++i)
+	// Every path below rewrites only the rows that changed since this frame
+	// resource's copy was last written, and reports them in mWavesWriteStats.
+	if(mWavesHeightmapEnabled)
 	{
-		Vertex v;
+		// Only heights and normals go up; the grid itself is static.
+		std::uint8_t* planes = mCurrFrameResource->WavesHeightmap->MappedData();
+		size_t rows = (size_t)mWaves->RowCount();
+		WavesHeightmap heightmap;
+		heightmap.Heights = Span<u8>(planes, rows*mWavesHeightRowPitch);
+		heightmap.HeightRowPitch = mWavesHeightRowPitch;
+		heightmap.HeightFormat = mWavesHeightFormat;
+		heightmap.Normals = Span<u8>(planes + mWavesNormalOffset, rows*mWavesNormalRowPitch);
+		heightmap.NormalRowPitch = mWavesNormalRowPitch;
+
+		if(mAsyncWaves)
+		{
+			const WavesFrame& frame = mAsyncWaves->Latest();
+			mAsyncWaves->Submit(gt.DeltaTime());
 
-		v.Pos = mWaves->Position(i);
-		v.Normal = mWaves->Normal(i);
-		
-		// Derive tex-coords from position by 
-		// mapping [-w/2,w/2] --> [0,1]
-		v.TexC.x = 0.5f + v.Pos.x / mWaves->Width();
-		v.TexC.y = 0.5f - v.Pos.z / mWaves->Depth();
+			mWavesWriteStats.BytesWritten = frame.CopyHeightmap(heightmap, mCurrFrameResource->WavesSerial,
+				&mWavesWriteStats.DirtyRows);
+			mCurrFrameResource->WavesSerial = frame.Serial;
+		}
+		else
+		{
+			mWaves->Update(gt.DeltaTime());
+			mWaves->WriteHeightmap(heightmap, &mCurrFrameResource->WavesVersion, mWaves->InterpolationAlpha(),
+				&mWavesWriteStats);
+		}
+	}
+	else
+	{
+		auto currWavesVB = mCurrFrameResource->WavesVB.get();
+		if(mAsyncWaves)
+		{
+			// Take the newest finished solution (normally last frame's update) and
+			// start the next update right away, so it runs while this frame is built.
+			const WavesFrame& frame = mAsyncWaves->Latest();
+			mAsyncWaves->Submit(gt.DeltaTime());
+
+			mWavesWriteStats.BytesWritten = frame.CopyVertices(reinterpret_cast<WavesVertex*>(currWavesVB->MappedData()),
+				mCurrFrameResource->WavesSerial, &mWavesWriteStats.DirtyRows);
+			mCurrFrameResource->WavesSerial = frame.Serial;
+		}
+		else
+		{
+			// Update the wave simulation (or re-evaluate the ocean).
+			mWavesSurface->Update(gt.DeltaTime());
+
+			// Update the wave vertex buffer with the new solution. The simulation writes
+			// the vertices straight into the mapped upload buffer, blended between the
+			// last two steps by how far the frame time has run past the latest one.
+			mWavesSurface->WriteVertices(Span<WavesVertex>(
+				reinterpret_cast<WavesVertex*>(currWavesVB->MappedData()), mWavesSurface->VertexCount()),
+				&mCurrFrameResource->WavesVersion, mWavesSurface->InterpolationAlpha(), &mWavesWriteStats);
+		}
 
-		currWavesVB->CopyData(i, v);
+		// Set the dynamic VB of the wave renderitem to the current frame VB.
+		mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
 	}
 
-	// Set the dynamic VB of the wave renderitem to the current frame VB.
-	mWavesRitem->Geo->VertexBufferGPU = currWavesVB->Resource();
+	mCurrFrameResource->WavesBytesWritten = mWavesWriteStats.BytesWritten;
+
+	// Report the average upload traffic in the caption once a second.
+	mWavesBytesPerSecond += mWavesWriteStats.BytesWritten;
+	mWavesStatFrames++;
+	if(mTimer.TotalTime() - mWavesStatTime >= 1.0f)
+	{
+		mMainWndCaption = L"TexWaves   waves upload KiB/frame: " +
+			std::to_wstring(mWavesBytesPerSecond / 1024 / std::max<std::uint64_t>(mWavesStatFrames, 1));
+		mWavesBytesPerSecond = 0;
+		mWavesStatFrames = 0;
+		mWavesStatTime = mTimer.TotalTime();
+	}
 }
 
 void TexWavesApp::LoadTextures()
@@ -556,24 +759,59 @@ void TexWavesApp::LoadTextures()
 	mTextures[fenceTex->Name] = std::move(fenceTex);
 }
 
+void TexWavesApp::BuildWavesTextures()
+{
+	if(!mWavesHeightmapEnabled)
+		return;
+
+	// Both planes share one upload buffer per frame resource; the normal plane
+	// starts at the next placement boundary after the heights.
+	mWavesHeightRowPitch = mWaves->HeightmapRowPitch(mWavesHeightFormat, D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+	mWavesNormalRowPitch = mWaves->NormalmapRowPitch(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT);
+	UINT64 heightBytes = (UINT64)mWaves->RowCount()*mWavesHeightRowPitch;
+	mWavesNormalOffset = (heightBytes + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) &
+		~(UINT64)(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
+
+	DXGI_FORMAT heightFormat = (mWavesHeightFormat == WavesHeightFormat::R16F)
+		? DXGI_FORMAT_R16_FLOAT : DXGI_FORMAT_R32_FLOAT;
+
+	CD3DX12_HEAP_PROPERTIES defaultHeap(D3D12_HEAP_TYPE_DEFAULT);
+	CD3DX12_RESOURCE_DESC heightDesc = CD3DX12_RESOURCE_DESC::Tex2D(heightFormat,
+		mWaves->ColumnCount(), mWaves->RowCount(), 1, 1);
+	CD3DX12_RESOURCE_DESC normalDesc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8_SNORM,
+		mWaves->ColumnCount(), mWaves->RowCount(), 1, 1);
+
+	// The textures rest in COPY_DEST between frames; Draw moves them to the
+	// shader state around the waves draw.
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &heightDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&mWavesHeightMap)));
+	ThrowIfFailed(md3dDevice->CreateCommittedResource(&defaultHeap, D3D12_HEAP_FLAG_NONE, &normalDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST, nullptr, IID_PPV_ARGS(&mWavesNormalMap)));
+}
+
 void TexWavesApp::BuildRootSignature()
 {
 	CD3DX12_DESCRIPTOR_RANGE texTable;
 	texTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0);
 
+	// Wave height and normal maps for WavesVS.
+	CD3DX12_DESCRIPTOR_RANGE wavesTable;
+	wavesTable.Init(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 2, 1);
+
     // Root parameter can be a table, root descriptor or root constants.
-    CD3DX12_ROOT_PARAMETER slotRootParameter[4];
+    CD3DX12_ROOT_PARAMETER slotRootParameter[5];
 
 	// Perfomance TIP: Order from most frequent to least frequent.
 	slotRootParameter[0].InitAsDescriptorTable(1, &texTable, D3D12_SHADER_VISIBILITY_PIXEL);
     slotRootParameter[1].InitAsConstantBufferView(0);
     slotRootParameter[2].InitAsConstantBufferView(1);
     slotRootParameter[3].InitAsConstantBufferView(2);
+	slotRootParameter[4].InitAsDescriptorTable(1, &wavesTable, D3D12_SHADER_VISIBILITY_VERTEX);
 
 	auto staticSamplers = GetStaticSamplers();
 
     // A root signature is an array of root parameters.
-	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(4, slotRootParameter,
+	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc(5, slotRootParameter,
 		(UINT)staticSamplers.size(), staticSamplers.data(),
 		D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT);
 
@@ -600,7 +838,7 @@ void TexWavesApp::BuildDescriptorHeaps()
 {
 	// Create the SRV heap.
 	D3D12_DESCRIPTOR_HEAP_DESC srvHeapDesc = {};
-	srvHeapDesc.NumDescriptors = 3;
+	srvHeapDesc.NumDescriptors = 5;
 	srvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
 	srvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
 	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&srvHeapDesc, IID_PPV_ARGS(&mSrvDescriptorHeap)));
@@ -631,12 +869,28 @@ void TexWavesApp::BuildDescriptorHeaps()
 
 	srvDesc.Format = fenceTex->GetDesc().Format;
 	md3dDevice->CreateShaderResourceView(fenceTex.Get(), &srvDesc, hDescriptor);
+
+	if(!mWavesHeightmapEnabled)
+		return;
+
+	// Wave height and normal maps at mWavesSrvHeapIndex.
+	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+
+	srvDesc.Format = mWavesHeightMap->GetDesc().Format;
+	srvDesc.Texture2D.MipLevels = 1;
+	md3dDevice->CreateShaderResourceView(mWavesHeightMap.Get(), &srvDesc, hDescriptor);
+
+	hDescriptor.Offset(1, mCbvSrvDescriptorSize);
+
+	srvDesc.Format = mWavesNormalMap->GetDesc().Format;
+	md3dDevice->CreateShaderResourceView(mWavesNormalMap.Get(), &srvDesc, hDescriptor);
 }
 
 void TexWavesApp::BuildShadersAndInputLayout()
 {
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"src/Chapter9/Shaders/Default.hlsl", nullptr, "VS", "vs_5_0");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"src/Chapter9/Shaders/Default.hlsl", nullptr, "PS", "ps_5_0");
+	mShaders["wavesVS"] = d3dUtil::CompileShader(L"src/Chapter9/Shaders/Waves.hlsl", nullptr, "WavesVS", "vs_5_0");
 	
     mInputLayout =
     {
@@ -648,19 +902,18 @@ void TexWavesApp::BuildShadersAndInputLayout()
 
 void TexWavesApp::BuildLandGeometry()
 {
+    // The height function is applied to each block of rows as the grid is
+    // built.
     GeometryGenerator geoGen;
-    GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50);
+    GeometryGenerator::MeshData grid = geoGen.CreateGrid(160.0f, 160.0f, 50, 50,
+        [this](Span<GeometryGenerator::Vertex> block) { ApplyHills(block); });
 
-    // Extract the vertex elements we are interested and apply the height function to
-    // each vertex.  In addition, color the vertices based on their height so we have
-    // sandy looking beaches, grassy low hills, and snow mountain peaks.
+    // Extract the vertex elements we are interested in.
     std::vector<Vertex> vertices(grid.Vertices.size());
     for(size_t i = 0; i < grid.Vertices.size(); ++i)
     {
-        auto& p = grid.Vertices[i].Position;
-        vertices[i].Pos = p;
-        vertices[i].Pos.y = GetHillsHeight(p.x, p.z);
-        vertices[i].Normal = GetHillsNormal(p.x, p.z);
+        vertices[i].Pos = grid.Vertices[i].Position;
+        vertices[i].Normal = grid.Vertices[i].Normal;
 		vertices[i].TexC = grid.Vertices[i].TexC;
     }
 
@@ -701,12 +954,11 @@ void TexWavesApp::BuildLandGeometry()
 
 void TexWavesApp::BuildWavesGeometry()
 {
-    std::vector<std::uint16_t> indices(3 * mWaves->TriangleCount()); // 3 indices per face
-	assert(mWaves->VertexCount() < 0x0000ffff);
+    std::vector<std::uint32_t> indices(3 * mWavesSurface->TriangleCount()); // 3 indices per face
 
     // Iterate over each quad.
-    int m = mWaves->RowCount();
-    int n = mWaves->ColumnCount();
+    int m = mWavesSurface->RowCount();
+    int n = mWavesSurface->ColumnCount();
     int k = 0;
     for(int i = 0; i < m - 1; ++i)
     {
@@ -724,25 +976,52 @@ void TexWavesApp::BuildWavesGeometry()
         }
     }
 
-	UINT vbByteSize = mWaves->VertexCount()*sizeof(Vertex);
-	UINT ibByteSize = (UINT)indices.size()*sizeof(std::uint16_t);
+	// 16-bit indices unless the grid is too large for them (the ocean).
+	bool indices16 = mWavesSurface->VertexCount() <= 0x0000ffff;
+	std::vector<std::uint16_t> shortIndices;
+	if(indices16)
+		shortIndices.assign(indices.begin(), indices.end());
+	const void* indexData = indices16 ? (const void*)shortIndices.data() : (const void*)indices.data();
+
+	UINT vbByteSize = mWavesSurface->VertexCount()*sizeof(Vertex);
+	UINT ibByteSize = (UINT)indices.size()*(indices16 ? sizeof(std::uint16_t) : sizeof(std::uint32_t));
 
 	auto geo = std::make_unique<MeshGeometry>();
 	geo->Name = "waterGeo";
 
-	// Set dynamically.
-	geo->VertexBufferCPU = nullptr;
-	geo->VertexBufferGPU = nullptr;
+	if(mWavesHeightmapEnabled)
+	{
+		// The flat grid: x/z and TexC never change, WavesVS supplies the rest.
+		std::vector<Vertex> vertices(mWaves->VertexCount());
+		mWaves->WriteVertices(Span<WavesVertex>(reinterpret_cast<WavesVertex*>(vertices.data()), vertices.size()));
+		for(Vertex& v : vertices)
+		{
+			v.Pos.y = 0.0f;
+			v.Normal = XMFLOAT3(0.0f, 1.0f, 0.0f);
+		}
+
+		ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo->VertexBufferCPU));
+		CopyMemory(geo->VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+		geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
+			mCommandList.Get(), vertices.data(), vbByteSize, geo->VertexBufferUploader);
+	}
+	else
+	{
+		// Set dynamically.
+		geo->VertexBufferCPU = nullptr;
+		geo->VertexBufferGPU = nullptr;
+	}
 
 	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo->IndexBufferCPU));
-	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+	CopyMemory(geo->IndexBufferCPU->GetBufferPointer(), indexData, ibByteSize);
 
 	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(),
-		mCommandList.Get(), indices.data(), ibByteSize, geo->IndexBufferUploader);
+		mCommandList.Get(), indexData, ibByteSize, geo->IndexBufferUploader);
 
 	geo->VertexByteStride = sizeof(Vertex);
 	geo->VertexBufferByteSize = vbByteSize;
-	geo->IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo->IndexFormat = indices16 ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
 	geo->IndexBufferByteSize = ibByteSize;
 
 	SubmeshGeometry submesh;
@@ -833,14 +1112,28 @@ void TexWavesApp::BuildPSOs()
 	opaquePsoDesc.SampleDesc.Quality = m4xMsaaState ? (m4xMsaaQuality - 1) : 0;
 	opaquePsoDesc.DSVFormat = mDepthStencilFormat;
     ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&opaquePsoDesc, IID_PPV_ARGS(&mPSOs["opaque"])));
+
+	// PSO for waves displaced by the heightmap.
+	D3D12_GRAPHICS_PIPELINE_STATE_DESC wavesPsoDesc = opaquePsoDesc;
+	wavesPsoDesc.VS =
+	{
+		reinterpret_cast<BYTE*>(mShaders["wavesVS"]->GetBufferPointer()),
+		mShaders["wavesVS"]->GetBufferSize()
+	};
+	ThrowIfFailed(md3dDevice->CreateGraphicsPipelineState(&wavesPsoDesc, IID_PPV_ARGS(&mPSOs["wavesHeightmap"])));
 }
 
 void TexWavesApp::BuildFrameResources()
 {
+    // With heightmap output each frame uploads the two planes instead of a VB.
+    UINT waveVertCount = mWavesHeightmapEnabled ? 0 : mWavesSurface->VertexCount();
+    UINT heightmapByteSize = mWavesHeightmapEnabled
+        ? (UINT)(mWavesNormalOffset + (UINT64)mWaves->RowCount()*mWavesNormalRowPitch) : 0;
+
     for(int i = 0; i < gNumFrameResources; ++i)
     {
         mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(),
-            1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), mWaves->VertexCount()));
+            1, (UINT)mAllRitems.size(), (UINT)mMaterials.size(), waveVertCount, heightmapByteSize));
     }
 }
 
@@ -892,7 +1185,8 @@ void TexWavesApp::BuildRenderItems()
 
     mWavesRitem = wavesRitem.get();
 
-	mRitemLayer[(int)RenderLayer::Opaque].push_back(wavesRitem.get());
+	RenderLayer wavesLayer = mWavesHeightmapEnabled ? RenderLayer::WavesHeightmap : RenderLayer::Opaque;
+	mRitemLayer[(int)wavesLayer].push_back(wavesRitem.get());
 
     auto gridRitem = std::make_unique<RenderItem>();
     gridRitem->World = MathHelper::Identity4x4();
@@ -1028,4 +1322,43 @@ XMFLOAT3 TexWavesApp::GetHillsNormal(float x, float z)const
     XMStoreFloat3(&n, unitNormal);
 
     return n;
+}
+
+void TexWavesApp::ApplyHills(Span<GeometryGenerator::Vertex> vertices)const
+{
+    size_t count = vertices.Size();
+    size_t i = 0;
+    for(; i + 4 <= count; i += 4)
+    {
+        GeometryGenerator::Vertex* v = &vertices[i];
+        XMVECTOR x = XMVectorSet(v[0].Position.x, v[1].Position.x, v[2].Position.x, v[3].Position.x);
+        XMVECTOR z = XMVectorSet(v[0].Position.z, v[1].Position.z, v[2].Position.z, v[3].Position.z);
+        XMVECTOR sinX, cosX, sinZ, cosZ;
+        XMVectorSinCos(&sinX, &cosX, XMVectorScale(x, 0.1f));
+        XMVectorSinCos(&sinZ, &cosZ, XMVectorScale(z, 0.1f));
+
+        // The height of GetHillsHeight and the (-df/dx, 1, -df/dz) of
+        // GetHillsNormal, one vector per axis.
+        XMVECTOR h = XMVectorScale(XMVectorMultiplyAdd(z, sinX, XMVectorMultiply(x, cosZ)), 0.3f);
+        XMVECTOR nx = XMVectorSubtract(XMVectorScale(XMVectorMultiply(z, cosX), -0.03f), XMVectorScale(cosZ, 0.3f));
+        XMVECTOR nz = XMVectorSubtract(XMVectorScale(XMVectorMultiply(x, sinZ), 0.03f), XMVectorScale(sinX, 0.3f));
+        XMVECTOR invLength = XMVectorReciprocalSqrt(
+            XMVectorAdd(XMVectorMultiplyAdd(nx, nx, XMVectorMultiply(nz, nz)), XMVectorReplicate(1.0f)));
+
+        XMFLOAT4 hs, nxs, nys, nzs;
+        XMStoreFloat4(&hs, h);
+        XMStoreFloat4(&nxs, XMVectorMultiply(nx, invLength));
+        XMStoreFloat4(&nys, invLength);
+        XMStoreFloat4(&nzs, XMVectorMultiply(nz, invLength));
+        v[0].Position.y = hs.x; v[0].Normal = XMFLOAT3(nxs.x, nys.x, nzs.x);
+        v[1].Position.y = hs.y; v[1].Normal = XMFLOAT3(nxs.y, nys.y, nzs.y);
+        v[2].Position.y = hs.z; v[2].Normal = XMFLOAT3(nxs.z, nys.z, nzs.z);
+        v[3].Position.y = hs.w; v[3].Normal = XMFLOAT3(nxs.w, nys.w, nzs.w);
+    }
+
+    for(; i < count; ++i)
+    {
+        vertices[i].Position.y = GetHillsHeight(vertices[i].Position.x, vertices[i].Position.z);
+        vertices[i].Normal = GetHillsNormal(vertices[i].Position.x, vertices[i].Position.z);
+    }
 }
\ No newline at end of file
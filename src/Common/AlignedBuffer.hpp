@@ -0,0 +1,138 @@
+#pragma once
+
+#include <Common/PageAllocator.hpp>
+#include <Common/defines.hpp>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <utility>
+
+// Owning, fixed-size array of trivially copyable elements whose first element
+// is aligned to a caller-specified boundary. Used for SIMD-friendly planes of
+// simulation data where std::vector cannot guarantee more than alignof(T).
+// Can also adopt external memory (e.g. part of a mapped file) as a non-owning
+// view with the same interface.
+template <typename T>
+class AlignedBuffer
+{
+public:
+    AlignedBuffer() = default;
+
+    AlignedBuffer(size_t count, size_t alignment = 64)
+    {
+        Reset(count, alignment);
+    }
+
+    AlignedBuffer(const AlignedBuffer&) = delete;
+    AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+
+    AlignedBuffer(AlignedBuffer&& rhs) noexcept
+    {
+        Swap(rhs);
+    }
+
+    AlignedBuffer& operator=(AlignedBuffer&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            Release();
+            Swap(rhs);
+        }
+        return *this;
+    }
+
+    ~AlignedBuffer()
+    {
+        Release();
+    }
+
+    // Reallocates the buffer to hold count zero-initialized elements. Under
+    // any policy but Heap the memory comes zero-filled from the OS and is not
+    // touched here, so its pages land on the NUMA node of whichever thread
+    // writes them first (see PagePolicy); it is 128-byte aligned, which
+    // covers any alignment up to that.
+    void Reset(size_t count, size_t alignment = 64, PagePolicy policy = PagePolicy::Heap)
+    {
+        Release();
+        if (count == 0)
+        {
+            return;
+        }
+        mAlignment = alignment;
+        mPolicy = policy;
+        mSize = count;
+        mOwned = true;
+        if (policy != PagePolicy::Heap)
+        {
+            assert(alignment <= 128);
+            mData = static_cast<T*>(AllocatePages(count * sizeof(T), policy));
+            if (mData == nullptr)
+            {
+                mSize = 0;
+                mOwned = false;
+                throw std::bad_alloc();
+            }
+            return;
+        }
+        mData = static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(alignment)));
+        memset(mData, 0, count * sizeof(T));
+    }
+
+    // Releases the current elements and views count elements at data instead.
+    // The memory is not freed by the buffer and must stay valid until the next
+    // Reset / Adopt or the buffer's destruction.
+    void Adopt(T* data, size_t count)
+    {
+        Release();
+        mData = data;
+        mSize = data != nullptr ? count : 0;
+        mOwned = false;
+    }
+
+    void Swap(AlignedBuffer& rhs) noexcept
+    {
+        std::swap(mData, rhs.mData);
+        std::swap(mSize, rhs.mSize);
+        std::swap(mAlignment, rhs.mAlignment);
+        std::swap(mOwned, rhs.mOwned);
+        std::swap(mPolicy, rhs.mPolicy);
+    }
+
+    T*       Data()       { return mData; }
+    const T* Data() const { return mData; }
+    size_t   Size() const { return mSize; }
+    size_t   ByteSize() const { return mSize * sizeof(T); }
+    bool     Empty() const { return mSize == 0; }
+    bool     Owned() const { return mOwned; }
+    PagePolicy Policy() const { return mPolicy; }
+
+    T&       operator[](size_t i)       { return mData[i]; }
+    const T& operator[](size_t i) const { return mData[i]; }
+
+private:
+    void Release()
+    {
+        if (mData != nullptr && mOwned)
+        {
+            if (mPolicy != PagePolicy::Heap)
+            {
+                FreePages(mData, mSize * sizeof(T), mPolicy);
+            }
+            else
+            {
+                ::operator delete(mData, std::align_val_t(mAlignment));
+            }
+        }
+        mData = nullptr;
+        mSize = 0;
+        mOwned = false;
+        mPolicy = PagePolicy::Heap;
+    }
+
+    T*     mData = nullptr;
+    size_t mSize = 0;
+    size_t mAlignment = 64;
+    bool   mOwned = false;
+    PagePolicy mPolicy = PagePolicy::Heap;
+};
@@ -0,0 +1,260 @@
+#include <Common/AsyncWaves.hpp>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    f64 MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<f64, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+template <typename Fn>
+void WavesFrame::ForEachChangedRange(u64 dstSerial, std::vector<WavesRowRange>* rows, Fn copy)const
+{
+    if (rows != nullptr)
+    {
+        rows->clear();
+    }
+    if (dstSerial >= Serial)
+    {
+        return;
+    }
+
+    i32 rowCount = (i32)RowSerials.size();
+    for (i32 i = 0; i < rowCount;)
+    {
+        if (RowSerials[i] <= dstSerial)
+        {
+            ++i;
+            continue;
+        }
+
+        WavesRowRange range;
+        range.First = i;
+        while (i < rowCount && RowSerials[i] > dstSerial)
+        {
+            ++i;
+        }
+        range.Last = i;
+
+        copy(range);
+        if (rows != nullptr)
+        {
+            rows->push_back(range);
+        }
+    }
+}
+
+u64 WavesFrame::CopyVertices(WavesVertex* dst, u64 dstSerial, std::vector<WavesRowRange>* rows)const
+{
+    size_t rowSize = Columns;
+    u64 bytes = 0;
+    ForEachChangedRange(dstSerial, rows, [&](const WavesRowRange& range)
+    {
+        size_t count = (size_t)(range.Last - range.First) * rowSize;
+        memcpy(dst + (size_t)range.First * rowSize, Vertices.Data() + (size_t)range.First * rowSize,
+            count * sizeof(WavesVertex));
+        bytes += count * sizeof(WavesVertex);
+    });
+    return bytes;
+}
+
+u64 WavesFrame::CopyHeightmap(const WavesHeightmap& dst, u64 dstSerial, std::vector<WavesRowRange>* rows)const
+{
+    // Whole pitched ranges when the layouts agree, otherwise row by row.
+    auto copyPlane = [](u8* dstPlane, u32 dstPitch, const u8* srcPlane, u32 srcPitch, u32 rowBytes,
+        const WavesRowRange& range)
+    {
+        if (dstPitch == srcPitch)
+        {
+            size_t offset = (size_t)range.First * srcPitch;
+            size_t size = (size_t)(range.Last - range.First - 1) * srcPitch + rowBytes;
+            memcpy(dstPlane + offset, srcPlane + offset, size);
+            return (u64)size;
+        }
+
+        for (i32 i = range.First; i < range.Last; ++i)
+        {
+            memcpy(dstPlane + (size_t)i * dstPitch, srcPlane + (size_t)i * srcPitch, rowBytes);
+        }
+        return (u64)(range.Last - range.First) * rowBytes;
+    };
+
+    u32 texelSize = (Heightmap.HeightFormat == WavesHeightFormat::R16F) ? 2 : 4;
+
+    u64 bytes = 0;
+    ForEachChangedRange(dstSerial, rows, [&](const WavesRowRange& range)
+    {
+        bytes += copyPlane(dst.Heights.Data(), dst.HeightRowPitch, HeightData.Data(), Heightmap.HeightRowPitch,
+            Columns * texelSize, range);
+        if (!dst.Normals.Empty())
+        {
+            bytes += copyPlane(dst.Normals.Data(), dst.NormalRowPitch, NormalData.Data(), Heightmap.NormalRowPitch,
+                Columns * 2, range);
+        }
+    });
+    return bytes;
+}
+
+AsyncWaves::AsyncWaves(Waves& waves, WavesOutput output, WavesHeightFormat heightFormat)
+    : mWaves(waves), mOutput(output)
+{
+    mRowSerials.assign(mWaves.RowCount(), 0);
+
+    for (u32 i = 0; i < 3; ++i)
+    {
+        WavesFrame& frame = mFrames.Slot(i);
+        frame.RowSerials.assign(mWaves.RowCount(), 0);
+        frame.Columns = (u32)mWaves.ColumnCount();
+        if (mOutput == WavesOutput::Vertices)
+        {
+            frame.Vertices.Reset(mWaves.VertexCount(), 64);
+            continue;
+        }
+
+        WavesHeightmap& heightmap = frame.Heightmap;
+        heightmap.HeightFormat = heightFormat;
+        heightmap.HeightRowPitch = mWaves.HeightmapRowPitch(heightFormat);
+        heightmap.NormalRowPitch = mWaves.NormalmapRowPitch();
+        frame.HeightData.Reset((size_t)mWaves.RowCount() * heightmap.HeightRowPitch, 64);
+        frame.NormalData.Reset((size_t)mWaves.RowCount() * heightmap.NormalRowPitch, 64);
+        heightmap.Heights = Span<u8>(frame.HeightData.Data(), frame.HeightData.Size());
+        heightmap.Normals = Span<u8>(frame.NormalData.Data(), frame.NormalData.Size());
+    }
+
+    // The consumer starts out with the current solution, so Latest() always has
+    // something to return.
+    WavesFrame& front = mFrames.Front();
+    WriteFrame(front);
+    front.SubmitTime = std::chrono::steady_clock::now();
+    mLastSerial = front.Serial;
+
+    mWorker = std::thread(&AsyncWaves::WorkerMain, this);
+}
+
+AsyncWaves::~AsyncWaves()
+{
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mJobDone.wait(lock, [this]() { return !mBusy; });
+        mQuit = true;
+    }
+    mJobReady.notify_one();
+    mWorker.join();
+}
+
+void AsyncWaves::Disturb(const WavesImpulse& impulse)
+{
+    mImpulses.push_back(impulse);
+}
+
+void AsyncWaves::Submit(f32 dt)
+{
+    auto now = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    if (mBusy)
+    {
+        // The previous update is still running a full frame later.
+        mJobDone.wait(lock, [this]() { return !mBusy; });
+        mStats.Stalls++;
+        mStats.LastStallMs = MillisecondsSince(now);
+        mStats.TotalStallMs += mStats.LastStallMs;
+    }
+
+    mJobDt = dt;
+    mJobFrame = ++mStats.Submitted;
+    mJobSubmitTime = now;
+    mJobImpulses.swap(mImpulses);
+    mImpulses.clear();
+    mBusy = true;
+
+    lock.unlock();
+    mJobReady.notify_one();
+}
+
+const WavesFrame& AsyncWaves::Latest()
+{
+    if (mFrames.Update())
+    {
+        const WavesFrame& frame = mFrames.Front();
+        mStats.Skipped += frame.Serial - mLastSerial - 1;
+        mStats.LastLatencyMs = MillisecondsSince(frame.SubmitTime);
+        mStats.LastSimMs = frame.SimMs;
+        mLastSerial = frame.Serial;
+    }
+
+    const WavesFrame& frame = mFrames.Front();
+    mStats.Staleness = mStats.Submitted - frame.Frame;
+    return frame;
+}
+
+void AsyncWaves::Wait()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mJobDone.wait(lock, [this]() { return !mBusy; });
+}
+
+void AsyncWaves::WorkerMain()
+{
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mJobReady.wait(lock, [this]() { return mBusy || mQuit; });
+        if (mQuit)
+        {
+            return;
+        }
+
+        f32 dt = mJobDt;
+        u64 jobFrame = mJobFrame;
+        auto submitTime = mJobSubmitTime;
+        lock.unlock();
+
+        // mJobImpulses is only swapped while no update is in flight.
+        auto start = std::chrono::steady_clock::now();
+        if (!mJobImpulses.empty())
+        {
+            mWaves.DisturbBatch(Span<const WavesImpulse>(mJobImpulses));
+        }
+        mWaves.Update(dt);
+
+        WavesFrame& frame = mFrames.Back();
+        WriteFrame(frame);
+        frame.Frame = jobFrame;
+        frame.SubmitTime = submitTime;
+        frame.SimMs = MillisecondsSince(start);
+        mFrames.Publish();
+
+        lock.lock();
+        mBusy = false;
+        lock.unlock();
+        mJobDone.notify_all();
+    }
+}
+
+void AsyncWaves::WriteFrame(WavesFrame& frame)
+{
+    // Each slot tracks its own version, so only tiles that changed since the
+    // slot was last filled are rewritten.
+    if (mOutput == WavesOutput::Vertices)
+    {
+        mWaves.WriteVertices(Span<WavesVertex>(frame.Vertices.Data(), frame.Vertices.Size()),
+            &frame.Version, mWaves.InterpolationAlpha(), &mWriteStats);
+    }
+    else
+    {
+        mWaves.WriteHeightmap(frame.Heightmap, &frame.Version, mWaves.InterpolationAlpha(), &mWriteStats);
+    }
+    frame.Serial = ++mSerial;
+
+    // The slot's previous contents are older than the last solution, so the rows
+    // rewritten here cover every row that changed since then.
+    for (const WavesRowRange& range : mWriteStats.DirtyRows)
+    {
+        std::fill(mRowSerials.begin() + range.First, mRowSerials.begin() + range.Last, frame.Serial);
+    }
+    frame.RowSerials = mRowSerials;
+}
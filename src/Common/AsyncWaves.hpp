@@ -0,0 +1,152 @@
+#pragma once
+
+#include <Common/Waves.hpp>
+#include <Common/AlignedBuffer.hpp>
+#include <Common/TripleBuffer.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// What AsyncWaves produces for every solution: full vertices, or heights and
+// octahedral normals for vertex-shader displacement (see Waves::WriteHeightmap).
+enum class WavesOutput
+{
+    Vertices,
+    Heightmap
+};
+
+// One finished solution, ready to be copied into a vertex buffer or texture.
+struct WavesFrame
+{
+    // WavesOutput::Vertices.
+    AlignedBuffer<WavesVertex> Vertices;
+
+    // WavesOutput::Heightmap: row-pitched planes described by Heightmap, which
+    // points into HeightData and NormalData.
+    AlignedBuffer<u8> HeightData;
+    AlignedBuffer<u8> NormalData;
+    WavesHeightmap Heightmap;
+
+    // Increases by one for every published solution, so consumers can tell
+    // whether a buffer already holds this one.
+    u64 Serial = 0;
+
+    // Serial of the solution in which each grid row last changed. A buffer
+    // holding solution s only needs the rows with RowSerials[row] > s.
+    std::vector<u64> RowSerials;
+    u32 Columns = 0;
+
+    // AsyncWaves::Submit() call (1-based) the solution was produced for.
+    u64 Frame = 0;
+
+    // Destination version for Waves::WriteVertices; private to the worker.
+    u64 Version = 0;
+
+    // When the update was submitted, and how long the worker spent on it
+    // (simulation + vertex output).
+    std::chrono::steady_clock::time_point SubmitTime;
+    f64 SimMs = 0.0;
+
+    // Bring dst, laid out like Vertices / the heightmap planes and holding
+    // solution dstSerial, up to this solution by copying only the rows that
+    // changed since. Return the bytes copied; rows, if given, receives the
+    // row ranges.
+    u64 CopyVertices(WavesVertex* dst, u64 dstSerial, std::vector<WavesRowRange>* rows = nullptr)const;
+    u64 CopyHeightmap(const WavesHeightmap& dst, u64 dstSerial, std::vector<WavesRowRange>* rows = nullptr)const;
+
+private:
+    template <typename Fn>
+    void ForEachChangedRange(u64 dstSerial, std::vector<WavesRowRange>* rows, Fn copy)const;
+};
+
+struct AsyncWavesStats
+{
+    u64 Submitted = 0;
+
+    // Solutions that were superseded before Latest() got to see them.
+    u64 Skipped = 0;
+
+    // Submit() calls that had to wait because the previous update was still running.
+    u64 Stalls = 0;
+    f64 LastStallMs = 0.0;
+    f64 TotalStallMs = 0.0;
+
+    // Worker time of the solution returned by the last Latest().
+    f64 LastSimMs = 0.0;
+
+    // Submit-to-first-use time of the solution returned by the last Latest().
+    f64 LastLatencyMs = 0.0;
+
+    // How many Submit() calls the solution returned by the last Latest() is
+    // behind. With the usual Latest()-then-Submit() order, 0 means it is the
+    // result of the previous frame's update.
+    u64 Staleness = 0;
+};
+
+// Runs a Waves simulation on a background thread, one update per frame, so the
+// stepping overlaps with command recording. Each frame the caller takes the
+// newest finished solution with Latest() and starts the next update with
+// Submit(). Finished solutions are handed over through a lock-free triple
+// buffer; Submit() only blocks when the previous update has not finished by
+// then, i.e. when the simulation has fallen a full frame behind.
+//
+// While the worker runs, the Waves object must not be touched directly; queue
+// impulses with Disturb() and use Wait() before reconfiguring it.
+class AsyncWaves
+{
+public:
+    explicit AsyncWaves(Waves& waves, WavesOutput output = WavesOutput::Vertices,
+        WavesHeightFormat heightFormat = WavesHeightFormat::R16F);
+    AsyncWaves(const AsyncWaves&) = delete;
+    AsyncWaves& operator=(const AsyncWaves&) = delete;
+    ~AsyncWaves();
+
+    // Queues an impulse for the next Submit(); its Delay counts from the start of
+    // that update.
+    void Disturb(const WavesImpulse& impulse);
+
+    // Starts advancing the simulation by dt seconds on the worker.
+    void Submit(f32 dt);
+
+    // Newest finished solution. Valid until the next call to Latest().
+    const WavesFrame& Latest();
+
+    // Blocks until the worker is idle.
+    void Wait();
+
+    const AsyncWavesStats& Stats() const { return mStats; }
+
+private:
+    void WorkerMain();
+    void WriteFrame(WavesFrame& frame);
+
+    Waves& mWaves;
+    WavesOutput mOutput = WavesOutput::Vertices;
+
+    TripleBuffer<WavesFrame> mFrames;
+    u64 mSerial = 0;
+
+    // Worker side: row serials of the newest solution, and the last write's report.
+    std::vector<u64> mRowSerials;
+    WavesWriteStats mWriteStats;
+
+    // Job hand-off. mImpulses collects impulses on the main thread; they are
+    // swapped into mJobImpulses when an update is submitted.
+    std::mutex mMutex;
+    std::condition_variable mJobReady;
+    std::condition_variable mJobDone;
+    bool mBusy = false;
+    bool mQuit = false;
+    f32 mJobDt = 0.0f;
+    u64 mJobFrame = 0;
+    std::chrono::steady_clock::time_point mJobSubmitTime;
+    std::vector<WavesImpulse> mImpulses;
+    std::vector<WavesImpulse> mJobImpulses;
+
+    AsyncWavesStats mStats;
+    u64 mLastSerial = 0;
+
+    std::thread mWorker;
+};
@@ -0,0 +1,157 @@
+#include <Common/Fft.hpp>
+#include <Common/JobSystem.hpp>
+#include <Common/WavesKernels.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+Fft2D::Fft2D(u32 size)
+    : mSize(size)
+{
+    assert(size >= 2 && (size & (size - 1)) == 0);
+
+    u32 log2 = 0;
+    while ((1u << log2) < size)
+    {
+        ++log2;
+    }
+    mStageCount = log2 / 2 + log2 % 2;
+
+    mCos.Reset(size);
+    mSin.Reset(size);
+    for (u32 k = 0; k < size; ++k)
+    {
+        f64 angle = 6.283185307179586 * k / size;
+        mCos[k] = (f32)cos(angle);
+        mSin[k] = (f32)sin(angle);
+    }
+
+    mWorkPitch = (i32)size + 16;
+    for (auto& grid : mWork)
+    {
+        grid[0].Reset((size_t)size * mWorkPitch);
+        grid[1].Reset((size_t)size * mWorkPitch);
+    }
+}
+
+i32 Fft2D::ColumnGrain() const
+{
+    // ~16K cells per job, in whole AVX2 vectors.
+    i32 grain = (16 * 1024) / (i32)mSize;
+    return std::max(8, grain & ~7);
+}
+
+void Fft2D::TransformTransposed(f32* re, f32* im, FftDirection direction)
+{
+    const i32 n = (i32)mSize;
+    const Grid user = { re, im, n };
+    const Grid a = { mWork[0][0].Data(), mWork[0][1].Data(), mWorkPitch };
+    const Grid b = { mWork[1][0].Data(), mWork[1][1].Data(), mWorkPitch };
+
+    // Down the columns of the input into a, transpose into b, then down the
+    // columns of b back into the caller's planes. Only the padded grids see
+    // the intermediate stages; the last stage before a must not write a.
+    const bool even = mStageCount % 2 == 0;
+    JobSystem::Get().ParallelFor(0, n, ColumnGrain(), [&](i32 firstCol, i32 lastCol)
+    {
+        ColumnPass(user, a, even ? b : a, even ? a : b, firstCol, lastCol, direction);
+    });
+
+    Transpose(a.Re, a.Pitch, b.Re, b.Pitch);
+    Transpose(a.Im, a.Pitch, b.Im, b.Pitch);
+
+    JobSystem::Get().ParallelFor(0, n, ColumnGrain(), [&](i32 firstCol, i32 lastCol)
+    {
+        ColumnPass(b, user, a, b, firstCol, lastCol, direction);
+    });
+}
+
+void Fft2D::ColumnPass(const Grid& src, const Grid& dst, const Grid& scratch0, const Grid& scratch1,
+                       i32 firstCol, i32 lastCol, FftDirection direction) const
+{
+    const i32 size = (i32)mSize;
+    const i32 width = lastCol - firstCol;
+    const f32 sign = direction == FftDirection::Forward ? -1.0f : 1.0f;
+
+    // Element r of the sequence is the segment of row r in the slab.
+    auto row = [firstCol](const Grid& grid, i32 r)
+    {
+        size_t offset = (size_t)r * grid.Pitch + firstCol;
+        return WavesKernels::FftRow{ grid.Re + offset, grid.Im + offset };
+    };
+
+    const Grid* in = &src;
+    i32 n = size; // Length of the sub-transforms still to do.
+    i32 s = 1;    // Their stride (and count).
+    for (u32 stage = 0; n > 1; ++stage)
+    {
+        const Grid* out = stage + 1 == mStageCount ? &dst : stage % 2 == 0 ? &scratch0 : &scratch1;
+
+        if (n >= 4)
+        {
+            const i32 quarter = n / 4;
+            const i32 twiddleStep = size / n;
+            for (i32 p = 0; p < quarter; ++p)
+            {
+                f32 twiddles[6];
+                for (i32 k = 1; k <= 3; ++k)
+                {
+                    i32 t = k * p * twiddleStep;
+                    twiddles[2 * k - 2] = mCos[t];
+                    twiddles[2 * k - 1] = sign * mSin[t];
+                }
+
+                for (i32 q = 0; q < s; ++q)
+                {
+                    WavesKernels::FftRow inRows[4], outRows[4];
+                    for (i32 k = 0; k < 4; ++k)
+                    {
+                        inRows[k] = row(*in, q + s * (p + k * quarter));
+                        outRows[k] = row(*out, q + s * (4 * p + k));
+                    }
+                    WavesKernels::FftRadix4(inRows, outRows, twiddles, sign, width);
+                }
+            }
+            n = quarter;
+            s *= 4;
+        }
+        else
+        {
+            // Odd power of two: one radix-2 stage of length 2 remains.
+            const f32 one[2] = { 1.0f, 0.0f };
+            for (i32 q = 0; q < s; ++q)
+            {
+                WavesKernels::FftRow inRows[2] = { row(*in, q), row(*in, q + s) };
+                WavesKernels::FftRow outRows[2] = { row(*out, q), row(*out, q + s) };
+                WavesKernels::FftRadix2(inRows, outRows, one, width);
+            }
+            n = 1;
+            s *= 2;
+        }
+
+        in = out;
+    }
+}
+
+void Fft2D::Transpose(const f32* src, i32 srcPitch, f32* dst, i32 dstPitch) const
+{
+    const i32 size = (i32)mSize;
+    const i32 block = std::min(size, 32);
+
+    JobSystem::Get().ParallelFor(0, size / block, std::max(1, 64 / block), [=](i32 firstBlock, i32 lastBlock)
+    {
+        for (i32 bi = firstBlock * block; bi < lastBlock * block; bi += block)
+        {
+            for (i32 bj = 0; bj < size; bj += block)
+            {
+                for (i32 i = bi; i < bi + block; ++i)
+                {
+                    for (i32 j = bj; j < bj + block; ++j)
+                    {
+                        dst[(size_t)j * dstPitch + i] = src[(size_t)i * srcPitch + j];
+                    }
+                }
+            }
+        }
+    });
+}
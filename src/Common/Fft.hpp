@@ -0,0 +1,69 @@
+#pragma once
+
+#include <Common/AlignedBuffer.hpp>
+#include <Common/defines.hpp>
+
+enum class FftDirection
+{
+    Forward, // exp(-2 pi i jk / N)
+    Inverse  // exp(+2 pi i jk / N), unnormalized
+};
+
+// 2D complex FFT of a square, power-of-two sized grid in split form: separate
+// real and imaginary planes, row-major with Size() floats per row.
+//
+// Both passes run a radix-4 Stockham FFT (plus one radix-2 stage for odd
+// powers of two) down the columns, treating each row segment as one SIMD
+// vector: every butterfly is a WavesKernels::FftRadix4 call over a whole
+// segment with a single twiddle, and no bit reversal is needed. Columns are
+// split into slabs that run on the JobSystem. Between the passes a blocked
+// transpose turns rows into columns.
+//
+// A third transpose to restore the orientation is skipped: the result is left
+// transposed, i.e. output element [r][c] holds the transform at [c][r]. Callers
+// that lay out their input transposed get natural output.
+class Fft2D
+{
+public:
+    explicit Fft2D(u32 size);
+    Fft2D(const Fft2D&) = delete;
+    Fft2D& operator=(const Fft2D&) = delete;
+
+    u32 Size() const { return mSize; }
+
+    // In place; re and im hold Size() * Size() floats each.
+    void TransformTransposed(f32* re, f32* im, FftDirection direction);
+
+private:
+    // Real and imaginary planes with rows Pitch floats apart.
+    struct Grid
+    {
+        f32* Re;
+        f32* Im;
+        i32 Pitch;
+    };
+
+    // 1D FFTs of length Size() down columns [firstCol, lastCol) of src into
+    // dst. The stages before the last write scratch0, scratch1, scratch0, ...;
+    // the caller picks them so that no stage writes the grid it reads.
+    void ColumnPass(const Grid& src, const Grid& dst, const Grid& scratch0, const Grid& scratch1,
+                    i32 firstCol, i32 lastCol, FftDirection direction) const;
+
+    void Transpose(const f32* src, i32 srcPitch, f32* dst, i32 dstPitch) const;
+
+    // Columns per ColumnPass job.
+    i32 ColumnGrain() const;
+
+    u32 mSize = 0;
+    u32 mStageCount = 0;
+
+    // cos / sin of 2 pi k / Size() for k in [0, Size()).
+    AlignedBuffer<f32> mCos;
+    AlignedBuffer<f32> mSin;
+
+    // Two scratch grids (real and imaginary planes). Their rows are padded so
+    // that the power-of-two strides of the butterflies and the transpose do
+    // not map every row onto the same cache sets.
+    i32 mWorkPitch = 0;
+    AlignedBuffer<f32> mWork[2][2];
+};
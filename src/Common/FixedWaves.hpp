@@ -0,0 +1,304 @@
+#pragma once
+
+#include <Common/JobSystem.hpp>
+#include <Common/Waves.hpp>
+#include <Common/WavesKernels.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+// Simulation constants of a FixedWaves instantiation, as a type with static
+// constexpr members so the stencil coefficients fold into the code:
+//   struct PondParams
+//   {
+//       static constexpr f32 SpatialStep = 1.0f;
+//       static constexpr f32 TimeStep = 0.03f;
+//       static constexpr f32 Speed = 4.0f;
+//       static constexpr f32 Damping = 0.2f;
+//   };
+// WavesDemoParams are the constants the chapter 7/8 demos use.
+struct WavesDemoParams
+{
+    static constexpr f32 SpatialStep = 1.0f;
+    static constexpr f32 TimeStep = 0.03f;
+    static constexpr f32 Speed = 4.0f;
+    static constexpr f32 Damping = 0.2f;
+};
+
+// Waves with the grid size and constants fixed at compile time. Rows, the row
+// pitch and the stencil coefficients are constants, so the inner loops have
+// known trip counts and the row offsets are shifts; the two height planes are
+// plain member arrays, so a small pond can live in static storage or on the
+// stack without any heap allocation. Stepping produces the same heights as
+// Waves with planar storage and the same constants.
+//
+// Only the state the accessors need is kept: heights for two time levels.
+// Normals and tangents are derived on demand, and WriteVertices always writes
+// the whole grid (dstVersion only skips writes when nothing changed).
+template <i32 Rows, i32 Cols, typename Params = WavesDemoParams>
+class FixedWaves final : public WavesSurface
+{
+    static_assert(Rows >= 5 && Cols >= 5, "Disturb needs at least a 5x5 grid.");
+
+public:
+    // Floats between rows; rows start on 64-byte boundaries.
+    static constexpr i32 RowPitch = (Cols + 15) & ~15;
+
+    static constexpr f32 SpatialStep = Params::SpatialStep;
+    static constexpr f32 TimeStep = Params::TimeStep;
+
+    // Same expressions (and so the same values) as the Waves constructor.
+    static constexpr f32 D = Params::Damping * Params::TimeStep + 2.0f;
+    static constexpr f32 E = (Params::Speed * Params::Speed) * (Params::TimeStep * Params::TimeStep) /
+                             (Params::SpatialStep * Params::SpatialStep);
+    static constexpr f32 K1 = (Params::Damping * Params::TimeStep - 2.0f) / D;
+    static constexpr f32 K2 = (4.0f - 8.0f * E) / D;
+    static constexpr f32 K3 = (2.0f * E) / D;
+
+    static constexpr f32 HalfWidth = (Cols - 1) * SpatialStep * 0.5f;
+    static constexpr f32 HalfDepth = (Rows - 1) * SpatialStep * 0.5f;
+
+    FixedWaves() = default;
+    FixedWaves(const FixedWaves&) = delete;
+    FixedWaves& operator=(const FixedWaves&) = delete;
+
+    i32 RowCount() const override { return Rows; }
+    i32 ColumnCount() const override { return Cols; }
+    i32 VertexCount() const override { return Rows * Cols; }
+    i32 TriangleCount() const override { return (Rows - 1) * (Cols - 1) * 2; }
+    f32 Width() const override { return Cols * SpatialStep; }
+    f32 Depth() const override { return Rows * SpatialStep; }
+    u64 Version() const override { return mVersion; }
+
+    DirectX::XMFLOAT3 Position(i32 i) const override
+    {
+        i32 row = i / Cols;
+        i32 col = i - row * Cols;
+        return DirectX::XMFLOAT3(-HalfWidth + col * SpatialStep, CurrRow(row)[col], HalfDepth - row * SpatialStep);
+    }
+
+    DirectX::XMFLOAT3 Normal(i32 i) const override
+    {
+        DirectX::XMFLOAT3 normal, tangent;
+        NormalAndTangent(i, normal, tangent);
+        return normal;
+    }
+
+    DirectX::XMFLOAT3 TangentX(i32 i) const override
+    {
+        DirectX::XMFLOAT3 normal, tangent;
+        NormalAndTangent(i, normal, tangent);
+        return tangent;
+    }
+
+    // Same scheduling as Waves::Update.
+    void Update(f32 dt) override
+    {
+        mAccumulator += dt;
+
+        i32 steps = (i32)(mAccumulator / TimeStep);
+        if (steps == 0)
+        {
+            return;
+        }
+
+        mAccumulator = std::min(std::max(mAccumulator - steps * TimeStep, 0.0f), TimeStep);
+        Step(std::min(steps, MaxSubsteps));
+    }
+
+    f32 InterpolationAlpha() const override { return mAccumulator / TimeStep; }
+
+    void Step(i32 count) override
+    {
+        ++mVersion;
+        for (; count > 0; --count)
+        {
+            if (mCurr == 0)
+            {
+                StepGrid<0>();
+            }
+            else
+            {
+                StepGrid<1>();
+            }
+            mCurr ^= 1;
+        }
+    }
+
+    void Disturb(i32 i, i32 j, f32 magnitude) override
+    {
+        // Don't disturb boundaries.
+        assert(i > 1 && i < Rows - 2);
+        assert(j > 1 && j < Cols - 2);
+
+        ++mVersion;
+        f32 halfMag = 0.5f * magnitude;
+        f32* row = mPlanes[mCurr] + i * RowPitch;
+        row[j] += magnitude;
+        row[j + 1] += halfMag;
+        row[j - 1] += halfMag;
+        row[j + RowPitch] += halfMag;
+        row[j - RowPitch] += halfMag;
+    }
+
+    void WriteVertices(Span<WavesVertex> dst, u64* dstVersion = nullptr, f32 alpha = 1.0f,
+                       WavesWriteStats* stats = nullptr) const override
+    {
+        assert(dst.Size() >= (size_t)(Rows * Cols));
+
+        bool current = alpha >= 1.0f && dstVersion && *dstVersion == mVersion;
+        if (dstVersion)
+        {
+            *dstVersion = alpha < 1.0f ? 0 : mVersion;
+        }
+        if (stats)
+        {
+            stats->BytesWritten = current ? 0 : (u64)Rows * Cols * sizeof(WavesVertex);
+            stats->DirtyRows.clear();
+            if (!current)
+            {
+                stats->DirtyRows.push_back({ 0, Rows });
+            }
+        }
+        if (current)
+        {
+            return;
+        }
+
+        f32* out = reinterpret_cast<f32*>(dst.Data());
+        ForRows(0, Rows, [this, out, alpha](i32 firstRow, i32 lastRow)
+        {
+            DirectX::XMFLOAT3 normals[Cols];
+            DirectX::XMFLOAT3 tangents[Cols];
+            f32 blended[Cols];
+            for (i32 i = firstRow; i < lastRow; ++i)
+            {
+                RowNormals(i, normals, tangents);
+
+                const f32* heights = CurrRow(i);
+                if (alpha < 1.0f)
+                {
+                    const f32* prev = mPlanes[mCurr ^ 1] + i * RowPitch;
+                    for (i32 j = 0; j < Cols; ++j)
+                    {
+                        blended[j] = prev[j] + alpha * (heights[j] - prev[j]);
+                    }
+                    heights = blended;
+                }
+
+                WavesKernels::WriteVertexRow(heights, 1, normals, 0, Cols, -HalfWidth, SpatialStep,
+                    HalfDepth - i * SpatialStep, Width(), Depth(), out + (size_t)i * Cols * 8);
+            }
+            WavesKernels::StreamFence();
+        });
+    }
+
+private:
+    static constexpr i32 MaxSubsteps = 8;
+
+    // Same row blocks as Waves (~16K cells per job); grids that fit in one
+    // block are stepped on the calling thread.
+    static constexpr i32 RowGrain = std::max<i32>(1, (16 * 1024) / Cols);
+
+    template <typename Fn>
+    static void ForRows(i32 first, i32 last, const Fn& fn)
+    {
+        if (last - first <= RowGrain)
+        {
+            fn(first, last);
+            return;
+        }
+        JobSystem::Get().ParallelFor(first, last, RowGrain, fn);
+    }
+
+    const f32* CurrRow(i32 i) const { return mPlanes[mCurr] + i * RowPitch; }
+
+    // Advances the interior by one step from plane Curr into plane 1 - Curr.
+    // With the planes named at compile time the compiler knows they don't
+    // alias, so the row loop vectorizes without runtime overlap checks.
+    template <i32 Curr>
+    void StepGrid()
+    {
+        ForRows(1, Rows - 1, [this](i32 firstRow, i32 lastRow)
+        {
+            for (i32 i = firstRow; i < lastRow; ++i)
+            {
+                const f32* curr = mPlanes[Curr] + i * RowPitch;
+                f32* next = mPlanes[Curr ^ 1] + i * RowPitch;
+                for (i32 j = 1; j < Cols - 1; ++j)
+                {
+                    next[j] = K1 * next[j] + K2 * curr[j] +
+                              K3 * (curr[j + RowPitch] + curr[j - RowPitch] + curr[j + 1] + curr[j - 1]);
+                }
+            }
+        });
+    }
+
+    // Normals and tangents of row i; the boundary keeps the flat ones.
+    void RowNormals(i32 i, DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents) const
+    {
+        normals[0] = normals[Cols - 1] = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+        tangents[0] = tangents[Cols - 1] = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
+        if (i == 0 || i == Rows - 1)
+        {
+            std::fill(normals, normals + Cols, DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f));
+            std::fill(tangents, tangents + Cols, DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f));
+            return;
+        }
+
+        const f32* mid = CurrRow(i);
+        WavesKernels::NormalRow(mid - RowPitch, mid, mid + RowPitch, Cols, SpatialStep, normals, tangents);
+    }
+
+    void NormalAndTangent(i32 i, DirectX::XMFLOAT3& normal, DirectX::XMFLOAT3& tangent) const
+    {
+        i32 row = i / Cols;
+        i32 col = i - row * Cols;
+        if (row == 0 || row == Rows - 1 || col == 0 || col == Cols - 1)
+        {
+            normal = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+            tangent = DirectX::XMFLOAT3(1.0f, 0.0f, 0.0f);
+            return;
+        }
+
+        // Same arithmetic as the scalar NormalRow kernel.
+        const f32* mid = CurrRow(row) + col;
+        f32 twoDx = 2.0f * SpatialStep;
+        f32 nx = mid[-1] - mid[1];
+        f32 nz = mid[RowPitch] - mid[-RowPitch];
+        f32 nLen = sqrtf(nx * nx + twoDx * twoDx + nz * nz);
+        normal = DirectX::XMFLOAT3(nx / nLen, twoDx / nLen, nz / nLen);
+
+        f32 ty = mid[1] - mid[-1];
+        f32 tLen = sqrtf(twoDx * twoDx + ty * ty);
+        tangent = DirectX::XMFLOAT3(twoDx / tLen, ty / tLen, 0.0f);
+    }
+
+    alignas(64) f32 mPlanes[2][Rows * RowPitch] = {};
+    u32 mCurr = 0;
+
+    f32 mAccumulator = 0.0f;
+    u64 mVersion = 1;
+};
+
+// Creates the fastest simulation for a rows x cols pond with the given
+// constants: FixedWaves for the production pond sizes (128, 256 and 512
+// squared), otherwise a run-time sized Waves with the fallback storage.
+template <typename Params = WavesDemoParams>
+std::unique_ptr<WavesSurface> MakeWaves(i32 rows, i32 cols, WavesStorage fallback = WavesStorage::Planar)
+{
+    if (rows == cols)
+    {
+        switch (rows)
+        {
+            case 128: return std::make_unique<FixedWaves<128, 128, Params>>();
+            case 256: return std::make_unique<FixedWaves<256, 256, Params>>();
+            case 512: return std::make_unique<FixedWaves<512, 512, Params>>();
+            default: break;
+        }
+    }
+    return std::make_unique<Waves>(rows, cols, Params::SpatialStep, Params::TimeStep, Params::Speed,
+        Params::Damping, fallback);
+}
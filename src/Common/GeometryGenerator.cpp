@@ -1,14 +1,177 @@
 #include <Common/GeometryGenerator.hpp>
+#include <Common/JobSystem.hpp>
 #include <algorithm>
+#include <cassert>
 
 using namespace DirectX;
 
-GeometryGenerator::MeshData GeometryGenerator::CreateBox(f32 width, f32 height, f32 depth, u32 numSubdivisions) 
+namespace
 {
-    MeshData meshData;
+    // Marks an empty slot of the edge table. No edge has this key, since an
+    // edge's first index is always the smaller one.
+    constexpr u64 EmptyEdge = ~0ull;
+
+    // An edge keyed by its endpoint indices, smaller first.
+    u64 EdgeKey(u32 a, u32 b)
+    {
+        return a < b ? ((u64)a << 32) | b : ((u64)b << 32) | a;
+    }
+
+    // The slot holding key in the open-addressed table of 2^(64 - shift)
+    // keys, or the empty slot it belongs in.
+    size_t FindEdge(const std::vector<u64>& keys, u32 shift, u64 key)
+    {
+        size_t mask = keys.size() - 1;
+        size_t i = (size_t)((key * 0x9E3779B97F4A7C15ull) >> shift);
+        while (keys[i] != key && keys[i] != EmptyEdge)
+        {
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    // Slots for the edges of numTris triangles: a power of two that stays at
+    // most 3/4 full even if no edge is shared.
+    size_t EdgeTableCapacity(size_t numTris)
+    {
+        size_t capacity = 1;
+        while (capacity < 4 * numTris)
+        {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    // Sizes a fresh edge table for the last subdivision of a mesh ending with
+    // indexCount indices, so that the earlier, smaller ones fit in it too.
+    void ReserveEdges(std::vector<u64>& keys, std::vector<u32>& midPoints, u32 numSubdivisions, size_t indexCount)
+    {
+        if (numSubdivisions == 0)
+        {
+            return;
+        }
+        size_t capacity = EdgeTableCapacity(indexCount / 12);
+        keys.reserve(capacity);
+        midPoints.reserve(capacity);
+    }
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize(u32 numSubdivisions)
+{
+    numSubdivisions = std::min<u32>(numSubdivisions, MaxSubdivisions);
+
+    // Each face becomes a (2^n + 1) x (2^n + 1) grid of vertices.
+    size_t side = ((size_t)1 << numSubdivisions) + 1;
+    return { 6 * side * side, (size_t)36 << (2 * numSubdivisions) };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(u32 sliceCount, u32 stackCount)
+{
+    // Two poles plus stackCount - 1 rings of sliceCount + 1 vertices; the top
+    // stack has one more (degenerate) triangle than the bottom one.
+    size_t ringVertexCount = sliceCount + 1;
+    return { 2 + (stackCount - 1) * ringVertexCount,
+             3 * ringVertexCount + 6 * (size_t)sliceCount * (stackCount - 2) + 3 * (size_t)sliceCount };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(u32 numSubdivisions)
+{
+    numSubdivisions = std::min<u32>(numSubdivisions, MaxSubdivisions);
+    return { ((size_t)10 << (2 * numSubdivisions)) + 2, (size_t)60 << (2 * numSubdivisions) };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(u32 sliceCount, u32 stackCount)
+{
+    // The side's rings plus, per cap, a ring and a center vertex.
+    size_t ringVertexCount = sliceCount + 1;
+    return { (stackCount + 1) * ringVertexCount + 2 * (ringVertexCount + 1),
+             6 * (size_t)sliceCount * stackCount + 2 * 3 * (size_t)sliceCount };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(u32 m, u32 n)
+{
+    return { (size_t)m * n, 6 * (size_t)(m - 1) * (n - 1) };
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::QuadSize()
+{
+    return { 4, 6 };
+}
+
+GeometryGenerator::MeshData GeometryGenerator::AllocateMesh(MeshSize size) const
+{
+    MeshData meshData(mPagePolicy);
+    meshData.Vertices.resize(size.VertexCount);
+    meshData.Indices32.resize(size.IndexCount);
+    return meshData;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::CreateBox(f32 width, f32 height, f32 depth, u32 numSubdivisions)
+{
+    // A table of its own keeps the MeshData overloads free of shared state.
+    MeshSize size = BoxSize(numSubdivisions);
+    EdgeTable edges;
+    ReserveEdges(edges.Keys, edges.MidPoints, numSubdivisions, size.IndexCount);
+    MeshData meshData = AllocateMesh(size);
+    BuildBox(width, height, depth, numSubdivisions, meshData.Vertices, meshData.Indices32, edges);
+    return meshData;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::CreateSphere(f32 radius, u32 sliceCount, u32 stackCount)
+{
+    MeshData meshData = AllocateMesh(SphereSize(sliceCount, stackCount));
+    CreateSphere(radius, sliceCount, stackCount, meshData.Vertices, meshData.Indices32);
+    return meshData;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(f32 radius, u32 numSubdivisions)
+{
+    MeshSize size = GeosphereSize(numSubdivisions);
+    EdgeTable edges;
+    ReserveEdges(edges.Keys, edges.MidPoints, numSubdivisions, size.IndexCount);
+    MeshData meshData = AllocateMesh(size);
+    BuildGeosphere(radius, numSubdivisions, meshData.Vertices, meshData.Indices32, edges);
+    return meshData;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount)
+{
+    MeshData meshData = AllocateMesh(CylinderSize(sliceCount, stackCount));
+    CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, meshData.Vertices, meshData.Indices32);
+    return meshData;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::CreateGrid(f32 width, f32 depth, u32 m, u32 n, const HeightFn& heightFn)
+{
+    MeshData meshData = AllocateMesh(GridSize(m, n));
+    CreateGrid(width, depth, m, n, meshData.Vertices, meshData.Indices32, heightFn);
+    return meshData;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::CreateQuad(f32 x, f32 y, f32 w, f32 h, f32 depth)
+{
+    MeshData meshData = AllocateMesh(QuadSize());
+    CreateQuad(x, y, w, h, depth, meshData.Vertices, meshData.Indices32);
+    return meshData;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CreateBox(f32 width, f32 height, f32 depth, u32 numSubdivisions,
+    Span<Vertex> vertices, Span<u32> indices)
+{
+    return BuildBox(width, height, depth, numSubdivisions, vertices, indices, mEdges);
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::BuildBox(f32 width, f32 height, f32 depth, u32 numSubdivisions,
+    Span<Vertex> vertices, Span<u32> indices, EdgeTable& edges)
+{
+    // Put a cap on the number of subdivisions.
+    numSubdivisions = std::min<u32>(numSubdivisions, MaxSubdivisions);
+
+    MeshSize size = BoxSize(numSubdivisions);
+    assert(vertices.Size() >= size.VertexCount && indices.Size() >= size.IndexCount);
 
     // Create the vertices.
-    Vertex v[24];
+    Vertex* v = vertices.Data();
 
     f32 w2 = .5f * width; 
     f32 h2 = .5f * height;
@@ -50,11 +213,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(f32 width, f32 height,
 	v[22] = Vertex(+w2, +h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f);
 	v[23] = Vertex(+w2, -h2, +d2, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f);
 
-    meshData.Vertices.assign(&v[0], &v[24]);
-
     // Create the indices.
-    u32 indices[36];
-    
+
     // Fill in the front face index data
 	indices[0] = 0; indices[1] = 1; indices[2] = 2;
 	indices[3] = 0; indices[4] = 2; indices[5] = 3;
@@ -79,22 +239,23 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(f32 width, f32 height,
 	indices[30] = 20; indices[31] = 21; indices[32] = 22;
 	indices[33] = 20; indices[34] = 22; indices[35] = 23;
 
-	meshData.Indices32.assign(&indices[0], &indices[36]);
-
-    // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<u32>(numSubdivisions, 6u);
-
+    u32 vertexCount = 24;
     for (u32 i = 0; i < numSubdivisions; ++i)
     {
-        Subdivide(meshData);
+        vertexCount = Subdivide(vertices.Data(), vertexCount, indices.Data(), (size_t)36 << (2 * i), edges);
     }
 
-    return meshData;
+    return size;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateSphere(f32 radius, u32 sliceCount, u32 stackCount) 
+GeometryGenerator::MeshSize GeometryGenerator::CreateSphere(f32 radius, u32 sliceCount, u32 stackCount,
+    Span<Vertex> vertices, Span<u32> indices)
 {
-    MeshData meshData; 
+    MeshSize size = SphereSize(sliceCount, stackCount);
+    assert(vertices.Size() >= size.VertexCount && indices.Size() >= size.IndexCount);
+
+    u32 vertexCount = 0;
+    size_t k = 0;
 
     // Compute the vertices stating at the top pole and moving down the stacks.
 
@@ -104,7 +265,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(f32 radius, u32 slic
     Vertex topVertex(.0f, +radius, .0f, .0f, +1.f, .0f, 1.f, .0f, .0f, .0f, .0f);
     Vertex bottomVertex(.0f, -radius, .0f, .0f, -1.f, .0f, 1.f, .0f, .0f, .0f, 1.f);
 
-    meshData.Vertices.push_back(topVertex);
+    vertices[vertexCount++] = topVertex;
 
     f32 phiStep = DX::XM_PI / stackCount;
     f32 thetaStep = 2.f * DX::XM_PI / sliceCount;
@@ -139,18 +300,18 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(f32 radius, u32 slic
             v.TexC.x = theta / DX::XM_PI;
             v.TexC.y = phi   / DX::XM_PI;
 
-            meshData.Vertices.push_back(v);
+            vertices[vertexCount++] = v;
         }
     }
-    meshData.Vertices.push_back(bottomVertex);
+    vertices[vertexCount++] = bottomVertex;
 
     // Compute indices for top stack. The top stack was written first to the vertex buffer
     // and connects the top pole to the first ring.
     for (u32 i = 0; i <= sliceCount; ++i)
     {
-        meshData.Indices32.push_back(0);
-        meshData.Indices32.push_back(i + 1);
-        meshData.Indices32.push_back(i);
+        indices[k++] = 0;
+        indices[k++] = i + 1;
+        indices[k++] = i;
     }
 
     // Compute indices for inner stacks (not connected to poles).
@@ -163,12 +324,12 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(f32 radius, u32 slic
     {
         for (u32 j = 0; j < sliceCount; ++j)
         {
-            meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j);
-            meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-            meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
-            meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j);
-            meshData.Indices32.push_back(baseIndex + i * ringVertexCount + j + 1);
-            meshData.Indices32.push_back(baseIndex + (i + 1) * ringVertexCount + j + 1);
+            indices[k++] = baseIndex + i * ringVertexCount + j;
+            indices[k++] = baseIndex + i * ringVertexCount + j + 1;
+            indices[k++] = baseIndex + (i + 1) * ringVertexCount + j;
+            indices[k++] = baseIndex + (i + 1) * ringVertexCount + j;
+            indices[k++] = baseIndex + i * ringVertexCount + j + 1;
+            indices[k++] = baseIndex + (i + 1) * ringVertexCount + j + 1;
         }
     }
 
@@ -176,27 +337,35 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(f32 radius, u32 slic
     // and connects the bottom pole to the bottom ring.
     
     // South pole vertex was added last.
-    u32 southPoleIndex = (u32)meshData.Vertices.size() - 1;
+    u32 southPoleIndex = vertexCount - 1;
 
     // Offset the indices to the index of the first vertex in the last ring.
     baseIndex = southPoleIndex - ringVertexCount;
 
     for (u32 i = 0; i < sliceCount; ++i)
     {
-        meshData.Indices32.push_back(southPoleIndex);
-        meshData.Indices32.push_back(baseIndex + i);
-        meshData.Indices32.push_back(baseIndex + i + 1);
+        indices[k++] = southPoleIndex;
+        indices[k++] = baseIndex + i;
+        indices[k++] = baseIndex + i + 1;
     }
 
-    return meshData;
+    return size;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(f32 radius, u32 numSubdivisions) 
+GeometryGenerator::MeshSize GeometryGenerator::CreateGeosphere(f32 radius, u32 numSubdivisions,
+    Span<Vertex> vertices, Span<u32> indices)
 {
-    MeshData meshData;
+    return BuildGeosphere(radius, numSubdivisions, vertices, indices, mEdges);
+}
 
+GeometryGenerator::MeshSize GeometryGenerator::BuildGeosphere(f32 radius, u32 numSubdivisions,
+    Span<Vertex> vertices, Span<u32> indices, EdgeTable& edges)
+{
     // Put a cap on the number of subdivisions.
-    numSubdivisions = std::min<u32>(numSubdivisions, 6u);
+    numSubdivisions = std::min<u32>(numSubdivisions, MaxSubdivisions);
+
+    MeshSize size = GeosphereSize(numSubdivisions);
+    assert(vertices.Size() >= size.VertexCount && indices.Size() >= size.IndexCount);
 
     // Approximate a sphere by tesselating an icosahedron.
     const f32 X = 0.525731f; 
@@ -220,54 +389,60 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(f32 radius, u32 n
 		10,1,6, 11,0,9, 2,11,9, 5,2,9,  11,2,7 
     };
     
-    meshData.Vertices.resize(12);
-    meshData.Indices32.assign(&k[0], &k[60]);
+    for (u32 i = 0; i < 60; ++i)
+        indices[i] = k[i];
 
     for (u32 i = 0; i < 12; ++i)
-        meshData.Vertices[i].Position = pos[i];
+        vertices[i].Position = pos[i];
 
+    u32 vertexCount = 12;
     for (u32 i = 0; i < numSubdivisions; ++i)
-        Subdivide(meshData);
+        vertexCount = Subdivide(vertices.Data(), vertexCount, indices.Data(), (size_t)60 << (2 * i), edges);
     
     // Project vertices onto sphere and scale.
-    for (u32 i = 0; i < meshData.Vertices.size(); ++i)
+    for (u32 i = 0; i < vertexCount; ++i)
     {
         // Project onto unit sphere.
-		DX::XMVECTOR n = DX::XMVector3Normalize(DX::XMLoadFloat3(&meshData.Vertices[i].Position));
+		DX::XMVECTOR n = DX::XMVector3Normalize(DX::XMLoadFloat3(&vertices[i].Position));
 
 		// Project onto sphere.
 		DX::XMVECTOR p = radius * n;
 
-		DX::XMStoreFloat3(&meshData.Vertices[i].Position, p);
-		DX::XMStoreFloat3(&meshData.Vertices[i].Normal, n);
+		DX::XMStoreFloat3(&vertices[i].Position, p);
+		DX::XMStoreFloat3(&vertices[i].Normal, n);
 
         // Derive texture coordinates from spherical coordinates.
-        float theta = atan2f(meshData.Vertices[i].Position.z, meshData.Vertices[i].Position.x);
+        float theta = atan2f(vertices[i].Position.z, vertices[i].Position.x);
 
         // Put in [0, 2pi].
         if(theta < 0.0f)
             theta += DX::XM_2PI;
 
-		float phi = acosf(meshData.Vertices[i].Position.y / radius);
+		float phi = acosf(vertices[i].Position.y / radius);
 
-		meshData.Vertices[i].TexC.x = theta / DX::XM_2PI;
-		meshData.Vertices[i].TexC.y = phi / DX::XM_PI;
+		vertices[i].TexC.x = theta / DX::XM_2PI;
+		vertices[i].TexC.y = phi / DX::XM_PI;
 
 		// Partial derivative of P with respect to theta
-		meshData.Vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
-		meshData.Vertices[i].TangentU.y = 0.0f;
-		meshData.Vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
+		vertices[i].TangentU.x = -radius*sinf(phi)*sinf(theta);
+		vertices[i].TangentU.y = 0.0f;
+		vertices[i].TangentU.z = +radius*sinf(phi)*cosf(theta);
 
-		DX::XMVECTOR T = DX::XMLoadFloat3(&meshData.Vertices[i].TangentU);
-		XMStoreFloat3(&meshData.Vertices[i].TangentU, DX::XMVector3Normalize(T));
+		DX::XMVECTOR T = DX::XMLoadFloat3(&vertices[i].TangentU);
+		XMStoreFloat3(&vertices[i].TangentU, DX::XMVector3Normalize(T));
     }
 
-    return meshData;
+    return size;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount) 
+GeometryGenerator::MeshSize GeometryGenerator::CreateCylinder(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount,
+    Span<Vertex> vertices, Span<u32> indices)
 {
-    MeshData meshData;
+    MeshSize size = CylinderSize(sliceCount, stackCount);
+    assert(vertices.Size() >= size.VertexCount && indices.Size() >= size.IndexCount);
+
+    u32 vertexCount = 0;
+    size_t k = 0;
 
     // Build Stacks
     f32 stackHeight = height / stackCount;
@@ -324,7 +499,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(f32 bottomRadius,
 			DX::XMVECTOR N = DX::XMVector3Normalize(DX::XMVector3Cross(T, B));
 			XMStoreFloat3(&vertex.Normal, N);
 
-			meshData.Vertices.push_back(vertex);
+			vertices[vertexCount++] = vertex;
         }
     }
 
@@ -337,30 +512,31 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(f32 bottomRadius,
 	{
 		for(u32 j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices32.push_back(i * ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1) * ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1) * ringVertexCount + j + 1);
+			indices[k++] = i * ringVertexCount + j;
+			indices[k++] = (i + 1) * ringVertexCount + j;
+			indices[k++] = (i + 1) * ringVertexCount + j + 1;
 
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i + 1) * ringVertexCount + j + 1);
-			meshData.Indices32.push_back(i * ringVertexCount + j + 1);
+			indices[k++] = i*ringVertexCount + j;
+			indices[k++] = (i + 1) * ringVertexCount + j + 1;
+			indices[k++] = i * ringVertexCount + j + 1;
 		}
 	}
 
-	BuildCylinderTopCap   (bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-
-    return meshData;
+	// Each cap is a ring plus a center vertex, fanned into sliceCount triangles.
+	u32 capVertexCount = sliceCount + 2;
+	size_t capIndexCount = 3 * (size_t)sliceCount;
+	BuildCylinderTopCap   (bottomRadius, topRadius, height, sliceCount, stackCount,
+		vertices.Subspan(vertexCount, capVertexCount), indices.Subspan(k, capIndexCount), vertexCount);
+	vertexCount += capVertexCount;
+	k += capIndexCount;
+	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount,
+		vertices.Subspan(vertexCount, capVertexCount), indices.Subspan(k, capIndexCount), vertexCount);
+
+    return size;
 }
 
-void GeometryGenerator::Subdivide(MeshData& meshData) 
+u32 GeometryGenerator::Subdivide(Vertex* vertices, u32 vertexCount, u32* indices, size_t indexCount, EdgeTable& edges)
 {
-    // Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
-
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
-
 	//       v1
 	//       *
 	//      / \
@@ -371,48 +547,65 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	u32 numTris = (u32)inputCopy.Indices32.size() / 3;
-	for(u32 i = 0; i < numTris; ++i)
+	// Every edge is split once and its midpoint shared by the triangles on
+	// either side, so the corners keep their indices and the vertices grow in
+	// place from V to V + E while each triangle becomes four.
+	size_t numTris = indexCount / 3;
+
+	// Open addressing. A table kept between calls, or reserved up front, is
+	// only allocated while it still grows.
+	size_t capacity = EdgeTableCapacity(numTris);
+	u32 shift = 64;
+	for (size_t c = capacity; c > 1; c /= 2)
+		--shift;
+	edges.Keys.assign(capacity, EmptyEdge);
+	edges.MidPoints.resize(capacity);
+
+	// New midpoints are numbered in the order their edges are first met.
+	u32 newVertexCount = vertexCount;
+	for (size_t i = 0; i < 3 * numTris; i += 3)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i * 3 + 0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i * 3 + 1 ] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i * 3 + 2] ];
-
-		// Generate the midpoints.
-
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
-
-		// Add new geometry.
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i * 6 + 0);
-		meshData.Indices32.push_back(i * 6 + 3);
-		meshData.Indices32.push_back(i * 6 + 5);
-
-		meshData.Indices32.push_back(i * 6 + 3);
-		meshData.Indices32.push_back(i * 6 + 4);
-		meshData.Indices32.push_back(i * 6 + 5);
-
-		meshData.Indices32.push_back(i * 6 + 5);
-		meshData.Indices32.push_back(i * 6 + 4);
-		meshData.Indices32.push_back(i * 6 + 2);
-
-		meshData.Indices32.push_back(i * 6 + 3);
-		meshData.Indices32.push_back(i * 6 + 1);
-		meshData.Indices32.push_back(i * 6 + 4);
-	} 
+		u32 v0 = indices[i + 0];
+		u32 v1 = indices[i + 1];
+		u32 v2 = indices[i + 2];
+		u64 keys[3] = { EdgeKey(v0, v1), EdgeKey(v1, v2), EdgeKey(v0, v2) };
+		for (u64 key : keys)
+		{
+			size_t slot = FindEdge(edges.Keys, shift, key);
+			if (edges.Keys[slot] == EmptyEdge)
+			{
+				edges.Keys[slot] = key;
+				edges.MidPoints[slot] = newVertexCount;
+				vertices[newVertexCount++] = MidPoint(vertices[(u32)(key >> 32)], vertices[(u32)key]);
+			}
+		}
+	}
+
+	// Triangle i is rewritten to indices [12i, 12i + 12), which only overlap
+	// input triangles at or after i, so going backwards needs no copy.
+	for (size_t i = numTris; i-- > 0;)
+	{
+		u32 v0 = indices[i * 3 + 0];
+		u32 v1 = indices[i * 3 + 1];
+		u32 v2 = indices[i * 3 + 2];
+
+		u32 m0 = edges.MidPoints[FindEdge(edges.Keys, shift, EdgeKey(v0, v1))];
+		u32 m1 = edges.MidPoints[FindEdge(edges.Keys, shift, EdgeKey(v1, v2))];
+		u32 m2 = edges.MidPoints[FindEdge(edges.Keys, shift, EdgeKey(v0, v2))];
+
+		u32* out = indices + i * 12;
+		out[0] = v0; out[1]  = m0; out[2]  = m2;
+		out[3] = m0; out[4]  = m1; out[5]  = m2;
+		out[6] = m2; out[7]  = m1; out[8]  = v2;
+		out[9] = m0; out[10] = v1; out[11] = m1;
+	}
+
+	return newVertexCount;
 }
 
-void GeometryGenerator::BuildCylinderTopCap(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount, MeshData& meshData) 
+void GeometryGenerator::BuildCylinderTopCap(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount,
+    Span<Vertex> vertices, Span<u32> indices, u32 baseIndex)
 {
-    u32 baseIndex = (u32)meshData.Vertices.size();
     f32 y = .5f * height;
     f32 dTheta = 2.f * DX::XM_PI / sliceCount;
 
@@ -427,20 +620,20 @@ void GeometryGenerator::BuildCylinderTopCap(f32 bottomRadius, f32 topRadius, f32
         f32 u = x / height + .5f;
         f32 v = z / height + .5f;
 
-        meshData.Vertices.push_back(Vertex(x, y, z, .0f, 1.f, .0f, 1.f, .0f, .0f, u, v));
+        vertices[i] = Vertex(x, y, z, .0f, 1.f, .0f, 1.f, .0f, .0f, u, v);
     }
 
     // Cap center vertex.
-    meshData.Vertices.push_back(Vertex(.0f, y, .0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f));
+    vertices[sliceCount + 1] = Vertex(.0f, y, .0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
     // Index of center vertex.
-    u32 centerIndex = (u32)meshData.Vertices.size() - 1;
+    u32 centerIndex = baseIndex + sliceCount + 1;
 
     for (u32 i = 0; i < sliceCount; ++i)
     {
-        meshData.Indices32.push_back(centerIndex);
-        meshData.Indices32.push_back(baseIndex + i + 1);
-        meshData.Indices32.push_back(baseIndex + i);
+        indices[3 * i + 0] = centerIndex;
+        indices[3 * i + 1] = baseIndex + i + 1;
+        indices[3 * i + 2] = baseIndex + i;
     }
 }
 
@@ -474,10 +667,10 @@ GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Ve
     return v;
 }
 
-void GeometryGenerator::BuildCylinderBottomCap(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount, MeshData& meshData) 
+void GeometryGenerator::BuildCylinderBottomCap(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount,
+    Span<Vertex> vertices, Span<u32> indices, u32 baseIndex)
 {
     // Build bottom cap.
-    u32 baseIndex = (u32)meshData.Vertices.size();
     f32 y = -.5f * height;
 
     // vertices of ring.
@@ -492,29 +685,28 @@ void GeometryGenerator::BuildCylinderBottomCap(f32 bottomRadius, f32 topRadius,
         f32 u = x / height + .5f;
         f32 v = z / height + .5f;
 
-        meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+        vertices[i] = Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v);
     }
 
     // Cap center vertex.
-    meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+    vertices[sliceCount + 1] = Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f);
 
     // Cache the index of center vertex.
-    u32 centerIndex = (u32)meshData.Vertices.size() - 1;
+    u32 centerIndex = baseIndex + sliceCount + 1;
 
     for (u32 i = 0; i < sliceCount; ++i)
     {
-        meshData.Indices32.push_back(centerIndex);
-        meshData.Indices32.push_back(baseIndex + i);
-        meshData.Indices32.push_back(baseIndex + i + 1);
+        indices[3 * i + 0] = centerIndex;
+        indices[3 * i + 1] = baseIndex + i;
+        indices[3 * i + 2] = baseIndex + i + 1;
     }
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateGrid(f32 width, f32 depth, u32 m, u32 n)
+GeometryGenerator::MeshSize GeometryGenerator::CreateGrid(f32 width, f32 depth, u32 m, u32 n,
+    Span<Vertex> vertices, Span<u32> indices, const HeightFn& heightFn)
 {
-    MeshData meshData;
-
-	u32 vertexCount = m * n;
-	u32 faceCount   = (m - 1) * (n - 1) * 2;
+    MeshSize size = GridSize(m, n);
+    assert(vertices.Size() >= size.VertexCount && indices.Size() >= size.IndexCount);
 
 	// Create the vertices.
 	f32 halfWidth = 0.5f * width;
@@ -526,88 +718,101 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(f32 width, f32 depth,
 	f32 du = 1.0f / (n - 1);
 	f32 dv = 1.0f / (m - 1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(u32 i = 0; i < m; ++i)
+	// Rows are independent: each block of rows writes its vertices, hands
+	// them to the height function while they are still in cache, and writes
+	// the indices of the quads below it (the last row has none).
+	auto buildRows = [&](i32 firstRow, i32 lastRow)
 	{
-		f32 z = halfDepth - i * dz;
-		for(u32 j = 0; j < n; ++j)
+		for(u32 i = (u32)firstRow; i < (u32)lastRow; ++i)
 		{
-			f32 x = -halfWidth + j * dx;
-
-			meshData.Vertices[i * n + j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i * n + j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i * n + j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
-
-			// Stretch texture over grid.
-			meshData.Vertices[i * n + j].TexC.x = j * du;
-			meshData.Vertices[i * n + j].TexC.y = i * dv;
+			f32 z = halfDepth - i * dz;
+			for(u32 j = 0; j < n; ++j)
+			{
+				f32 x = -halfWidth + j * dx;
+
+				vertices[i * n + j].Position = XMFLOAT3(x, 0.0f, z);
+				vertices[i * n + j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+				vertices[i * n + j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+
+				// Stretch texture over grid.
+				vertices[i * n + j].TexC.x = j * du;
+				vertices[i * n + j].TexC.y = i * dv;
+			}
 		}
-	}
- 
-	// Create the indices.
 
-	meshData.Indices32.resize(faceCount * 3); // 3 indices per face
+		if(heightFn)
+			heightFn(vertices.Subspan((size_t)firstRow * n, (size_t)(lastRow - firstRow) * n));
 
-	// Iterate over each quad and compute indices.
-	u32 k = 0;
-	for(u32 i = 0; i < m-1; ++i)
-	{
-		for(u32 j = 0; j < n-1; ++j)
+		// Iterate over each quad and compute indices, 3 per face.
+		size_t k = 6 * (size_t)firstRow * (n - 1);
+		for(u32 i = (u32)firstRow; i < std::min((u32)lastRow, m - 1); ++i)
 		{
-			meshData.Indices32[k]   = i * n + j;
-			meshData.Indices32[k + 1] = i * n + j + 1;
-			meshData.Indices32[k + 2] = (i + 1) * n + j;
-
-			meshData.Indices32[k + 3] = (i + 1) * n + j;
-			meshData.Indices32[k + 4] = i * n + j + 1;
-			meshData.Indices32[k + 5] = (i + 1) * n + j + 1;
-            
-			k += 6; // next quad
+			for(u32 j = 0; j < n-1; ++j)
+			{
+				indices[k]   = i * n + j;
+				indices[k + 1] = i * n + j + 1;
+				indices[k + 2] = (i + 1) * n + j;
+
+				indices[k + 3] = (i + 1) * n + j;
+				indices[k + 4] = i * n + j + 1;
+				indices[k + 5] = (i + 1) * n + j + 1;
+
+				k += 6; // next quad
+			}
 		}
-	}
-
-    return meshData;
+	};
+
+	// Grids that fit in one block are built on the calling thread, without
+	// the job system's allocations. The wrapper captures a single reference,
+	// which std::function stores in place.
+	i32 rowsPerBlock = (i32)std::max<u32>(1, GridBlockVertices / n);
+	if((i32)m <= rowsPerBlock)
+		buildRows(0, (i32)m);
+	else
+		JobSystem::Get().ParallelFor(0, (i32)m, rowsPerBlock,
+			[&buildRows](i32 firstRow, i32 lastRow) { buildRows(firstRow, lastRow); });
+
+    return size;
 }
 
-GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
+GeometryGenerator::MeshSize GeometryGenerator::CreateQuad(f32 x, f32 y, f32 w, f32 h, f32 depth,
+    Span<Vertex> vertices, Span<u32> indices)
 {
-    MeshData meshData;
-
-	meshData.Vertices.resize(4);
-	meshData.Indices32.resize(6);
+    MeshSize size = QuadSize();
+    assert(vertices.Size() >= size.VertexCount && indices.Size() >= size.IndexCount);
 
 	// Position coordinates specified in NDC space.
-	meshData.Vertices[0] = Vertex(
+	vertices[0] = Vertex(
         x, y - h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		0.0f, 1.0f);
 
-	meshData.Vertices[1] = Vertex(
+	vertices[1] = Vertex(
 		x, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		0.0f, 0.0f);
 
-	meshData.Vertices[2] = Vertex(
+	vertices[2] = Vertex(
 		x+w, y, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		1.0f, 0.0f);
 
-	meshData.Vertices[3] = Vertex(
+	vertices[3] = Vertex(
 		x+w, y-h, depth,
 		0.0f, 0.0f, -1.0f,
 		1.0f, 0.0f, 0.0f,
 		1.0f, 1.0f);
 
-	meshData.Indices32[0] = 0;
-	meshData.Indices32[1] = 1;
-	meshData.Indices32[2] = 2;
+	indices[0] = 0;
+	indices[1] = 1;
+	indices[2] = 2;
 
-	meshData.Indices32[3] = 0;
-	meshData.Indices32[4] = 2;
-	meshData.Indices32[5] = 3;
+	indices[3] = 0;
+	indices[4] = 2;
+	indices[5] = 3;
 
-    return meshData;
+    return size;
 }
@@ -14,12 +14,18 @@
 
 #pragma once
 
+#include <Common/PageAllocator.hpp>
+#include <Common/Span.hpp>
 #include <Common/defines.hpp>
 #include <DirectXMath.h>
+#include <functional>
 #include <vector>
 
 namespace DX = DirectX;
 
+// A generator holds no state but its page policy and the edge table the Span
+// overloads of CreateBox and CreateGeosphere reuse between calls: those two
+// must not be called on one generator from several threads at once.
 class GeometryGenerator
 {
 public:
@@ -46,8 +52,14 @@ public:
 
     struct MeshData
     {
-        std::vector<Vertex> Vertices;
-        std::vector<u32>    Indices32;
+        MeshData() = default;
+
+        // Vertices and indices allocated under policy (see PagePolicy).
+        explicit MeshData(PagePolicy policy)
+            : Vertices(PageAllocator<Vertex>(policy)), Indices32(PageAllocator<u32>(policy)) {}
+
+        PageVector<Vertex> Vertices;
+        PageVector<u32>    Indices32;
         std::vector<u16>& GetIndices16()
         {
             if (mIndices16.empty())
@@ -65,6 +77,32 @@ public:
         std::vector<u16>    mIndices16;
     };
 
+    // Exact vertex and index counts of a generated mesh.
+    struct MeshSize
+    {
+        size_t VertexCount = 0;
+        size_t IndexCount = 0;
+    };
+
+    // Batch height function for CreateGrid: given a block of flat grid
+    // vertices (Position.y == 0), sets each one's Position.y and Normal (and
+    // TangentU, if it matters) to the surface's at its x and z. Called once per
+    // block of rows, from several threads at once on large grids.
+    using HeightFn = std::function<void(Span<Vertex> vertices)>;
+
+    // Memory the vertex and index arrays of generated meshes come from; Heap
+    // by default. Huge pages pay off for meshes of millions of vertices.
+    void SetMeshPagePolicy(PagePolicy policy) { mPagePolicy = policy; }
+    PagePolicy MeshPagePolicy() const { return mPagePolicy; }
+
+    // Deepest subdivision level CreateBox and CreateGeosphere accept; one more
+    // and the vertices could no longer be addressed with 32-bit indices.
+    static constexpr u32 MaxSubdivisions = 14;
+
+    // Vertices per block of rows CreateGrid builds (and passes to its height
+    // function) at a time; about 180 KB, so a block stays in L2.
+    static constexpr u32 GridBlockVertices = 4096;
+
     // Creates a box centered at the origin with the given dimensions, where each 
     // face has m rows and n columns of vertices. 
     MeshData CreateBox(f32 width, f32 height, f32 depth, u32 numSubdivisions);
@@ -83,15 +121,73 @@ public:
     MeshData CreateCylinder(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount);
 
     // Creates an mxn grid in the xz-plane with rows and n columns, centered
-    // at the origin with the specified width and depth.
-    MeshData CreateGrid(f32 width, f32 depth, u32 m, u32 n);
+    // at the origin with the specified width and depth, and displaced by
+    // heightFn if given. Grids larger than GridBlockVertices are built in
+    // blocks of rows across the JobSystem.
+    MeshData CreateGrid(f32 width, f32 depth, u32 m, u32 n, const HeightFn& heightFn = nullptr);
 
     // Creates a quad aligned with the screen. This is useful for postprocessing and screen effects.
     MeshData CreateQuad(f32 x, f32 y, f32 w, f32 h, f32 depth);
 
+    // Sizes of the meshes the functions above create from the same arguments.
+    static MeshSize BoxSize(u32 numSubdivisions);
+    static MeshSize SphereSize(u32 sliceCount, u32 stackCount);
+    static MeshSize GeosphereSize(u32 numSubdivisions);
+    static MeshSize CylinderSize(u32 sliceCount, u32 stackCount);
+    static MeshSize GridSize(u32 m, u32 n);
+    static MeshSize QuadSize();
+
+    // The same meshes, written into caller-supplied buffers (e.g. carved from
+    // an arena) holding at least the matching XxxSize() counts. Nothing is
+    // allocated, except that subdivision grows the generator's edge table
+    // until it fits the largest mesh so far (see the class comment), and that
+    // a grid above GridBlockVertices goes through JobSystem::ParallelFor,
+    // which queues its blocks as jobs (allocating) once the pool has workers.
+    // Return the counts written.
+    MeshSize CreateBox(f32 width, f32 height, f32 depth, u32 numSubdivisions,
+                       Span<Vertex> vertices, Span<u32> indices);
+    MeshSize CreateSphere(f32 radius, u32 sliceCount, u32 stackCount,
+                          Span<Vertex> vertices, Span<u32> indices);
+    MeshSize CreateGeosphere(f32 radius, u32 numSubdivisions,
+                             Span<Vertex> vertices, Span<u32> indices);
+    MeshSize CreateCylinder(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount,
+                            Span<Vertex> vertices, Span<u32> indices);
+    MeshSize CreateGrid(f32 width, f32 depth, u32 m, u32 n,
+                        Span<Vertex> vertices, Span<u32> indices, const HeightFn& heightFn = nullptr);
+    MeshSize CreateQuad(f32 x, f32 y, f32 w, f32 h, f32 depth,
+                        Span<Vertex> vertices, Span<u32> indices);
+
 private:
-    void Subdivide(MeshData& meshData);
+    // Subdivide's edge table: endpoint-pair keys and midpoint indices.
+    struct EdgeTable
+    {
+        std::vector<u64> Keys;
+        std::vector<u32> MidPoints;
+    };
+
+    MeshData AllocateMesh(MeshSize size) const;
+
+    // The Span forms of CreateBox and CreateGeosphere, subdividing with edges.
+    MeshSize BuildBox(f32 width, f32 height, f32 depth, u32 numSubdivisions,
+                      Span<Vertex> vertices, Span<u32> indices, EdgeTable& edges);
+    MeshSize BuildGeosphere(f32 radius, u32 numSubdivisions,
+                            Span<Vertex> vertices, Span<u32> indices, EdgeTable& edges);
+
+    // Splits each of the indexCount / 3 triangles in four, in place: the
+    // buffers must have room for the new midpoint vertices and for four times
+    // the indices. Returns the new vertex count.
+    u32 Subdivide(Vertex* vertices, u32 vertexCount, u32* indices, size_t indexCount, EdgeTable& edges);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
-    void BuildCylinderTopCap(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount, MeshData& meshData);
-    void BuildCylinderBottomCap(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount, MeshData& meshData);
+
+    // Write a cap's sliceCount + 2 vertices and 3 * sliceCount indices; the
+    // cap's first vertex has index baseIndex in the whole mesh.
+    void BuildCylinderTopCap(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount,
+                             Span<Vertex> vertices, Span<u32> indices, u32 baseIndex);
+    void BuildCylinderBottomCap(f32 bottomRadius, f32 topRadius, f32 height, u32 sliceCount, u32 stackCount,
+                                Span<Vertex> vertices, Span<u32> indices, u32 baseIndex);
+
+    PagePolicy mPagePolicy = PagePolicy::Heap;
+
+    // Kept for the Span overloads, so repeated calls stop allocating.
+    EdgeTable mEdges;
 };
\ No newline at end of file
@@ -0,0 +1,202 @@
+#include <Common/JobSystem.hpp>
+#include <algorithm>
+
+namespace
+{
+    // Identifies the pool (and deque) the current thread works for. Threads that
+    // were not started by a JobSystem see nullptr and use the shared deque.
+    thread_local const JobSystem* tOwner = nullptr;
+    thread_local u32 tQueueIndex = 0;
+}
+
+JobSystem::JobSystem(u32 threadCount)
+{
+    if (threadCount == 0)
+    {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    mQueues.reserve(threadCount);
+    for (u32 i = 0; i < threadCount; ++i)
+    {
+        mQueues.push_back(std::make_unique<Queue>());
+    }
+
+    mWorkers.reserve(threadCount - 1);
+    for (u32 i = 1; i < threadCount; ++i)
+    {
+        mWorkers.emplace_back(&JobSystem::WorkerMain, this, i);
+    }
+}
+
+JobSystem::~JobSystem()
+{
+    {
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+        mQuit = true;
+    }
+    mWake.notify_all();
+
+    for (std::thread& worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+namespace
+{
+    std::unique_ptr<JobSystem>& GlobalPool()
+    {
+        static std::unique_ptr<JobSystem> pool = std::make_unique<JobSystem>();
+        return pool;
+    }
+}
+
+JobSystem& JobSystem::Get()
+{
+    return *GlobalPool();
+}
+
+void JobSystem::ResizeGlobal(u32 threadCount)
+{
+    GlobalPool() = std::make_unique<JobSystem>(threadCount);
+}
+
+void JobSystem::ParallelFor(i32 begin, i32 end, i32 grain, const RangeFn& fn)
+{
+    if (end <= begin)
+    {
+        return;
+    }
+
+    grain = std::max(grain, 1);
+    i32 chunkCount = (end - begin + grain - 1) / grain;
+    if (chunkCount == 1 || mWorkers.empty())
+    {
+        // Keep the chunk boundaries even when running inline; callers may rely
+        // on never seeing a range longer than grain.
+        for (i32 first = begin; first < end; first += grain)
+        {
+            fn(first, std::min(first + grain, end));
+        }
+        return;
+    }
+
+    Batch batch;
+    batch.Remaining.store(chunkCount, std::memory_order_relaxed);
+
+    // Deal the chunks out round-robin, starting with our own deque, so every
+    // worker has local work immediately and stealing only evens out the tail.
+    // The counter is raised first so it never under-reports queued work.
+    u32 self = CurrentQueueIndex();
+    u32 queueCount = (u32)mQueues.size();
+    mQueuedJobs.fetch_add(chunkCount, std::memory_order_release);
+    for (i32 c = 0; c < chunkCount; ++c)
+    {
+        Job job;
+        job.Fn = &fn;
+        job.Owner = &batch;
+        job.First = begin + c * grain;
+        job.Last = std::min(job.First + grain, end);
+
+        Queue& queue = *mQueues[(self + (u32)c) % queueCount];
+        std::lock_guard<std::mutex> lock(queue.Mutex);
+        queue.Jobs.push_back(job);
+    }
+
+    {
+        // Taking the lock orders the notify after any worker's predicate check.
+        std::lock_guard<std::mutex> lock(mWakeMutex);
+    }
+    mWake.notify_all();
+
+    // Help out until the batch drains. The jobs we pick up may belong to other
+    // batches; that is fine since every job is independent and finite.
+    while (batch.Remaining.load(std::memory_order_acquire) > 0)
+    {
+        Job job;
+        if (PopOrSteal(self, job))
+        {
+            Run(job);
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::WorkerMain(u32 queueIndex)
+{
+    tOwner = this;
+    tQueueIndex = queueIndex;
+
+    for (;;)
+    {
+        Job job;
+        if (PopOrSteal(queueIndex, job))
+        {
+            Run(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(mWakeMutex);
+        mWake.wait(lock, [this]() {
+            return mQuit.load() || mQueuedJobs.load(std::memory_order_acquire) > 0;
+        });
+
+        if (mQuit.load())
+        {
+            return;
+        }
+    }
+}
+
+u32 JobSystem::CurrentQueueIndex() const
+{
+    return tOwner == this ? tQueueIndex : 0u;
+}
+
+bool JobSystem::PopOrSteal(u32 queueIndex, Job& job)
+{
+    if (mQueuedJobs.load(std::memory_order_acquire) <= 0)
+    {
+        return false;
+    }
+
+    // Newest local job first; it is the most likely to still be in cache.
+    {
+        Queue& own = *mQueues[queueIndex];
+        std::lock_guard<std::mutex> lock(own.Mutex);
+        if (!own.Jobs.empty())
+        {
+            job = own.Jobs.back();
+            own.Jobs.pop_back();
+            mQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    // Otherwise steal the oldest job from the next non-empty deque.
+    u32 queueCount = (u32)mQueues.size();
+    for (u32 k = 1; k < queueCount; ++k)
+    {
+        Queue& victim = *mQueues[(queueIndex + k) % queueCount];
+        std::lock_guard<std::mutex> lock(victim.Mutex);
+        if (!victim.Jobs.empty())
+        {
+            job = victim.Jobs.front();
+            victim.Jobs.pop_front();
+            mQueuedJobs.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void JobSystem::Run(const Job& job)
+{
+    (*job.Fn)(job.First, job.Last);
+    job.Owner->Remaining.fetch_sub(1, std::memory_order_release);
+}
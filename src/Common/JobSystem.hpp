@@ -0,0 +1,79 @@
+#pragma once
+
+#include <Common/defines.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads with one job deque per thread. A thread pushes
+// and pops work at the back of its own deque and, when that runs dry, steals
+// from the front of the others, so large batches spread out without a central
+// queue. Threads that are not pool workers (e.g. the main thread) share an
+// extra deque and help execute jobs while they wait on a batch.
+class JobSystem
+{
+public:
+    using RangeFn = std::function<void(i32 first, i32 last)>;
+
+    // threadCount is the total number of threads executing jobs, including the
+    // thread that calls ParallelFor. 0 uses std::thread::hardware_concurrency().
+    explicit JobSystem(u32 threadCount = 0);
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    ~JobSystem();
+
+    // Process-wide pool sized to the hardware.
+    static JobSystem& Get();
+
+    // Replaces the process-wide pool with one of threadCount threads (0: the
+    // hardware). Only call while no jobs are running, e.g. between benchmark
+    // runs; earlier references returned by Get() become invalid.
+    static void ResizeGlobal(u32 threadCount);
+
+    u32 ThreadCount() const { return (u32)mWorkers.size() + 1; }
+
+    // Splits [begin, end) into chunks of at most grain elements and calls
+    // fn(first, last) for each of them across the pool. Returns once every chunk
+    // has run; the calling thread executes jobs in the meantime. Safe to call
+    // from inside a job.
+    void ParallelFor(i32 begin, i32 end, i32 grain, const RangeFn& fn);
+
+private:
+    struct Batch
+    {
+        std::atomic<i32> Remaining{ 0 };
+    };
+
+    struct Job
+    {
+        const RangeFn* Fn = nullptr;
+        Batch* Owner = nullptr;
+        i32 First = 0;
+        i32 Last = 0;
+    };
+
+    struct Queue
+    {
+        std::mutex Mutex;
+        std::deque<Job> Jobs;
+    };
+
+    void WorkerMain(u32 queueIndex);
+    u32  CurrentQueueIndex() const;
+    bool PopOrSteal(u32 queueIndex, Job& job);
+    void Run(const Job& job);
+
+    // mQueues[0] is shared by external threads; worker i owns mQueues[i + 1].
+    std::vector<std::unique_ptr<Queue>> mQueues;
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mWakeMutex;
+    std::condition_variable mWake;
+    std::atomic<i32> mQueuedJobs{ 0 };
+    std::atomic<bool> mQuit{ false };
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <Common/defines.hpp>
+
+enum class MappedFileAccess
+{
+    ReadOnly,
+    // Readable and writable, but writes go to private copies of the touched
+    // pages and never reach the file.
+    CopyOnWrite
+};
+
+// A whole file mapped into the address space. Nothing is read up front: pages
+// are loaded by the OS on first touch, so opening is cheap regardless of the
+// file size. The mapping starts on a page boundary.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    // Maps path, replacing any previous mapping. Returns false (and leaves the
+    // object closed) if the file cannot be opened or is empty.
+    bool Open(const char* path, MappedFileAccess access);
+    void Close();
+
+    bool IsOpen() const { return mData != nullptr; }
+    u8* Data() { return mData; }
+    const u8* Data() const { return mData; }
+    u64 Size() const { return mSize; }
+
+private:
+    u8* mData = nullptr;
+    u64 mSize = 0;
+
+#if defined(_WIN32)
+    void* mFile = nullptr;
+    void* mMapping = nullptr;
+#endif
+};
@@ -0,0 +1,799 @@
+#include <Common/MeshOptimizer.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    // Forsyth's scoring constants, tuned by him for a 32-entry LRU cache.
+    constexpr u32 MaxCacheSize = 32;
+    constexpr f32 CacheDecayPower = 1.5f;
+    constexpr f32 LastTriangleScore = 0.75f;
+    constexpr f32 ValenceBoostScale = 2.0f;
+    constexpr f32 ValenceBoostPower = 0.5f;
+
+    // Triangles of a cache vertex considered for the next emission. Around a
+    // vertex of high valence (the center of a fan) only the first few of its
+    // remaining triangles are looked at, which keeps each step constant-time.
+    constexpr u32 MaxCandidates = 32;
+
+    // Vertex scores by cache position and by remaining triangle count, the
+    // latter tabulated up to a valence past which pow() is called instead.
+    constexpr u32 ValenceTableSize = 64;
+
+    struct ScoreTables
+    {
+        f32 Cache[MaxCacheSize];
+        f32 Valence[ValenceTableSize];
+
+        ScoreTables()
+        {
+            for (u32 i = 0; i < MaxCacheSize; ++i)
+            {
+                // The three vertices of the triangle just emitted score the same,
+                // so the next triangle is not biased towards one of its edges.
+                if (i < 3)
+                {
+                    Cache[i] = LastTriangleScore;
+                }
+                else
+                {
+                    f32 scale = 1.0f - (f32)(i - 3) / (f32)(MaxCacheSize - 3);
+                    Cache[i] = powf(scale, CacheDecayPower);
+                }
+            }
+            for (u32 i = 0; i < ValenceTableSize; ++i)
+            {
+                Valence[i] = i == 0 ? 0.0f : ValenceBoostScale * powf((f32)i, -ValenceBoostPower);
+            }
+        }
+    };
+
+    const ScoreTables gScores;
+
+    // cachePosition < 0 for vertices outside the cache. Vertices without
+    // triangles left score -1 so they never attract anything.
+    f32 VertexScore(i32 cachePosition, u32 valence)
+    {
+        if (valence == 0)
+        {
+            return -1.0f;
+        }
+
+        f32 score = cachePosition >= 0 ? gScores.Cache[cachePosition] : 0.0f;
+        score += valence < ValenceTableSize ? gScores.Valence[valence]
+                                            : ValenceBoostScale * powf((f32)valence, -ValenceBoostPower);
+        return score;
+    }
+
+    template <typename Index>
+    MeshOptimizer::CacheStats AnalyzeVertexCacheT(Span<const Index> indices, u32 vertexCount, u32 cacheSize)
+    {
+        MeshOptimizer::CacheStats stats;
+        stats.TriangleCount = (u32)(indices.Size() / 3);
+
+        // A vertex is in the FIFO if it was inserted within the last cacheSize
+        // insertions; time starts past cacheSize so that stamp 0 always misses.
+        std::vector<u32> stamps(vertexCount, 0);
+        u32 time = cacheSize + 1;
+        for (size_t i = 0; i < 3 * (size_t)stats.TriangleCount; ++i)
+        {
+            Index v = indices[i];
+            assert(v < vertexCount);
+            if (stamps[v] == 0)
+            {
+                ++stats.VertexCount;
+            }
+            if (time - stamps[v] > cacheSize)
+            {
+                stamps[v] = time++;
+                ++stats.Transforms;
+            }
+        }
+
+        stats.Acmr = stats.TriangleCount ? (f64)stats.Transforms / stats.TriangleCount : 0.0;
+        stats.Atvr = stats.VertexCount ? (f64)stats.Transforms / stats.VertexCount : 0.0;
+        return stats;
+    }
+
+    template <typename Index>
+    void OptimizeVertexCacheT(Span<Index> indices, u32 vertexCount)
+    {
+        const size_t triangleCount = indices.Size() / 3;
+        const size_t indexCount = triangleCount * 3;
+        if (triangleCount == 0)
+        {
+            return;
+        }
+
+        // Triangles around each vertex, as ranges of one array. The first
+        // valence[v] entries of v's range are the triangles not yet emitted.
+        std::vector<u32> valence(vertexCount, 0);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            assert(indices[i] < vertexCount);
+            ++valence[indices[i]];
+        }
+
+        std::vector<u32> firstTriangle(vertexCount + 1, 0);
+        for (u32 v = 0; v < vertexCount; ++v)
+        {
+            firstTriangle[v + 1] = firstTriangle[v] + valence[v];
+        }
+
+        // slot[i] is where corner i (of triangle i / 3) sits in its vertex's
+        // range, so that emitting a triangle unlinks it in constant time.
+        std::vector<u32> triangles(indexCount);
+        std::vector<u32> slot(indexCount);
+        {
+            std::vector<u32> cursor(firstTriangle.begin(), firstTriangle.end() - 1);
+            for (size_t i = 0; i < indexCount; ++i)
+            {
+                slot[i] = cursor[indices[i]]++;
+                triangles[slot[i]] = (u32)(i / 3);
+            }
+        }
+
+        std::vector<i32> cachePosition(vertexCount, -1);
+        std::vector<f32> vertexScore(vertexCount);
+        for (u32 v = 0; v < vertexCount; ++v)
+        {
+            vertexScore[v] = VertexScore(-1, valence[v]);
+        }
+
+        // Triangle scores change with the scores of their vertices, but only
+        // the candidates around each vertex (see MaxCandidates) are kept up to
+        // date; the others are refreshed when they move up to become one.
+        auto triangleScore = [&](size_t t)
+        {
+            const Index* tri = &indices[3 * t];
+            return vertexScore[tri[0]] + vertexScore[tri[1]] + vertexScore[tri[2]];
+        };
+
+        // Start from the best triangle overall, which lies where valences are
+        // lowest, e.g. on a boundary.
+        std::vector<f32> score(triangleCount);
+        std::vector<u8> emitted(triangleCount, 0);
+        size_t best = 0;
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            score[t] = triangleScore(t);
+            if (score[t] > score[best])
+            {
+                best = t;
+            }
+        }
+
+        // The simulated LRU cache, most recent first.
+        u32 cache[MaxCacheSize];
+        u32 cacheCount = 0;
+
+        std::vector<Index> output(indexCount);
+        size_t nextUnemitted = 0;
+        for (size_t out = 0; out < triangleCount; ++out)
+        {
+            // Nothing in the cache has triangles left: continue with the first
+            // triangle not yet emitted, in input order.
+            if (best == triangleCount)
+            {
+                while (emitted[nextUnemitted])
+                {
+                    ++nextUnemitted;
+                }
+                best = nextUnemitted;
+            }
+
+            Index tri[3] = { indices[3 * best], indices[3 * best + 1], indices[3 * best + 2] };
+            output[3 * out] = tri[0];
+            output[3 * out + 1] = tri[1];
+            output[3 * out + 2] = tri[2];
+            emitted[best] = 1;
+
+            // Take the triangle off its vertices' lists of remaining triangles:
+            // the last entry of each list moves into its slot, and becomes a
+            // candidate if it was not one already.
+            for (u32 c = 0; c < 3; ++c)
+            {
+                u32 v = tri[c];
+                u32 hole = slot[3 * best + c];
+                u32 last = firstTriangle[v] + --valence[v];
+                u32 moved = triangles[last];
+                triangles[hole] = moved;
+                if (last - firstTriangle[v] >= MaxCandidates && hole - firstTriangle[v] < MaxCandidates)
+                {
+                    score[moved] = triangleScore(moved);
+                }
+                for (u32 k = 3 * moved; k < 3 * moved + 3; ++k)
+                {
+                    if (slot[k] == last)
+                    {
+                        slot[k] = hole;
+                        break;
+                    }
+                }
+            }
+
+            // Move the triangle's vertices to the front of the cache; up to three
+            // of the oldest entries are pushed past its end and drop out below.
+            u32 newCache[MaxCacheSize + 3];
+            u32 newCount = 0;
+            for (Index v : tri)
+            {
+                if (newCount == 0 || (newCache[0] != v && (newCount == 1 || newCache[1] != v)))
+                {
+                    newCache[newCount++] = v;
+                }
+            }
+            for (u32 k = 0; k < cacheCount; ++k)
+            {
+                u32 v = cache[k];
+                if (v != tri[0] && v != tri[1] && v != tri[2])
+                {
+                    newCache[newCount++] = v;
+                }
+            }
+
+            // Rescore every vertex that is or was just in the cache, and pass
+            // the change on to its candidate triangles.
+            for (u32 k = 0; k < newCount; ++k)
+            {
+                u32 v = newCache[k];
+                cachePosition[v] = k < MaxCacheSize ? (i32)k : -1;
+                f32 delta = VertexScore(cachePosition[v], valence[v]) - vertexScore[v];
+                if (delta != 0.0f)
+                {
+                    vertexScore[v] += delta;
+                    const u32* list = &triangles[firstTriangle[v]];
+                    for (u32 j = 0, end = std::min(valence[v], MaxCandidates); j < end; ++j)
+                    {
+                        score[list[j]] += delta;
+                    }
+                }
+            }
+
+            // The next triangle is the best candidate around the cache.
+            best = triangleCount;
+            f32 bestScore = -1.0f;
+            for (u32 k = 0; k < newCount && k < MaxCacheSize; ++k)
+            {
+                u32 v = newCache[k];
+                const u32* list = &triangles[firstTriangle[v]];
+                for (u32 j = 0, end = std::min(valence[v], MaxCandidates); j < end; ++j)
+                {
+                    if (score[list[j]] > bestScore)
+                    {
+                        bestScore = score[list[j]];
+                        best = list[j];
+                    }
+                }
+            }
+
+            cacheCount = newCount < MaxCacheSize ? newCount : MaxCacheSize;
+            memcpy(cache, newCache, cacheCount * sizeof(u32));
+        }
+
+        memcpy(indices.Data(), output.data(), indexCount * sizeof(Index));
+    }
+
+    template <typename Index>
+    void OptimizeVertexFetchT(void* vertices, u32 vertexCount, u32 vertexStride, Span<Index> indices)
+    {
+        const u32 Unassigned = ~0u;
+        std::vector<u32> remap(vertexCount, Unassigned);
+        u32 next = 0;
+        for (Index& index : indices)
+        {
+            assert(index < vertexCount);
+            if (remap[index] == Unassigned)
+            {
+                remap[index] = next++;
+            }
+            index = (Index)remap[index];
+        }
+        for (u32 v = 0; v < vertexCount; ++v)
+        {
+            if (remap[v] == Unassigned)
+            {
+                remap[v] = next++;
+            }
+        }
+
+        u8* data = static_cast<u8*>(vertices);
+        std::vector<u8> original(data, data + (size_t)vertexCount * vertexStride);
+        for (u32 v = 0; v < vertexCount; ++v)
+        {
+            memcpy(data + (size_t)remap[v] * vertexStride, original.data() + (size_t)v * vertexStride, vertexStride);
+        }
+    }
+
+    template <typename Index>
+    MeshOptimizer::CacheReport OptimizeMeshT(void* vertices, u32 vertexCount, u32 vertexStride, Span<Index> indices,
+                                             u32 cacheSize)
+    {
+        MeshOptimizer::CacheReport report;
+        report.Before = AnalyzeVertexCacheT(Span<const Index>(indices), vertexCount, cacheSize);
+        OptimizeVertexCacheT(indices, vertexCount);
+        OptimizeVertexFetchT(vertices, vertexCount, vertexStride, indices);
+        report.After = AnalyzeVertexCacheT(Span<const Index>(indices), vertexCount, cacheSize);
+        return report;
+    }
+
+    struct Float3
+    {
+        f32 X, Y, Z;
+    };
+
+    Float3 Add(Float3 a, Float3 b) { return { a.X + b.X, a.Y + b.Y, a.Z + b.Z }; }
+    Float3 Subtract(Float3 a, Float3 b) { return { a.X - b.X, a.Y - b.Y, a.Z - b.Z }; }
+    Float3 Scale(Float3 a, f32 s) { return { a.X * s, a.Y * s, a.Z * s }; }
+    f32 Dot(Float3 a, Float3 b) { return a.X * b.X + a.Y * b.Y + a.Z * b.Z; }
+
+    Float3 Cross(Float3 a, Float3 b)
+    {
+        return { a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X };
+    }
+
+    Float3 Normalize(Float3 a)
+    {
+        f32 length = sqrtf(Dot(a, a));
+        return length > 0.0f ? Scale(a, 1.0f / length) : Float3{ 0.0f, 0.0f, 0.0f };
+    }
+
+    // Vertex positions are the first three floats of each vertex, which need
+    // not be aligned for floats.
+    std::vector<Float3> LoadPositions(const void* vertices, u32 vertexCount, u32 vertexStride)
+    {
+        assert(vertexStride >= sizeof(Float3));
+        std::vector<Float3> positions(vertexCount);
+        const u8* data = static_cast<const u8*>(vertices);
+        for (u32 v = 0; v < vertexCount; ++v)
+        {
+            memcpy(&positions[v], data + (size_t)v * vertexStride, sizeof(Float3));
+        }
+        return positions;
+    }
+
+    // The FIFO cache of AnalyzeVertexCacheT, driven one triangle at a time.
+    class FifoCache
+    {
+    public:
+        FifoCache(u32 vertexCount, u32 cacheSize) : mStamps(vertexCount, 0), mCacheSize(cacheSize), mTime(cacheSize + 1) {}
+
+        // Returns how many of the triangle's vertices missed.
+        template <typename Index>
+        u32 Insert(const Index* triangle)
+        {
+            u32 misses = 0;
+            for (u32 k = 0; k < 3; ++k)
+            {
+                u32& stamp = mStamps[triangle[k]];
+                if (mTime - stamp > mCacheSize)
+                {
+                    stamp = mTime++;
+                    ++misses;
+                }
+            }
+            return misses;
+        }
+
+        // Empties the cache by moving time past every stamp in it.
+        void Flush() { mTime += mCacheSize + 1; }
+
+    private:
+        std::vector<u32> mStamps;
+        u32 mCacheSize;
+        u32 mTime;
+    };
+
+    template <typename Index>
+    MeshOptimizer::CacheReport OptimizeOverdrawT(const void* vertices, u32 vertexCount, u32 vertexStride,
+                                                 Span<Index> indices, f32 threshold, u32 cacheSize)
+    {
+        MeshOptimizer::CacheReport report;
+        report.Before = AnalyzeVertexCacheT(Span<const Index>(indices), vertexCount, cacheSize);
+        report.After = report.Before;
+
+        const size_t triangleCount = indices.Size() / 3;
+        if (triangleCount < 2)
+        {
+            return report;
+        }
+
+        // Hard boundaries: triangles that miss on all three vertices, where
+        // the cache contributes nothing and the order can be cut for free.
+        std::vector<u32> hardClusters;
+        std::vector<u32> hardMisses;
+        {
+            FifoCache cache(vertexCount, cacheSize);
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                u32 misses = cache.Insert(&indices[3 * t]);
+                if (t == 0 || misses == 3)
+                {
+                    hardClusters.push_back((u32)t);
+                    hardMisses.push_back(0);
+                }
+                hardMisses.back() += misses;
+            }
+            hardClusters.push_back((u32)triangleCount);
+        }
+
+        // Soft boundaries: within each hard cluster, cut as soon as the
+        // triangles since the last cut, simulated from an empty cache, have an
+        // ACMR within threshold of the whole hard cluster's. Each piece then
+        // costs no more than that wherever it lands, except that the last one
+        // in a hard cluster is whatever remains.
+        std::vector<u32> clusters;
+        {
+            FifoCache cache(vertexCount, cacheSize);
+            for (size_t h = 0; h + 1 < hardClusters.size(); ++h)
+            {
+                const u32 first = hardClusters[h];
+                const u32 last = hardClusters[h + 1];
+                const f32 targetAcmr = threshold * (f32)hardMisses[h] / (f32)(last - first);
+
+                u32 start = first;
+                u32 misses = 0;
+                cache.Flush();
+                clusters.push_back(start);
+                for (u32 t = first; t + 1 < last; ++t)
+                {
+                    misses += cache.Insert(&indices[3 * (size_t)t]);
+                    if ((f32)misses <= targetAcmr * (f32)(t + 1 - start))
+                    {
+                        start = t + 1;
+                        misses = 0;
+                        cache.Flush();
+                        clusters.push_back(start);
+                    }
+                }
+            }
+            clusters.push_back((u32)triangleCount);
+        }
+
+        const size_t clusterCount = clusters.size() - 1;
+        if (clusterCount < 2)
+        {
+            return report;
+        }
+
+        // Area-weighted centroids and normals, per cluster and for the mesh.
+        // Normals follow the clockwise winding of front faces in a left-handed
+        // space, so they point out of the mesh.
+        const std::vector<Float3> positions = LoadPositions(vertices, vertexCount, vertexStride);
+        std::vector<Float3> clusterCentroids(clusterCount);
+        std::vector<Float3> clusterNormals(clusterCount);
+        Float3 meshCentroid = { 0.0f, 0.0f, 0.0f };
+        Float3 vertexSum = { 0.0f, 0.0f, 0.0f };
+        f32 meshArea = 0.0f;
+        for (size_t c = 0; c < clusterCount; ++c)
+        {
+            Float3 centroid = { 0.0f, 0.0f, 0.0f };
+            Float3 normal = { 0.0f, 0.0f, 0.0f };
+            f32 area = 0.0f;
+            for (u32 t = clusters[c]; t < clusters[c + 1]; ++t)
+            {
+                const Index* tri = &indices[3 * (size_t)t];
+                Float3 p0 = positions[tri[0]];
+                Float3 p1 = positions[tri[1]];
+                Float3 p2 = positions[tri[2]];
+                Float3 triangleNormal = Cross(Subtract(p1, p0), Subtract(p2, p0));
+                f32 triangleArea = sqrtf(Dot(triangleNormal, triangleNormal));
+                Float3 triangleCentroid = Scale(Add(Add(p0, p1), p2), 1.0f / 3.0f);
+
+                centroid = Add(centroid, Scale(triangleCentroid, triangleArea));
+                normal = Add(normal, triangleNormal);
+                area += triangleArea;
+                vertexSum = Add(vertexSum, triangleCentroid);
+            }
+
+            meshCentroid = Add(meshCentroid, centroid);
+            meshArea += area;
+            clusterCentroids[c] = area > 0.0f ? Scale(centroid, 1.0f / area) : centroid;
+            clusterNormals[c] = Normalize(normal);
+        }
+        meshCentroid = meshArea > 0.0f ? Scale(meshCentroid, 1.0f / meshArea)
+                                       : Scale(vertexSum, 1.0f / (f32)triangleCount);
+
+        // Clusters far out along their own normal occlude the rest of the mesh
+        // from most directions they can be seen from, so they go first. The
+        // stable sort keeps equal keys in cache order.
+        std::vector<f32> keys(clusterCount);
+        std::vector<u32> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; ++c)
+        {
+            keys[c] = Dot(Subtract(clusterCentroids[c], meshCentroid), clusterNormals[c]);
+            order[c] = (u32)c;
+        }
+        std::stable_sort(order.begin(), order.end(), [&keys](u32 a, u32 b) { return keys[a] > keys[b]; });
+
+        std::vector<Index> output(3 * triangleCount);
+        size_t out = 0;
+        for (u32 c : order)
+        {
+            size_t first = 3 * (size_t)clusters[c];
+            size_t count = 3 * (size_t)(clusters[c + 1] - clusters[c]);
+            memcpy(&output[out], &indices[first], count * sizeof(Index));
+            out += count;
+        }
+
+        // Cluster boundaries only estimate the cost of reordering; keep the
+        // input if the result gave up more than the threshold allows.
+        MeshOptimizer::CacheStats after = AnalyzeVertexCacheT(Span<const Index>(output), vertexCount, cacheSize);
+        if (after.Acmr > threshold * report.Before.Acmr)
+        {
+            return report;
+        }
+
+        memcpy(indices.Data(), output.data(), output.size() * sizeof(Index));
+        report.After = after;
+        return report;
+    }
+
+    // Rasterizer coordinates are fixed point with this many steps per pixel,
+    // so that the edge functions are exact and shared edges are never
+    // rasterized twice or not at all.
+    constexpr i64 SubpixelSteps = 256;
+
+    struct ScreenVertex
+    {
+        i64 X, Y;
+        f32 Depth;
+    };
+
+    // Twice the signed area of (a, b, p). Positive when p lies to the right
+    // of a -> b on screen (y down), i.e. inside a clockwise triangle.
+    i64 EdgeFunction(const ScreenVertex& a, const ScreenVertex& b, i64 px, i64 py)
+    {
+        return (b.X - a.X) * (py - a.Y) - (b.Y - a.Y) * (px - a.X);
+    }
+
+    // Top-left fill rule: a pixel center exactly on an edge belongs to the
+    // triangle only if the edge is a top edge (horizontal, and clockwise
+    // traversal runs right along it) or a left edge (running up).
+    bool IsTopLeft(const ScreenVertex& a, const ScreenVertex& b)
+    {
+        return (a.Y == b.Y && b.X > a.X) || b.Y < a.Y;
+    }
+
+    // Draws one triangle into depth, returning the pixels that passed the
+    // depth test. Back faces and degenerate triangles draw nothing.
+    u64 RasterizeTriangle(const ScreenVertex& a, const ScreenVertex& b, const ScreenVertex& c, f32* depth,
+                          u32 resolution)
+    {
+        const i64 area = EdgeFunction(a, b, c.X, c.Y);
+        if (area <= 0)
+        {
+            return 0;
+        }
+
+        // Pixel centers are at half-pixel offsets.
+        const i64 half = SubpixelSteps / 2;
+        const i64 maxPixel = (i64)resolution - 1;
+        i64 minX = (std::min({ a.X, b.X, c.X }) - half + SubpixelSteps - 1) / SubpixelSteps;
+        i64 minY = (std::min({ a.Y, b.Y, c.Y }) - half + SubpixelSteps - 1) / SubpixelSteps;
+        i64 maxX = (std::max({ a.X, b.X, c.X }) - half) / SubpixelSteps;
+        i64 maxY = (std::max({ a.Y, b.Y, c.Y }) - half) / SubpixelSteps;
+        minX = std::max<i64>(minX, 0);
+        minY = std::max<i64>(minY, 0);
+        maxX = std::min(maxX, maxPixel);
+        maxY = std::min(maxY, maxPixel);
+        if (minX > maxX || minY > maxY)
+        {
+            return 0;
+        }
+
+        // Edge functions opposite each vertex, biased so that >= 0 applies the
+        // fill rule, and stepped incrementally across the bounding box.
+        const i64 bias0 = IsTopLeft(b, c) ? 0 : -1;
+        const i64 bias1 = IsTopLeft(c, a) ? 0 : -1;
+        const i64 bias2 = IsTopLeft(a, b) ? 0 : -1;
+        const i64 stepX0 = -(c.Y - b.Y) * SubpixelSteps;
+        const i64 stepX1 = -(a.Y - c.Y) * SubpixelSteps;
+        const i64 stepX2 = -(b.Y - a.Y) * SubpixelSteps;
+        const i64 stepY0 = (c.X - b.X) * SubpixelSteps;
+        const i64 stepY1 = (a.X - c.X) * SubpixelSteps;
+        const i64 stepY2 = (b.X - a.X) * SubpixelSteps;
+
+        const i64 startX = minX * SubpixelSteps + half;
+        const i64 startY = minY * SubpixelSteps + half;
+        i64 row0 = EdgeFunction(b, c, startX, startY);
+        i64 row1 = EdgeFunction(c, a, startX, startY);
+        i64 row2 = EdgeFunction(a, b, startX, startY);
+
+        const f32 invArea = 1.0f / (f32)area;
+        u64 shaded = 0;
+        for (i64 y = minY; y <= maxY; ++y)
+        {
+            i64 w0 = row0;
+            i64 w1 = row1;
+            i64 w2 = row2;
+            f32* depthRow = depth + (size_t)y * resolution;
+            for (i64 x = minX; x <= maxX; ++x)
+            {
+                if (w0 + bias0 >= 0 && w1 + bias1 >= 0 && w2 + bias2 >= 0)
+                {
+                    f32 z = ((f32)w0 * a.Depth + (f32)w1 * b.Depth + (f32)w2 * c.Depth) * invArea;
+                    if (z < depthRow[x])
+                    {
+                        depthRow[x] = z;
+                        ++shaded;
+                    }
+                }
+                w0 += stepX0;
+                w1 += stepX1;
+                w2 += stepX2;
+            }
+            row0 += stepY0;
+            row1 += stepY1;
+            row2 += stepY2;
+        }
+        return shaded;
+    }
+
+    template <typename Index>
+    MeshOptimizer::OverdrawStats EstimateOverdrawT(const void* vertices, u32 vertexCount, u32 vertexStride,
+                                                   Span<const Index> indices, u32 viewCount, u32 resolution)
+    {
+        MeshOptimizer::OverdrawStats stats;
+        const size_t triangleCount = indices.Size() / 3;
+        if (triangleCount == 0 || vertexCount == 0 || viewCount == 0 || resolution == 0)
+        {
+            return stats;
+        }
+
+        // Every view frames the bounding sphere around the box center.
+        const std::vector<Float3> positions = LoadPositions(vertices, vertexCount, vertexStride);
+        Float3 lower = positions[0];
+        Float3 upper = positions[0];
+        for (const Float3& p : positions)
+        {
+            lower = { std::min(lower.X, p.X), std::min(lower.Y, p.Y), std::min(lower.Z, p.Z) };
+            upper = { std::max(upper.X, p.X), std::max(upper.Y, p.Y), std::max(upper.Z, p.Z) };
+        }
+        const Float3 center = Scale(Add(lower, upper), 0.5f);
+        f32 radius = 0.0f;
+        for (const Float3& p : positions)
+        {
+            Float3 offset = Subtract(p, center);
+            radius = std::max(radius, Dot(offset, offset));
+        }
+        radius = sqrtf(radius);
+        if (radius == 0.0f)
+        {
+            return stats;
+        }
+
+        const f32 pixelsPerUnit = (f32)resolution / (2.0f * radius);
+        const f32 screenCenter = 0.5f * (f32)resolution;
+        const f32 NoDepth = INFINITY;
+        std::vector<f32> depth((size_t)resolution * resolution);
+        std::vector<ScreenVertex> screen(vertexCount);
+
+        for (u32 view = 0; view < viewCount; ++view)
+        {
+            // Directions on a Fibonacci spiral, evenly spread over the sphere.
+            const f32 goldenAngle = 3.14159265f * (3.0f - sqrtf(5.0f));
+            f32 y = 1.0f - (2.0f * view + 1.0f) / (f32)viewCount;
+            f32 ring = sqrtf(std::max(0.0f, 1.0f - y * y));
+            f32 angle = goldenAngle * (f32)view;
+            Float3 forward = { ring * cosf(angle), y, ring * sinf(angle) };
+
+            // Left-handed camera basis, as XMMatrixLookToLH builds it.
+            Float3 worldUp = fabsf(forward.Y) > 0.99f ? Float3{ 1.0f, 0.0f, 0.0f } : Float3{ 0.0f, 1.0f, 0.0f };
+            Float3 right = Normalize(Cross(worldUp, forward));
+            Float3 up = Cross(forward, right);
+
+            for (u32 v = 0; v < vertexCount; ++v)
+            {
+                Float3 offset = Subtract(positions[v], center);
+                f32 sx = screenCenter + Dot(offset, right) * pixelsPerUnit;
+                f32 sy = screenCenter - Dot(offset, up) * pixelsPerUnit;
+                screen[v] = { (i64)lrintf(sx * SubpixelSteps), (i64)lrintf(sy * SubpixelSteps), Dot(offset, forward) };
+            }
+
+            std::fill(depth.begin(), depth.end(), NoDepth);
+            for (size_t t = 0; t < triangleCount; ++t)
+            {
+                const Index* tri = &indices[3 * t];
+                assert(tri[0] < vertexCount && tri[1] < vertexCount && tri[2] < vertexCount);
+                stats.PixelsShaded += RasterizeTriangle(screen[tri[0]], screen[tri[1]], screen[tri[2]], depth.data(),
+                                                        resolution);
+            }
+            for (f32 z : depth)
+            {
+                stats.PixelsCovered += z != NoDepth;
+            }
+        }
+
+        stats.Overdraw = stats.PixelsCovered ? (f64)stats.PixelsShaded / stats.PixelsCovered : 0.0;
+        return stats;
+    }
+}
+
+namespace MeshOptimizer
+{
+    CacheStats AnalyzeVertexCache(Span<const u32> indices, u32 vertexCount, u32 cacheSize)
+    {
+        return AnalyzeVertexCacheT(indices, vertexCount, cacheSize);
+    }
+
+    CacheStats AnalyzeVertexCache(Span<const u16> indices, u32 vertexCount, u32 cacheSize)
+    {
+        return AnalyzeVertexCacheT(indices, vertexCount, cacheSize);
+    }
+
+    void OptimizeVertexCache(Span<u32> indices, u32 vertexCount)
+    {
+        OptimizeVertexCacheT(indices, vertexCount);
+    }
+
+    void OptimizeVertexCache(Span<u16> indices, u32 vertexCount)
+    {
+        OptimizeVertexCacheT(indices, vertexCount);
+    }
+
+    void OptimizeVertexFetch(void* vertices, u32 vertexCount, u32 vertexStride, Span<u32> indices)
+    {
+        OptimizeVertexFetchT(vertices, vertexCount, vertexStride, indices);
+    }
+
+    void OptimizeVertexFetch(void* vertices, u32 vertexCount, u32 vertexStride, Span<u16> indices)
+    {
+        OptimizeVertexFetchT(vertices, vertexCount, vertexStride, indices);
+    }
+
+    CacheReport OptimizeMesh(void* vertices, u32 vertexCount, u32 vertexStride, Span<u32> indices, u32 cacheSize)
+    {
+        return OptimizeMeshT(vertices, vertexCount, vertexStride, indices, cacheSize);
+    }
+
+    CacheReport OptimizeMesh(void* vertices, u32 vertexCount, u32 vertexStride, Span<u16> indices, u32 cacheSize)
+    {
+        return OptimizeMeshT(vertices, vertexCount, vertexStride, indices, cacheSize);
+    }
+
+    CacheReport OptimizeMesh(GeometryGenerator::MeshData& mesh, u32 cacheSize)
+    {
+        return OptimizeMeshT(mesh.Vertices.data(), (u32)mesh.Vertices.size(), (u32)sizeof(GeometryGenerator::Vertex),
+            Span<u32>(mesh.Indices32), cacheSize);
+    }
+
+    CacheReport OptimizeOverdraw(const void* vertices, u32 vertexCount, u32 vertexStride, Span<u32> indices,
+                                 f32 threshold, u32 cacheSize)
+    {
+        return OptimizeOverdrawT(vertices, vertexCount, vertexStride, indices, threshold, cacheSize);
+    }
+
+    CacheReport OptimizeOverdraw(const void* vertices, u32 vertexCount, u32 vertexStride, Span<u16> indices,
+                                 f32 threshold, u32 cacheSize)
+    {
+        return OptimizeOverdrawT(vertices, vertexCount, vertexStride, indices, threshold, cacheSize);
+    }
+
+    CacheReport OptimizeOverdraw(GeometryGenerator::MeshData& mesh, f32 threshold, u32 cacheSize)
+    {
+        return OptimizeOverdrawT(mesh.Vertices.data(), (u32)mesh.Vertices.size(),
+            (u32)sizeof(GeometryGenerator::Vertex), Span<u32>(mesh.Indices32), threshold, cacheSize);
+    }
+
+    OverdrawStats EstimateOverdraw(const void* vertices, u32 vertexCount, u32 vertexStride, Span<const u32> indices,
+                                   u32 viewCount, u32 resolution)
+    {
+        return EstimateOverdrawT(vertices, vertexCount, vertexStride, indices, viewCount, resolution);
+    }
+
+    OverdrawStats EstimateOverdraw(const void* vertices, u32 vertexCount, u32 vertexStride, Span<const u16> indices,
+                                   u32 viewCount, u32 resolution)
+    {
+        return EstimateOverdrawT(vertices, vertexCount, vertexStride, indices, viewCount, resolution);
+    }
+
+    OverdrawStats EstimateOverdraw(const GeometryGenerator::MeshData& mesh, u32 viewCount, u32 resolution)
+    {
+        return EstimateOverdrawT(mesh.Vertices.data(), (u32)mesh.Vertices.size(),
+            (u32)sizeof(GeometryGenerator::Vertex), Span<const u32>(mesh.Indices32), viewCount, resolution);
+    }
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <Common/GeometryGenerator.hpp>
+#include <Common/Span.hpp>
+#include <Common/defines.hpp>
+
+// Load-time reordering of indexed triangle lists for the GPU's vertex
+// pipeline and, for opaque meshes, its depth test. Every pass runs in time
+// (close to) linear in the mesh size, is deterministic (the same input always
+// gives the same output) and works in place on raw vertex and index buffers
+// or on a GeometryGenerator::MeshData.
+namespace MeshOptimizer
+{
+    // Entries of the FIFO post-transform cache the statistics are simulated
+    // with; the optimizer itself is not tuned to any one size.
+    constexpr u32 DefaultCacheSize = 16;
+
+    // ACMR the overdraw pass may give up, as a factor: 1.05 allows 5% more
+    // vertex transforms in exchange for less overdraw.
+    constexpr f32 DefaultOverdrawThreshold = 1.05f;
+
+    // Post-transform vertex cache efficiency of an index buffer.
+    struct CacheStats
+    {
+        // Vertex shader invocations, i.e. cache misses.
+        u64 Transforms = 0;
+        u32 TriangleCount = 0;
+        // Distinct vertices the indices reference.
+        u32 VertexCount = 0;
+
+        // Average cache miss ratio: Transforms per triangle. Between 0.5 (a
+        // large regular mesh, each vertex transformed once) and 3.
+        f64 Acmr = 0.0;
+        // Average transform to vertex ratio: Transforms per referenced vertex.
+        // 1 is ideal whatever the topology, which makes it easier to compare.
+        f64 Atvr = 0.0;
+    };
+
+    struct CacheReport
+    {
+        CacheStats Before;
+        CacheStats After;
+    };
+
+    // Pixel shader work of opaque rendering, summed over sampled views.
+    struct OverdrawStats
+    {
+        // Pixels covered by the mesh, and depth test passes (pixel shader
+        // invocations) it took to cover them.
+        u64 PixelsCovered = 0;
+        u64 PixelsShaded = 0;
+
+        // PixelsShaded / PixelsCovered: 1 if every visible pixel is shaded once.
+        f64 Overdraw = 0.0;
+    };
+
+    // Simulates a FIFO cache of cacheSize vertices over the triangle list.
+    CacheStats AnalyzeVertexCache(Span<const u32> indices, u32 vertexCount, u32 cacheSize = DefaultCacheSize);
+    CacheStats AnalyzeVertexCache(Span<const u16> indices, u32 vertexCount, u32 cacheSize = DefaultCacheSize);
+
+    // Reorders the triangles in place for post-transform cache reuse with Tom
+    // Forsyth's "Linear-Speed Vertex Cache Optimisation": triangles are
+    // emitted greedily by a score that favors vertices recently used (in a
+    // simulated 32-entry LRU cache) and vertices with few triangles left. Each
+    // step weighs a bounded number of triangles around the cached vertices, so
+    // the pass stays linear in the triangle count even across fans of high
+    // valence. The triangles keep their winding.
+    void OptimizeVertexCache(Span<u32> indices, u32 vertexCount);
+    void OptimizeVertexCache(Span<u16> indices, u32 vertexCount);
+
+    // Renumbers the vertices in the order the indices first reference them and
+    // moves the vertex data (vertexCount vertices of vertexStride bytes) to
+    // match, so that vertex fetch walks the buffer forwards. Unreferenced
+    // vertices keep their relative order at the end.
+    void OptimizeVertexFetch(void* vertices, u32 vertexCount, u32 vertexStride, Span<u32> indices);
+    void OptimizeVertexFetch(void* vertices, u32 vertexCount, u32 vertexStride, Span<u16> indices);
+
+    // OptimizeVertexCache followed by OptimizeVertexFetch, with the cache
+    // statistics before and after.
+    CacheReport OptimizeMesh(void* vertices, u32 vertexCount, u32 vertexStride, Span<u32> indices,
+                             u32 cacheSize = DefaultCacheSize);
+    CacheReport OptimizeMesh(void* vertices, u32 vertexCount, u32 vertexStride, Span<u16> indices,
+                             u32 cacheSize = DefaultCacheSize);
+
+    // The same on Vertices and Indices32. Call it before GetIndices16, which
+    // keeps the 16-bit copy it makes first.
+    CacheReport OptimizeMesh(GeometryGenerator::MeshData& mesh, u32 cacheSize = DefaultCacheSize);
+
+    // Reorders cache-optimized triangles so that opaque meshes tend to draw
+    // their occluders first (Sander, Nehab and Barczak, "Fast Triangle
+    // Reordering for Vertex Locality and Reduced Overdraw"). The triangle
+    // order is cut into clusters where a FIFO cache of cacheSize would start
+    // cold anyway, and further where a cluster's own ACMR has come within
+    // threshold times the ACMR of the run it was cut from. Clusters are then
+    // sorted by how far they face out from the mesh center: the dot product
+    // of their area-weighted normal and their centroid's offset from the
+    // mesh's, largest first. If the new order's ACMR exceeds threshold times
+    // the input's, the input is kept. Run it between OptimizeVertexCache and
+    // OptimizeVertexFetch.
+    //
+    // Vertices are vertexCount entries of vertexStride bytes, each starting
+    // with its position as three floats; they are only read.
+    CacheReport OptimizeOverdraw(const void* vertices, u32 vertexCount, u32 vertexStride, Span<u32> indices,
+                                 f32 threshold = DefaultOverdrawThreshold, u32 cacheSize = DefaultCacheSize);
+    CacheReport OptimizeOverdraw(const void* vertices, u32 vertexCount, u32 vertexStride, Span<u16> indices,
+                                 f32 threshold = DefaultOverdrawThreshold, u32 cacheSize = DefaultCacheSize);
+    CacheReport OptimizeOverdraw(GeometryGenerator::MeshData& mesh, f32 threshold = DefaultOverdrawThreshold,
+                                 u32 cacheSize = DefaultCacheSize);
+
+    // Measures overdraw without a GPU: rasterizes the mesh in submission
+    // order into a resolution x resolution depth buffer from viewCount
+    // directions spread evenly over the sphere, each an orthographic view
+    // framing the whole mesh, with back faces culled (clockwise front faces,
+    // as in Direct3D's default rasterizer state) and a less-than depth test.
+    // Vertex layout as for OptimizeOverdraw.
+    OverdrawStats EstimateOverdraw(const void* vertices, u32 vertexCount, u32 vertexStride, Span<const u32> indices,
+                                   u32 viewCount = 16, u32 resolution = 256);
+    OverdrawStats EstimateOverdraw(const void* vertices, u32 vertexCount, u32 vertexStride, Span<const u16> indices,
+                                   u32 viewCount = 16, u32 resolution = 256);
+    OverdrawStats EstimateOverdraw(const GeometryGenerator::MeshData& mesh, u32 viewCount = 16,
+                                   u32 resolution = 256);
+}
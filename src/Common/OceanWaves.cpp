@@ -0,0 +1,301 @@
+#include <Common/OceanWaves.hpp>
+#include <Common/JobSystem.hpp>
+#include <Common/WavesKernels.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+    constexpr f64 Gravity = 9.81;
+    constexpr f64 Pi = 3.141592653589793;
+}
+
+OceanWaves::OceanWaves(const OceanParams& params)
+    : mParams(params)
+    , mFft(params.Size)
+{
+    assert(params.Size >= 16 && (params.Size & (params.Size - 1)) == 0);
+    assert(params.PatchSize > 0.0f && params.RepeatPeriod > 0.0f);
+
+    mSpatialStep = mParams.PatchSize / mParams.Size;
+    mHalfWidth = (mParams.Size - 1) * mSpatialStep * 0.5f;
+    mHalfDepth = mHalfWidth;
+
+    size_t cells = (size_t)mParams.Size * mParams.Size;
+    for (AlignedBuffer<f32>* plane : { &mP, &mQ, &mR, &mS, &mOmega, &mHeights, &mSlopeX, &mSlopeZ, &mScratch })
+    {
+        plane->Reset(cells);
+    }
+    mKx.Reset(mParams.Size);
+    mKz.Reset(mParams.Size);
+
+    BuildSpectrum();
+    Evaluate();
+}
+
+f64 OceanWaves::SpectrumVariance(f64 kx, f64 kz) const
+{
+    f64 k = sqrt(kx * kx + kz * kz);
+    if (k < 1e-6)
+    {
+        return 0.0;
+    }
+
+    // Downwind half-plane only, so that the spreading integrates to one.
+    f64 cosTheta = (kx * cos(mParams.WindDirection) + kz * sin(mParams.WindDirection)) / k;
+    if (cosTheta <= 0.0)
+    {
+        return 0.0;
+    }
+    f64 spreading = (2.0 / Pi) * cosTheta * cosTheta;
+
+    // Omnidirectional wavenumber spectrum S(k), with int S(k) dk = height variance.
+    f64 wind = mParams.WindSpeed;
+    f64 spectrum = 0.0;
+    if (mParams.Spectrum == OceanSpectrum::Phillips)
+    {
+        f64 largestWave = wind * wind / Gravity;
+        f64 kl = k * largestWave;
+        spectrum = 0.5 * mParams.Amplitude / (k * k * k) * exp(-1.0 / (kl * kl));
+    }
+    else
+    {
+        f64 fetch = mParams.Fetch;
+        f64 alpha = 0.076 * pow(wind * wind / (fetch * Gravity), 0.22);
+        f64 peak = 22.0 * cbrt(Gravity * Gravity / (wind * fetch));
+        f64 omega = sqrt(Gravity * k);
+        f64 sigma = omega <= peak ? 0.07 : 0.09;
+        f64 offset = (omega - peak) / (sigma * peak);
+        f64 ratio = peak / omega;
+        f64 frequencySpectrum = alpha * Gravity * Gravity / pow(omega, 5.0) * exp(-1.25 * ratio * ratio * ratio * ratio) *
+                                pow((f64)mParams.PeakEnhancement, exp(-0.5 * offset * offset));
+
+        // S(k) = S(w) dw/dk with w = sqrt(g k).
+        spectrum = frequencySpectrum * Gravity / (2.0 * omega);
+    }
+
+    f64 cutoff = mParams.SmallWaveCutoff;
+    spectrum *= exp(-k * k * cutoff * cutoff);
+
+    // Polar to Cartesian density (dk = k dk dtheta), times one grid cell.
+    f64 dk = 2.0 * Pi / mParams.PatchSize;
+    return spectrum / k * spreading * dk * dk;
+}
+
+void OceanWaves::BuildSpectrum()
+{
+    const i32 n = (i32)mParams.Size;
+    const f64 dk = 2.0 * Pi / mParams.PatchSize;
+    const f64 omegaStep = 2.0 * Pi / mParams.RepeatPeriod;
+
+    // Signed wavenumber index of grid index i.
+    auto wave = [n](i32 i) { return i < n / 2 ? i : i - n; };
+    for (i32 i = 0; i < n; ++i)
+    {
+        mKx[i] = (f32)(dk * wave(i));
+        mKz[i] = (f32)(dk * wave(i));
+    }
+
+    // h0 = (xr + i xi) sqrt(variance) / 2 for standard normal xr, xi, so that
+    // E|h0(k)|^2 = variance / 2 and h(k) and h(-k) together carry the cell's
+    // variance (the spreading leaves one of the pair empty). The Nyquist row
+    // and column are left empty so h(k, t) stays Hermitian.
+    std::mt19937 random(mParams.Seed);
+    std::normal_distribution<f32> normal;
+    std::vector<f32> h0Re((size_t)n * n);
+    std::vector<f32> h0Im((size_t)n * n);
+    f64 variance = 0.0;
+    for (i32 m = 0; m < n; ++m)
+    {
+        for (i32 j = 0; j < n; ++j)
+        {
+            f32 xr = normal(random);
+            f32 xi = normal(random);
+            size_t index = (size_t)m * n + j;
+            if (m == n / 2 || j == n / 2)
+            {
+                continue;
+            }
+
+            // The FFT frame's z runs along the rows, against world z.
+            f64 cellVariance = SpectrumVariance(dk * wave(m), -dk * wave(j));
+            f64 scale = 0.5 * sqrt(cellVariance);
+            h0Re[index] = (f32)(xr * scale);
+            h0Im[index] = (f32)(xi * scale);
+            variance += cellVariance;
+        }
+    }
+    mHeightVariance = (f32)variance;
+
+    for (i32 m = 0; m < n; ++m)
+    {
+        for (i32 j = 0; j < n; ++j)
+        {
+            size_t index = (size_t)m * n + j;
+            size_t mirror = (size_t)((n - m) % n) * n + (n - j) % n;
+            f32 a = h0Re[index];
+            f32 b = h0Im[index];
+            f32 c = h0Re[mirror];
+            f32 d = -h0Im[mirror];
+            mP[index] = a + c;
+            mQ[index] = d - b;
+            mR[index] = b + d;
+            mS[index] = a - c;
+
+            f64 k = dk * sqrt((f64)wave(m) * wave(m) + (f64)wave(j) * wave(j));
+            mOmega[index] = (f32)(floor(sqrt(Gravity * k) / omegaStep) * omegaStep);
+        }
+    }
+}
+
+i32 OceanWaves::RowGrain() const
+{
+    // ~16K cells per job, like the other surfaces.
+    return std::max(1, (16 * 1024) / (i32)mParams.Size);
+}
+
+void OceanWaves::Evaluate()
+{
+    const i32 n = (i32)mParams.Size;
+    const XMVECTOR time = XMVectorReplicate(mTime);
+    const XMVECTOR one = XMVectorReplicate(1.0f);
+
+    // h + i (i kx h) = (1 - kx) h transforms to height + i dh/dx, and i kz h
+    // to dh/dz; both transforms are real because h(k, t) is Hermitian.
+    JobSystem::Get().ParallelFor(0, n, RowGrain(), [&](i32 firstRow, i32 lastRow)
+    {
+        for (i32 m = firstRow; m < lastRow; ++m)
+        {
+            const XMVECTOR heightScale = XMVectorSubtract(one, XMVectorReplicate(mKx[m]));
+            size_t row = (size_t)m * n;
+            for (i32 j = 0; j < n; j += 4)
+            {
+                size_t index = row + j;
+                XMVECTOR sinWt, cosWt;
+                XMVectorSinCos(&sinWt, &cosWt, XMVectorMultiply(XMLoadFloat4A((const XMFLOAT4A*)&mOmega[index]), time));
+
+                XMVECTOR hRe = XMVectorAdd(XMVectorMultiply(XMLoadFloat4A((const XMFLOAT4A*)&mP[index]), cosWt),
+                                           XMVectorMultiply(XMLoadFloat4A((const XMFLOAT4A*)&mQ[index]), sinWt));
+                XMVECTOR hIm = XMVectorAdd(XMVectorMultiply(XMLoadFloat4A((const XMFLOAT4A*)&mR[index]), cosWt),
+                                           XMVectorMultiply(XMLoadFloat4A((const XMFLOAT4A*)&mS[index]), sinWt));
+                XMVECTOR kz = XMLoadFloat4A((const XMFLOAT4A*)&mKz[j]);
+
+                XMStoreFloat4A((XMFLOAT4A*)&mHeights[index], XMVectorMultiply(hRe, heightScale));
+                XMStoreFloat4A((XMFLOAT4A*)&mSlopeX[index], XMVectorMultiply(hIm, heightScale));
+                XMStoreFloat4A((XMFLOAT4A*)&mSlopeZ[index], XMVectorNegate(XMVectorMultiply(hIm, kz)));
+                XMStoreFloat4A((XMFLOAT4A*)&mScratch[index], XMVectorMultiply(hRe, kz));
+            }
+        }
+    });
+
+    mFft.TransformTransposed(mHeights.Data(), mSlopeX.Data(), FftDirection::Inverse);
+    mFft.TransformTransposed(mSlopeZ.Data(), mScratch.Data(), FftDirection::Inverse);
+}
+
+void OceanWaves::Update(f32 dt)
+{
+    mTime = fmodf(mTime + dt, mParams.RepeatPeriod);
+    if (mTime < 0.0f)
+    {
+        mTime += mParams.RepeatPeriod;
+    }
+
+    Evaluate();
+    ++mVersion;
+}
+
+void OceanWaves::Step(i32 count)
+{
+    Update(count * mParams.StepTime);
+}
+
+void OceanWaves::Disturb(i32 i, i32 j, f32 magnitude)
+{
+    (void)i;
+    (void)j;
+    (void)magnitude;
+}
+
+XMFLOAT3 OceanWaves::Position(i32 i) const
+{
+    i32 n = (i32)mParams.Size;
+    i32 row = i / n;
+    i32 col = i - row * n;
+    return XMFLOAT3(-mHalfWidth + col * mSpatialStep, mHeights[i], mHalfDepth - row * mSpatialStep);
+}
+
+XMFLOAT3 OceanWaves::Normal(i32 i) const
+{
+    // World z runs against the FFT frame's, so dh/dz flips sign.
+    f32 nx = -mSlopeX[i];
+    f32 nz = mSlopeZ[i];
+    f32 length = sqrtf(nx * nx + 1.0f + nz * nz);
+    return XMFLOAT3(nx / length, 1.0f / length, nz / length);
+}
+
+XMFLOAT3 OceanWaves::TangentX(i32 i) const
+{
+    f32 ty = mSlopeX[i];
+    f32 length = sqrtf(1.0f + ty * ty);
+    return XMFLOAT3(1.0f / length, ty / length, 0.0f);
+}
+
+void OceanWaves::RowNormals(i32 i, XMFLOAT3* normals) const
+{
+    const i32 n = (i32)mParams.Size;
+    const f32* slopeX = mSlopeX.Data() + (size_t)i * n;
+    const f32* slopeZ = mSlopeZ.Data() + (size_t)i * n;
+    for (i32 j = 0; j < n; ++j)
+    {
+        f32 nx = -slopeX[j];
+        f32 nz = slopeZ[j];
+        f32 invLength = 1.0f / sqrtf(nx * nx + 1.0f + nz * nz);
+        normals[j] = XMFLOAT3(nx * invLength, invLength, nz * invLength);
+    }
+}
+
+void OceanWaves::WriteVertices(Span<WavesVertex> dst, u64* dstVersion, f32 alpha, WavesWriteStats* stats) const
+{
+    // Every evaluation is exact, so there is nothing to blend.
+    (void)alpha;
+
+    const i32 n = (i32)mParams.Size;
+    assert(dst.Size() >= (size_t)n * n);
+
+    bool current = dstVersion && *dstVersion == mVersion;
+    if (dstVersion)
+    {
+        *dstVersion = mVersion;
+    }
+    if (stats)
+    {
+        stats->BytesWritten = current ? 0 : (u64)n * n * sizeof(WavesVertex);
+        stats->DirtyRows.clear();
+        if (!current)
+        {
+            stats->DirtyRows.push_back({ 0, n });
+        }
+    }
+    if (current)
+    {
+        return;
+    }
+
+    f32* out = reinterpret_cast<f32*>(dst.Data());
+    JobSystem::Get().ParallelFor(0, n, RowGrain(), [this, out, n](i32 firstRow, i32 lastRow)
+    {
+        std::vector<XMFLOAT3> normals(n);
+        for (i32 i = firstRow; i < lastRow; ++i)
+        {
+            RowNormals(i, normals.data());
+            WavesKernels::WriteVertexRow(mHeights.Data() + (size_t)i * n, 1, normals.data(), 0, n, -mHalfWidth,
+                mSpatialStep, mHalfDepth - i * mSpatialStep, Width(), Depth(), out + (size_t)i * n * 8);
+        }
+        WavesKernels::StreamFence();
+    });
+}
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <Common/AlignedBuffer.hpp>
+#include <Common/Fft.hpp>
+#include <Common/Waves.hpp>
+#include <Common/defines.hpp>
+
+// Directional wave spectrum an OceanWaves patch is seeded from.
+//   Phillips: a k^-3 wavenumber spectrum with a low-wavenumber cutoff at the
+//             largest wave the wind can raise, L = V^2 / g (Tessendorf).
+//   Jonswap:  the fetch-limited spectrum of a developing sea: a Pierson-
+//             Moskowitz shape with a sharper peak; alpha and the peak frequency
+//             follow from WindSpeed and Fetch.
+// Both are spread over the downwind half-plane with (2/pi) cos^2.
+enum class OceanSpectrum
+{
+    Phillips,
+    Jonswap
+};
+
+struct OceanParams
+{
+    // Grid points per side; a power of two of at least 16.
+    u32 Size = 256;
+
+    // World-space side of the patch in metres. The surface is periodic over it.
+    f32 PatchSize = 256.0f;
+
+    OceanSpectrum Spectrum = OceanSpectrum::Phillips;
+
+    // Wind speed in m/s and the direction it blows towards, in radians
+    // counter-clockwise from +x in the xz plane (0 = +x, pi/2 = +z).
+    f32 WindSpeed = 12.0f;
+    f32 WindDirection = 0.0f;
+
+    // Phillips constant (alpha). Unused by Jonswap, which derives it.
+    f32 Amplitude = 8.1e-3f;
+
+    // Jonswap only: distance in metres the wind has blown over open water,
+    // and the peak enhancement factor gamma.
+    f32 Fetch = 100000.0f;
+    f32 PeakEnhancement = 3.3f;
+
+    // Waves much shorter than this (metres) are damped by exp(-k^2 l^2).
+    f32 SmallWaveCutoff = 0.5f;
+
+    // The dispersion relation is quantized so the animation loops exactly
+    // after this many seconds.
+    f32 RepeatPeriod = 200.0f;
+
+    // Seconds advanced by Step(1).
+    f32 StepTime = 1.0f / 60.0f;
+
+    u32 Seed = 1337;
+};
+
+// Statistical ocean surface after Tessendorf, "Simulating Ocean Water": a
+// Gaussian random field of wave amplitudes is drawn once from OceanParams'
+// spectrum, and every Update advances each wave analytically with the deep
+// water dispersion relation w^2 = g k and transforms the spectrum back to
+// heights with two inverse Fft2D transforms per frame (heights and x slopes
+// packed into one, z slopes into the other).
+//
+// Implements WavesSurface with the same grid conventions as Waves (row-major,
+// x growing with the column, z shrinking with the row), so it can stand in
+// for the pond in the demos. Unlike Waves it is not a simulation: there is no
+// state to disturb, Update is exact for any dt and never interpolates.
+class OceanWaves final : public WavesSurface
+{
+public:
+    explicit OceanWaves(const OceanParams& params);
+    OceanWaves(const OceanWaves&) = delete;
+    OceanWaves& operator=(const OceanWaves&) = delete;
+
+    const OceanParams& Params() const { return mParams; }
+
+    i32 RowCount() const override { return (i32)mParams.Size; }
+    i32 ColumnCount() const override { return (i32)mParams.Size; }
+    i32 VertexCount() const override { return (i32)(mParams.Size * mParams.Size); }
+    i32 TriangleCount() const override { return (i32)((mParams.Size - 1) * (mParams.Size - 1) * 2); }
+    f32 Width() const override { return mParams.Size * mSpatialStep; }
+    f32 Depth() const override { return mParams.Size * mSpatialStep; }
+    u64 Version() const override { return mVersion; }
+
+    DirectX::XMFLOAT3 Position(i32 i) const override;
+    DirectX::XMFLOAT3 Normal(i32 i) const override;
+    DirectX::XMFLOAT3 TangentX(i32 i) const override;
+
+    // Advances the clock by dt seconds (wrapped to RepeatPeriod) and
+    // re-evaluates the surface.
+    void Update(f32 dt) override;
+    f32 InterpolationAlpha() const override { return 1.0f; }
+    void Step(i32 count) override;
+
+    // The spectrum has no local state to excite; ignored.
+    void Disturb(i32 i, i32 j, f32 magnitude) override;
+
+    void WriteVertices(Span<WavesVertex> dst, u64* dstVersion = nullptr, f32 alpha = 1.0f,
+                       WavesWriteStats* stats = nullptr) const override;
+
+    // Seconds into the repeat period of the current surface.
+    f32 Time() const { return mTime; }
+
+    // Variance of the height field implied by the spectrum (m^2); the
+    // significant wave height is 4 * sqrt(HeightVariance()).
+    f32 HeightVariance() const { return mHeightVariance; }
+
+private:
+    // Spectral variance of the wave with world wavevector (kx, kz), for one
+    // cell of the wavenumber grid.
+    f64 SpectrumVariance(f64 kx, f64 kz) const;
+
+    void BuildSpectrum();
+    void Evaluate();
+
+    // Normals of row i into normals[0, Size()).
+    void RowNormals(i32 i, DirectX::XMFLOAT3* normals) const;
+
+    i32 RowGrain() const;
+
+    OceanParams mParams;
+    f32 mSpatialStep = 1.0f;
+    f32 mHalfWidth = 0.0f;
+    f32 mHalfDepth = 0.0f;
+
+    f32 mTime = 0.0f;
+    u64 mVersion = 1;
+    f32 mHeightVariance = 0.0f;
+
+    Fft2D mFft;
+
+    // Spectrum planes in transposed order: element [m][n] is the wave with
+    // x wavenumber index m and z index n, so the transposed output of Fft2D
+    // comes back as [row][column]. With h0 the amplitude drawn for k and
+    // h0m = conj(h0(-k)), the time-dependent amplitude
+    //   h(k, t) = h0 e^{iwt} + h0m e^{-iwt}
+    // is (P cos wt + Q sin wt) + i (R cos wt + S sin wt).
+    AlignedBuffer<f32> mP;
+    AlignedBuffer<f32> mQ;
+    AlignedBuffer<f32> mR;
+    AlignedBuffer<f32> mS;
+    AlignedBuffer<f32> mOmega;
+
+    // Wavenumbers of the x index m and of the z index n in the FFT's frame.
+    AlignedBuffer<f32> mKx;
+    AlignedBuffer<f32> mKz;
+
+    // Inverse transform inputs, and after Evaluate the surface:
+    // mHeights + i mSlopeX and mSlopeZ (+ i mScratch, unused) in FFT frame
+    // z, which grows with the row.
+    AlignedBuffer<f32> mHeights;
+    AlignedBuffer<f32> mSlopeX;
+    AlignedBuffer<f32> mSlopeZ;
+    AlignedBuffer<f32> mScratch;
+};
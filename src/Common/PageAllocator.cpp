@@ -0,0 +1,415 @@
+#include <Common/PageAllocator.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+void PageStats::Add(const PageStats& other)
+{
+    Bytes += other.Bytes;
+    ResidentBytes += other.ResidentBytes;
+    HugePageBytes += other.HugePageBytes;
+    BasePageSize = std::max(BasePageSize, other.BasePageSize);
+    HugePageSize = std::max(HugePageSize, other.HugePageSize);
+    BasePages += other.BasePages;
+    HugePages += other.HugePages;
+    TlbEntries += other.TlbEntries;
+
+    if (NodeBytes.size() < other.NodeBytes.size())
+    {
+        NodeBytes.resize(other.NodeBytes.size());
+    }
+    for (size_t node = 0; node < other.NodeBytes.size(); ++node)
+    {
+        NodeBytes[node] += other.NodeBytes[node];
+    }
+}
+
+namespace
+{
+    u64 RoundUp(u64 bytes, u64 multiple)
+    {
+        return (bytes + multiple - 1) / multiple * multiple;
+    }
+
+    // Bytes actually mapped for an allocation of bytes under policy.
+    u64 MappedBytes(size_t bytes, PagePolicy policy)
+    {
+        return RoundUp(bytes, policy == PagePolicy::Pages ? BasePageSize() : HugePageSize());
+    }
+
+    // Fills in the page counts from the resident and huge byte totals.
+    void FinishStats(PageStats& stats)
+    {
+        stats.HugePageBytes = std::min(stats.HugePageBytes, stats.ResidentBytes);
+        stats.HugePages = (stats.HugePageBytes + stats.HugePageSize - 1) / stats.HugePageSize;
+        stats.BasePages = (stats.ResidentBytes - stats.HugePageBytes) / stats.BasePageSize;
+        stats.TlbEntries = stats.BasePages + stats.HugePages;
+    }
+}
+
+#if defined(_WIN32)
+
+u64 BasePageSize()
+{
+    static const u64 size = []()
+    {
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        return (u64)info.dwPageSize;
+    }();
+    return size;
+}
+
+u64 HugePageSize()
+{
+    static const u64 size = []()
+    {
+        SIZE_T large = GetLargePageMinimum();
+        return large != 0 ? (u64)large : (u64)2 * 1024 * 1024;
+    }();
+    return size;
+}
+
+namespace
+{
+    // Large pages need SeLockMemoryPrivilege, which is granted to the account
+    // by policy but disabled in the token by default.
+    bool EnableLockMemoryPrivilege()
+    {
+        static const bool enabled = []()
+        {
+            HANDLE token;
+            if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+            {
+                return false;
+            }
+
+            TOKEN_PRIVILEGES privileges = {};
+            privileges.PrivilegeCount = 1;
+            privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+            bool ok = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &privileges.Privileges[0].Luid) &&
+                      AdjustTokenPrivileges(token, FALSE, &privileges, 0, nullptr, nullptr) &&
+                      GetLastError() == ERROR_SUCCESS;
+            CloseHandle(token);
+            return ok;
+        }();
+        return enabled;
+    }
+}
+
+// Whole pages for bytes under policy, or null.
+static void* MapPages(size_t bytes, PagePolicy policy)
+{
+    if (policy == PagePolicy::HugeTlb && GetLargePageMinimum() != 0 && EnableLockMemoryPrivilege())
+    {
+        void* data = VirtualAlloc(nullptr, (SIZE_T)MappedBytes(bytes, policy),
+            MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (data != nullptr)
+        {
+            return data;
+        }
+    }
+
+    return VirtualAlloc(nullptr, (SIZE_T)MappedBytes(bytes, policy), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+static void UnmapPages(void* base, size_t bytes, PagePolicy policy)
+{
+    (void)bytes;
+    (void)policy;
+    VirtualFree(base, 0, MEM_RELEASE);
+}
+
+PageStats QueryPageStats(const void* data, size_t bytes)
+{
+    PageStats stats;
+    stats.Bytes = bytes;
+    stats.BasePageSize = BasePageSize();
+    stats.HugePageSize = HugePageSize();
+    if (data == nullptr || bytes == 0)
+    {
+        return stats;
+    }
+
+    const u64 pageSize = stats.BasePageSize;
+    u64 first = (u64)(uintptr_t)data / pageSize * pageSize;
+    u64 end = RoundUp((u64)(uintptr_t)data + bytes, pageSize);
+
+    std::vector<PSAPI_WORKING_SET_EX_INFORMATION> pages(1024);
+    for (u64 address = first; address < end; address += pages.size() * pageSize)
+    {
+        size_t count = (size_t)std::min<u64>(pages.size(), (end - address) / pageSize);
+        for (size_t k = 0; k < count; ++k)
+        {
+            pages[k].VirtualAddress = (void*)(uintptr_t)(address + k * pageSize);
+        }
+        if (!QueryWorkingSetEx(GetCurrentProcess(), pages.data(), (DWORD)(count * sizeof(pages[0]))))
+        {
+            break;
+        }
+
+        for (size_t k = 0; k < count; ++k)
+        {
+            const auto& attributes = pages[k].VirtualAttributes;
+            if (!attributes.Valid)
+            {
+                continue;
+            }
+
+            stats.ResidentBytes += pageSize;
+            if (attributes.LargePage)
+            {
+                stats.HugePageBytes += pageSize;
+            }
+            if (stats.NodeBytes.size() <= attributes.Node)
+            {
+                stats.NodeBytes.resize(attributes.Node + 1);
+            }
+            stats.NodeBytes[attributes.Node] += pageSize;
+        }
+    }
+
+    FinishStats(stats);
+    return stats;
+}
+
+#else
+
+u64 BasePageSize()
+{
+    static const u64 size = (u64)sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+u64 HugePageSize()
+{
+    static const u64 size = []()
+    {
+        unsigned long long bytes = 0;
+        if (FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r"))
+        {
+            if (fscanf(file, "%llu", &bytes) != 1)
+            {
+                bytes = 0;
+            }
+            fclose(file);
+        }
+        return bytes != 0 ? (u64)bytes : (u64)2 * 1024 * 1024;
+    }();
+    return size;
+}
+
+// Whole pages for bytes under policy, or null.
+static void* MapPages(size_t bytes, PagePolicy policy)
+{
+    const u64 mapped = MappedBytes(bytes, policy);
+    if (policy == PagePolicy::Pages)
+    {
+        void* data = mmap(nullptr, (size_t)mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return data != MAP_FAILED ? data : nullptr;
+    }
+
+    if (policy == PagePolicy::HugeTlb)
+    {
+        void* data = mmap(nullptr, (size_t)mapped, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data != MAP_FAILED)
+        {
+            return data;
+        }
+    }
+
+    // Transparent huge pages only back huge-page-aligned ranges: map one huge
+    // page more than needed and trim the ends.
+    const u64 hugePage = HugePageSize();
+    void* reserved = mmap(nullptr, (size_t)(mapped + hugePage), PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (reserved == MAP_FAILED)
+    {
+        return nullptr;
+    }
+
+    u8* base = static_cast<u8*>(reserved);
+    u8* aligned = base + (RoundUp((u64)(uintptr_t)base, hugePage) - (u64)(uintptr_t)base);
+    if (aligned != base)
+    {
+        munmap(base, (size_t)(aligned - base));
+    }
+    u8* end = aligned + mapped;
+    u8* reservedEnd = base + mapped + hugePage;
+    if (end != reservedEnd)
+    {
+        munmap(end, (size_t)(reservedEnd - end));
+    }
+
+    madvise(aligned, (size_t)mapped, MADV_HUGEPAGE);
+    return aligned;
+}
+
+static void UnmapPages(void* base, size_t bytes, PagePolicy policy)
+{
+    munmap(base, (size_t)MappedBytes(bytes, policy));
+}
+
+namespace
+{
+    // Huge page bytes of the mappings overlapping [first, end), each prorated
+    // by how much of it falls inside the range.
+    u64 SmapsHugeBytes(u64 first, u64 end)
+    {
+        FILE* file = fopen("/proc/self/smaps", "r");
+        if (file == nullptr)
+        {
+            return 0;
+        }
+
+        f64 hugeBytes = 0.0;
+        f64 overlap = 0.0;
+        bool hugeTlb = false;
+        char line[512];
+        while (fgets(line, sizeof(line), file))
+        {
+            unsigned long long start, stop;
+            unsigned long long kb;
+            char name[64];
+            if (sscanf(line, "%llx-%llx ", &start, &stop) == 2)
+            {
+                // Header of the next mapping.
+                u64 lo = std::max<u64>(start, first);
+                u64 hi = std::min<u64>(stop, end);
+                overlap = hi > lo ? (f64)(hi - lo) / (f64)(stop - start) : 0.0;
+                hugeTlb = false;
+            }
+            else if (overlap > 0.0 && sscanf(line, "%63[^:]: %llu kB", name, &kb) == 2)
+            {
+                u64 value = (u64)kb * 1024;
+                if (strcmp(name, "AnonHugePages") == 0)
+                {
+                    hugeBytes += overlap * value;
+                }
+                else if (strcmp(name, "KernelPageSize") == 0 && value > BasePageSize())
+                {
+                    hugeTlb = true;
+                }
+                else if (hugeTlb && (strcmp(name, "Private_Hugetlb") == 0 || strcmp(name, "Shared_Hugetlb") == 0))
+                {
+                    hugeBytes += overlap * value;
+                }
+            }
+        }
+        fclose(file);
+        return (u64)hugeBytes;
+    }
+}
+
+PageStats QueryPageStats(const void* data, size_t bytes)
+{
+    PageStats stats;
+    stats.Bytes = bytes;
+    stats.BasePageSize = BasePageSize();
+    stats.HugePageSize = HugePageSize();
+    if (data == nullptr || bytes == 0)
+    {
+        return stats;
+    }
+
+    const u64 pageSize = stats.BasePageSize;
+    u64 first = (u64)(uintptr_t)data / pageSize * pageSize;
+    u64 end = RoundUp((u64)(uintptr_t)data + bytes, pageSize);
+    size_t pageCount = (size_t)((end - first) / pageSize);
+
+    // Residency per base page; mincore works for anonymous memory as well.
+    std::vector<unsigned char> resident(pageCount);
+    if (mincore((void*)(uintptr_t)first, (size_t)(end - first), resident.data()) != 0)
+    {
+        return stats;
+    }
+
+    // Node of every resident page, queried in batches with move_pages and no
+    // target nodes. Kernels without NUMA support fail the call.
+    std::vector<void*> pages;
+    pages.reserve(pageCount);
+    for (size_t k = 0; k < pageCount; ++k)
+    {
+        if (resident[k] & 1)
+        {
+            pages.push_back((void*)(uintptr_t)(first + k * pageSize));
+        }
+    }
+    stats.ResidentBytes = (u64)pages.size() * pageSize;
+
+    const size_t batch = 4096;
+    std::vector<int> status(batch);
+    for (size_t k = 0; k < pages.size(); k += batch)
+    {
+        size_t count = std::min(batch, pages.size() - k);
+        if (syscall(SYS_move_pages, 0, (unsigned long)count, &pages[k], nullptr, status.data(), 0) != 0)
+        {
+            stats.NodeBytes.clear();
+            break;
+        }
+        for (size_t p = 0; p < count; ++p)
+        {
+            if (status[p] < 0)
+            {
+                continue;
+            }
+            if (stats.NodeBytes.size() <= (size_t)status[p])
+            {
+                stats.NodeBytes.resize((size_t)status[p] + 1);
+            }
+            stats.NodeBytes[status[p]] += pageSize;
+        }
+    }
+
+    stats.HugePageBytes = SmapsHugeBytes(first, end);
+    FinishStats(stats);
+    return stats;
+}
+
+#endif
+
+namespace
+{
+    // Allocations start a varying number of cache lines into their page-aligned
+    // mapping. Otherwise arrays that are walked side by side (the two solution
+    // planes, say) would all start on the same cache set, and with huge pages
+    // stay in step for 2 MB, thrashing the L1 and L2 sets they share.
+    constexpr u64 StaggerStep = 128;
+    constexpr u32 StaggerCount = 32;
+    std::atomic<u32> gNextStagger{ 0 };
+}
+
+void* AllocatePages(size_t bytes, PagePolicy policy)
+{
+    assert(policy != PagePolicy::Heap);
+
+    u64 offset = (gNextStagger.fetch_add(1, std::memory_order_relaxed) % StaggerCount) * StaggerStep;
+    u8* base = static_cast<u8*>(MapPages((size_t)(bytes + offset), policy));
+    return base != nullptr ? base + offset : nullptr;
+}
+
+void FreePages(void* data, size_t bytes, PagePolicy policy)
+{
+    if (data == nullptr)
+    {
+        return;
+    }
+
+    // The stagger is less than a page, and the mapping starts on one.
+    u64 offset = (u64)(uintptr_t)data % BasePageSize();
+    UnmapPages(static_cast<u8*>(data) - offset, (size_t)(bytes + offset), policy);
+}
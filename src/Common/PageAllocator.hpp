@@ -0,0 +1,160 @@
+#pragma once
+
+#include <Common/defines.hpp>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Where large arrays get their memory from.
+//   Heap:            operator new, like any other allocation.
+//   Pages:           whole pages straight from the OS (mmap / VirtualAlloc),
+//                    left untouched until first written.
+//   TransparentHuge: as Pages, aligned to the huge page size and marked for
+//                    transparent huge pages (madvise(MADV_HUGEPAGE)), so the
+//                    kernel backs it with 2 MB pages where it can. On Windows,
+//                    which has no transparent huge pages, the same as Pages.
+//   HugeTlb:         explicit huge pages from the reserved pool (MAP_HUGETLB on
+//                    Linux, MEM_LARGE_PAGES with SeLockMemoryPrivilege on
+//                    Windows); falls back to TransparentHuge when the pool is
+//                    empty or the privilege is missing.
+// Under every policy but Heap the kernel places a page on the NUMA node of
+// the thread that first writes it (first touch), so code that initializes an
+// array with the same partitioning its workers later use keeps their accesses
+// node-local. Windows large pages are the exception: they are committed, and
+// placed, up front.
+enum class PagePolicy
+{
+    Heap,
+    Pages,
+    TransparentHuge,
+    HugeTlb
+};
+
+// Residency of an address range, as reported by the OS (/proc/self/smaps and
+// move_pages on Linux, QueryWorkingSetEx on Windows). Only pages that have
+// been touched are resident.
+struct PageStats
+{
+    u64 Bytes = 0;
+    u64 ResidentBytes = 0;
+
+    // Resident bytes backed by huge pages (transparent or explicit).
+    u64 HugePageBytes = 0;
+
+    u64 BasePageSize = 0;
+    u64 HugePageSize = 0;
+
+    // Resident pages of each size; TlbEntries = BasePages + HugePages is the
+    // number of translations needed to reach the whole resident range.
+    u64 BasePages = 0;
+    u64 HugePages = 0;
+    u64 TlbEntries = 0;
+
+    // Resident bytes per NUMA node, indexed by node number; empty if the OS
+    // does not report placement.
+    std::vector<u64> NodeBytes;
+
+    // Sums the counters of other into this one.
+    void Add(const PageStats& other);
+};
+
+u64 BasePageSize();
+u64 HugePageSize();
+
+// Allocates bytes of zero-filled memory from whole pages under policy, which
+// must not be Heap. Returns null if the OS refuses. The start is 128-byte
+// aligned and staggered by a few cache lines from one allocation to the next,
+// so that arrays used side by side do not alias in the caches. The memory
+// must be freed with FreePages and the same bytes and policy.
+void* AllocatePages(size_t bytes, PagePolicy policy);
+void FreePages(void* data, size_t bytes, PagePolicy policy);
+
+PageStats QueryPageStats(const void* data, size_t bytes);
+
+// Standard allocator over AllocatePages, for types aligned to at most 128
+// bytes. Allocations smaller than MinPageBytes stay on the heap whatever the
+// policy, since rounding them up to whole pages would waste more than it saves.
+//
+// Unlike std::allocator, construct() without arguments default-initializes:
+// resize() leaves trivially constructible elements uninitialized, so it does
+// not touch the pages before the caller's own (possibly parallel) first write.
+template <typename T>
+class PageAllocator
+{
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+    using is_always_equal = std::false_type;
+
+    static constexpr size_t MinPageBytes = 64 * 1024;
+
+    PageAllocator() = default;
+    explicit PageAllocator(PagePolicy policy) : mPolicy(policy) {}
+
+    template <typename U>
+    PageAllocator(const PageAllocator<U>& rhs) : mPolicy(rhs.Policy()) {}
+
+    PagePolicy Policy() const { return mPolicy; }
+
+    T* allocate(size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+        if (UsesHeap(bytes))
+        {
+            return static_cast<T*>(::operator new(bytes, std::align_val_t(alignof(T) > 64 ? alignof(T) : 64)));
+        }
+
+        void* data = AllocatePages(bytes, mPolicy);
+        if (data == nullptr)
+        {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(data);
+    }
+
+    void deallocate(T* data, size_t count)
+    {
+        size_t bytes = count * sizeof(T);
+        if (UsesHeap(bytes))
+        {
+            ::operator delete(data, std::align_val_t(alignof(T) > 64 ? alignof(T) : 64));
+        }
+        else
+        {
+            FreePages(data, bytes, mPolicy);
+        }
+    }
+
+    template <typename U>
+    void construct(U* p)
+    {
+        ::new (static_cast<void*>(p)) U;
+    }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    bool operator==(const PageAllocator<U>& rhs) const { return mPolicy == rhs.Policy(); }
+    template <typename U>
+    bool operator!=(const PageAllocator<U>& rhs) const { return mPolicy != rhs.Policy(); }
+
+private:
+    bool UsesHeap(size_t bytes) const
+    {
+        return mPolicy == PagePolicy::Heap || bytes < MinPageBytes;
+    }
+
+    PagePolicy mPolicy = PagePolicy::Heap;
+};
+
+// std::vector whose storage follows a PagePolicy.
+template <typename T>
+using PageVector = std::vector<T, PageAllocator<T>>;
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Common/defines.hpp>
+#include <cassert>
+#include <cstddef>
+#include <type_traits>
+
+// Non-owning view of a contiguous array (a minimal stand-in for C++20 std::span).
+// Spans are cheap to copy and never outlive the storage they point into.
+template <typename T>
+class Span
+{
+public:
+    Span() = default;
+
+    Span(T* data, size_t size) : mData(data), mSize(size) {}
+
+    template <size_t N>
+    Span(T (&array)[N]) : mData(array), mSize(N) {}
+
+    // Any contiguous container exposing data() and size(), e.g. std::vector.
+    template <typename Container,
+              typename = std::enable_if_t<!std::is_base_of_v<Span, std::decay_t<Container>> &&
+                  std::is_convertible_v<decltype(std::declval<Container&>().data()), T*>>>
+    Span(Container& container) : mData(container.data()), mSize(container.size()) {}
+
+    // Span<T> converts to Span<const T>.
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    Span(const Span<U>& rhs) : mData(rhs.Data()), mSize(rhs.Size()) {}
+
+    T*     Data() const { return mData; }
+    size_t Size() const { return mSize; }
+    size_t ByteSize() const { return mSize * sizeof(T); }
+    bool   Empty() const { return mSize == 0; }
+
+    T& operator[](size_t i) const
+    {
+        assert(i < mSize);
+        return mData[i];
+    }
+
+    T* begin() const { return mData; }
+    T* end() const { return mData + mSize; }
+
+    Span Subspan(size_t offset, size_t count) const
+    {
+        assert(offset + count <= mSize);
+        return Span(mData + offset, count);
+    }
+
+private:
+    T*     mData = nullptr;
+    size_t mSize = 0;
+};
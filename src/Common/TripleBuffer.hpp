@@ -0,0 +1,56 @@
+#pragma once
+
+#include <Common/defines.hpp>
+#include <atomic>
+
+// Single-producer / single-consumer triple buffer. The producer fills Back() and
+// publishes it; the consumer picks up the most recently published slot with
+// Update() and reads Front(). Neither side ever waits on the other: the spare
+// slot is handed back and forth with one atomic exchange, and a slot the
+// consumer never got to see is simply overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // Producer side.
+    T& Back() { return mSlots[mBack]; }
+
+    void Publish()
+    {
+        u8 previous = mMiddle.exchange((u8)(mBack | FreshBit), std::memory_order_acq_rel);
+        mBack = previous & IndexMask;
+    }
+
+    // Consumer side. Makes the latest published slot the front one; returns
+    // false (and keeps the current front) if nothing new was published.
+    bool Update()
+    {
+        if ((mMiddle.load(std::memory_order_relaxed) & FreshBit) == 0)
+        {
+            return false;
+        }
+
+        u8 previous = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+        mFront = previous & IndexMask;
+        return true;
+    }
+
+    T& Front() { return mSlots[mFront]; }
+    const T& Front() const { return mSlots[mFront]; }
+
+    // All three slots, for one-time setup before either side starts.
+    T& Slot(u32 i) { return mSlots[i]; }
+
+private:
+    static constexpr u8 IndexMask = 0x3;
+    static constexpr u8 FreshBit = 0x4;
+
+    T mSlots[3];
+    u8 mFront = 0;
+    u8 mBack = 1;
+    std::atomic<u8> mMiddle{ 2 };
+};
@@ -58,6 +58,15 @@ public:
         memcpy(&mMappedData[elementIndex * mElementByteSize], &data, sizeof(T));
     }
 
+    // Direct access to the persistently mapped memory so producers can write the
+    // whole buffer in place. Only meaningful for non-constant buffers, whose
+    // elements are tightly packed. The memory is write-combined: never read it.
+    T* MappedData() const
+    {
+        assert(!mIsConstantBuffer);
+        return reinterpret_cast<T*>(mMappedData);
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     u8* mMappedData = nullptr;
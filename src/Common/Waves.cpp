@@ -0,0 +1,1937 @@
+//***************************************************************************************
+// Waves.cpp by Frank Luna (C) 2011 All Rights Reserved.
+//***************************************************************************************
+
+#include <Common/Waves.hpp>
+#include <Common/WavesKernels.hpp>
+#include <Common/JobSystem.hpp>
+#include <Common/MappedFile.hpp>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+using namespace DirectX;
+
+namespace
+{
+	// Calls fn(first, last) for every maximal run [first, last) of consecutive
+	// tiles in [0, count) for which pred(tile) holds.
+	template <typename Pred, typename Fn>
+	void ForEachRun(int count, Pred pred, Fn fn)
+	{
+		for(int t = 0; t < count; )
+		{
+			if(!pred(t))
+			{
+				++t;
+				continue;
+			}
+
+			int first = t;
+			while(t < count && pred(t))
+				++t;
+			fn(first, t);
+		}
+	}
+}
+
+Waves::Waves(int m, int n, float dx, float dt, float speed, float damping, WavesStorage storage)
+    : Waves(m, n, dx, dt, speed, damping, storage, true)
+{
+}
+
+Waves::Waves(int m, int n, float dx, float dt, float speed, float damping, WavesStorage storage,
+             bool allocateSolution)
+{
+    mStorage = storage;
+
+    mNumRows = m;
+    mNumCols = n;
+
+    mVertexCount = m*n;
+    mTriangleCount = (m - 1)*(n - 1) * 2;
+
+    mTimeStep = dt;
+    mSpatialStep = dx;
+    mSpeed = speed;
+    mDamping = damping;
+
+    const StepCoefficients& k = CoefficientsFor(dt);
+    mK1 = k.K1;
+    mK2 = k.K2;
+    mK3 = k.K3;
+
+    // Past the CFL bound the heights blow up instead of failing loudly.
+    assert(IsStable());
+
+    // Generate grid vertices in system memory.
+
+    mHalfWidth = (n - 1)*dx*0.5f;
+    mHalfDepth = (m - 1)*dx*0.5f;
+
+    if(!IsCompact())
+    {
+        mNormals.resize(m*n);
+        mTangentX.resize(m*n);
+    }
+
+    if(mStorage == WavesStorage::Planar)
+    {
+        // The planes start out flat (all zero).
+        mRowPitch = PlaneRowPitch(mStorage, n);
+        if(allocateSolution)
+        {
+            mPrevHeights.Reset((size_t)m*mRowPitch, 64);
+            mCurrHeights.Reset((size_t)m*mRowPitch, 64);
+        }
+    }
+    else if(IsCompact())
+    {
+        // Zero is a flat height in both formats and encodes the up normal, so
+        // the planes start out at rest.
+        mRowPitch = PlaneRowPitch(mStorage, n);
+        if(allocateSolution)
+        {
+            mPrevPacked.Reset((size_t)m*mRowPitch, 64);
+            mCurrPacked.Reset((size_t)m*mRowPitch, 64);
+        }
+        mOctNormals.Reset((size_t)m*n, 64);
+        return;
+    }
+    else
+    {
+        mPrevSolution.resize(m*n);
+        mCurrSolution.resize(m*n);
+    }
+
+    for(int i = 0; i < m; ++i)
+    {
+        float z = mHalfDepth - i*dx;
+        for(int j = 0; j < n; ++j)
+        {
+            // A restored solution is copied in by LoadSnapshot and its interior
+            // normals derived by UpdateNormals; only the border keeps these.
+            if(!allocateSolution)
+            {
+                if(i > 0 && i < m - 1 && j == 1)
+                    j = n - 1;
+                mNormals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
+                mTangentX[i*n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
+                continue;
+            }
+
+            float x = -mHalfWidth + j*dx;
+
+            if(mStorage == WavesStorage::Interleaved)
+            {
+                mPrevSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
+                mCurrSolution[i*n + j] = XMFLOAT3(x, 0.0f, z);
+            }
+            mNormals[i*n + j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
+            mTangentX[i*n + j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
+        }
+    }
+}
+
+Waves::~Waves()
+{
+}
+
+int Waves::RowCount()const
+{
+	return mNumRows;
+}
+
+int Waves::ColumnCount()const
+{
+	return mNumCols;
+}
+
+int Waves::VertexCount()const
+{
+	return mVertexCount;
+}
+
+int Waves::TriangleCount()const
+{
+	return mTriangleCount;
+}
+
+float Waves::Width()const
+{
+	return mNumCols*mSpatialStep;
+}
+
+float Waves::Depth()const
+{
+	return mNumRows*mSpatialStep;
+}
+
+WavesStorage Waves::Storage()const
+{
+	return mStorage;
+}
+
+bool Waves::IsCompact()const
+{
+	return mStorage == WavesStorage::Half || mStorage == WavesStorage::Fixed16;
+}
+
+size_t Waves::StateBytes()const
+{
+	return (mPrevSolution.size() + mCurrSolution.size() + mNormals.size() + mTangentX.size())*sizeof(XMFLOAT3) +
+		mPrevHeights.ByteSize() + mCurrHeights.ByteSize() + mNextPrevHeights.ByteSize() + mNextCurrHeights.ByteSize() +
+		mPrevPacked.ByteSize() + mCurrPacked.ByteSize() + mOctNormals.ByteSize();
+}
+
+void Waves::SetStatePagePolicy(PagePolicy policy)
+{
+	mPagePolicy = policy;
+
+	// Copies rows of pitch elements from src to dst in the passes' partition.
+	auto copyRows = [this](auto* dst, const auto* src, int pitch)
+	{
+		JobSystem::Get().ParallelFor(0, mNumRows, RowGrain(), [=](int firstRow, int lastRow)
+		{
+			memcpy(dst + (size_t)firstRow*pitch, src + (size_t)firstRow*pitch,
+				(size_t)(lastRow - firstRow)*pitch*sizeof(*src));
+		});
+	};
+
+	auto movePlane = [&](auto& plane, int pitch)
+	{
+		if(plane.Empty())
+			return;
+		std::decay_t<decltype(plane)> moved;
+		moved.Reset(plane.Size(), 64, policy);
+		copyRows(moved.Data(), plane.Data(), pitch);
+		plane.Swap(moved);
+	};
+
+	auto moveVector = [&](PageVector<XMFLOAT3>& v)
+	{
+		if(v.empty())
+			return;
+		// resize() leaves the elements uninitialized (see PageAllocator), so
+		// the copy is the first write.
+		PageVector<XMFLOAT3> moved{ PageAllocator<XMFLOAT3>(policy) };
+		moved.resize(v.size());
+		copyRows(moved.data(), v.data(), mNumCols);
+		v = std::move(moved);
+	};
+
+	movePlane(mPrevHeights, mRowPitch);
+	movePlane(mCurrHeights, mRowPitch);
+	movePlane(mNextPrevHeights, mRowPitch);
+	movePlane(mNextCurrHeights, mRowPitch);
+	movePlane(mPrevPacked, mRowPitch);
+	movePlane(mCurrPacked, mRowPitch);
+	movePlane(mOctNormals, mNumCols);
+	moveVector(mPrevSolution);
+	moveVector(mCurrSolution);
+	moveVector(mNormals);
+	moveVector(mTangentX);
+
+	// Nothing points into a restored snapshot any more.
+	mSnapshotFile.reset();
+}
+
+PagePolicy Waves::StatePagePolicy()const
+{
+	return mPagePolicy;
+}
+
+PageStats Waves::StatePageStats()const
+{
+	PageStats stats;
+	stats.BasePageSize = BasePageSize();
+	stats.HugePageSize = HugePageSize();
+	auto add = [&stats](const void* data, size_t bytes)
+	{
+		if(bytes != 0)
+			stats.Add(QueryPageStats(data, bytes));
+	};
+	add(mPrevHeights.Data(), mPrevHeights.ByteSize());
+	add(mCurrHeights.Data(), mCurrHeights.ByteSize());
+	add(mNextPrevHeights.Data(), mNextPrevHeights.ByteSize());
+	add(mNextCurrHeights.Data(), mNextCurrHeights.ByteSize());
+	add(mPrevPacked.Data(), mPrevPacked.ByteSize());
+	add(mCurrPacked.Data(), mCurrPacked.ByteSize());
+	add(mOctNormals.Data(), mOctNormals.ByteSize());
+	add(mPrevSolution.data(), mPrevSolution.size()*sizeof(XMFLOAT3));
+	add(mCurrSolution.data(), mCurrSolution.size()*sizeof(XMFLOAT3));
+	add(mNormals.data(), mNormals.size()*sizeof(XMFLOAT3));
+	add(mTangentX.data(), mTangentX.size()*sizeof(XMFLOAT3));
+	return stats;
+}
+
+void Waves::SetFixedPointRange(float maxHeight)
+{
+	float step = std::max(maxHeight, 1e-6f) / 32767.0f;
+	if(mStorage == WavesStorage::Fixed16 && step != mFixedStep)
+	{
+		// Requantize both time levels row by row.
+		std::vector<float> row(mNumCols);
+		for(AlignedBuffer<u16>* plane : { &mPrevPacked, &mCurrPacked })
+		{
+			for(int i = 0; i < mNumRows; ++i)
+			{
+				i16* heights = reinterpret_cast<i16*>(plane->Data() + (size_t)i*mRowPitch);
+				WavesKernels::FixedToFloatRow(heights, mNumCols, mFixedStep, row.data());
+				WavesKernels::FloatToFixedRow(row.data(), mNumCols, step, heights);
+			}
+		}
+	}
+	mFixedStep = step;
+}
+
+float Waves::FixedPointRange()const
+{
+	return mFixedStep*32767.0f;
+}
+
+void Waves::DecodeHeights(const u16* src, int count, float* dst)const
+{
+	if(mStorage == WavesStorage::Half)
+		WavesKernels::HalfToFloatRow(src, count, dst);
+	else
+		WavesKernels::FixedToFloatRow(reinterpret_cast<const i16*>(src), count, mFixedStep, dst);
+}
+
+void Waves::EncodeHeights(const float* src, int count, u16* dst)const
+{
+	if(mStorage == WavesStorage::Half)
+		WavesKernels::FloatToHalfRow(src, count, dst);
+	else
+		WavesKernels::FloatToFixedRow(src, count, mFixedStep, reinterpret_cast<i16*>(dst));
+}
+
+float* Waves::DecodeNeighbourhood(const AlignedBuffer<u16>& plane, int i, int firstCol, int lastCol, int& scratchPitch)const
+{
+	// Four rows: the three decoded here plus one for the caller.
+	thread_local AlignedBuffer<float> scratch;
+
+	int count = lastCol - firstCol + 2;
+	scratchPitch = (count + 15) & ~15;
+	if(scratch.Size() < 4*(size_t)scratchPitch)
+		scratch.Reset(4*(size_t)scratchPitch, 64);
+
+	const u16* mid = plane.Data() + (size_t)i*mRowPitch + firstCol - 1;
+	DecodeHeights(mid - mRowPitch, count, scratch.Data());
+	DecodeHeights(mid, count, scratch.Data() + scratchPitch);
+	DecodeHeights(mid + mRowPitch, count, scratch.Data() + 2*scratchPitch);
+	return scratch.Data() + scratchPitch;
+}
+
+WavesPipeline Waves::Pipeline()const
+{
+	return mPipeline;
+}
+
+void Waves::SetPipeline(WavesPipeline pipeline)
+{
+	mPipeline = pipeline;
+}
+
+void Waves::SetTemporalBlocking(int tileSize, int stepsPerTile)
+{
+	if(mStorage != WavesStorage::Planar || stepsPerTile <= 1)
+	{
+		mTileSize = 0;
+		mTileSteps = 0;
+		mNextPrevHeights.Reset(0);
+		mNextCurrHeights.Reset(0);
+		return;
+	}
+
+	mTileSize = std::max(tileSize, 8);
+	mTileSteps = stepsPerTile;
+	if(mNextCurrHeights.Empty())
+	{
+		mNextPrevHeights.Reset(mPrevHeights.Size(), 64, mPagePolicy);
+		mNextCurrHeights.Reset(mCurrHeights.Size(), 64, mPagePolicy);
+	}
+}
+
+int Waves::TemporalTileSize()const
+{
+	return mTileSize;
+}
+
+int Waves::TemporalStepsPerTile()const
+{
+	return mTileSteps;
+}
+
+void Waves::SetQuiescence(int tileSize, float sleepEpsilon, float wakeThreshold)
+{
+	if(tileSize <= 0)
+	{
+		mSleepTileSize = 0;
+		mTileRows = 0;
+		mTileCols = 0;
+		mActiveTiles = 0;
+		mTileAwake.clear();
+		mNextAwake.clear();
+		mTileAmplitude.clear();
+		mRowAmplitude.clear();
+		mTileVersion.clear();
+		return;
+	}
+
+	mSleepTileSize = std::max(tileSize, 8);
+	mTileRows = (mNumRows + mSleepTileSize - 1) / mSleepTileSize;
+	mTileCols = (mNumCols + mSleepTileSize - 1) / mSleepTileSize;
+	mSleepEpsilon = std::max(sleepEpsilon, 0.0f);
+	mWakeThreshold = std::max(wakeThreshold, 0.0f);
+
+	// Start with every tile awake; the flat ones drop out after two steps.
+	int tileCount = mTileRows*mTileCols;
+	mTileAwake.assign(tileCount, 1);
+	mNextAwake.assign(tileCount, 1);
+	mTileAmplitude.assign(tileCount, mSleepEpsilon);
+	mRowAmplitude.assign((size_t)mNumRows*mTileCols, 0.0f);
+	mTileVersion.assign(tileCount, mVersion);
+	mActiveTiles = tileCount;
+}
+
+int Waves::QuiescenceTileSize()const
+{
+	return mSleepTileSize;
+}
+
+int Waves::TileCount()const
+{
+	return mTileRows*mTileCols;
+}
+
+int Waves::ActiveTileCount()const
+{
+	return mActiveTiles;
+}
+
+u64 Waves::Version()const
+{
+	return mVersion;
+}
+
+XMFLOAT3 Waves::Position(int i)const
+{
+    if(mStorage == WavesStorage::Interleaved)
+        return mCurrSolution[i];
+
+    // Planar storage only keeps heights; x and z follow from the grid indices.
+    int row = i / mNumCols;
+    int col = i - row*mNumCols;
+    return XMFLOAT3(-mHalfWidth + col*mSpatialStep,
+                    Height(row, col),
+                    mHalfDepth - row*mSpatialStep);
+}
+
+XMFLOAT3 Waves::InterpolatedPosition(int i, float alpha)const
+{
+    XMFLOAT3 p = Position(i);
+    size_t index = (size_t)(i / mNumCols)*mRowPitch + i % mNumCols;
+    float prev = 0.0f;
+    if(mStorage == WavesStorage::Planar)
+        prev = mPrevHeights[index];
+    else if(IsCompact())
+        DecodeHeights(&mPrevPacked[index], 1, &prev);
+    else
+        prev = mPrevSolution[i].y;
+    p.y = prev + alpha*(p.y - prev);
+    return p;
+}
+
+XMFLOAT3 Waves::Normal(int i)const
+{
+    if(IsCompact())
+        return WavesKernels::DecodeOct(mOctNormals[i]);
+    return mNormals[i];
+}
+
+XMFLOAT3 Waves::TangentX(int i)const
+{
+    if(!IsCompact())
+        return mTangentX[i];
+
+    // The x tangent (2dx, r-l, 0) is the normal (l-r, 2dx, b-t) rotated in the
+    // xy plane, up to scale.
+    XMFLOAT3 n = Normal(i);
+    float len = sqrtf(n.x*n.x + n.y*n.y);
+    if(len == 0.0f)
+        return XMFLOAT3(1.0f, 0.0f, 0.0f);
+    return XMFLOAT3(n.y / len, -n.x / len, 0.0f);
+}
+
+template <typename Fn>
+void Waves::ForEachSampleQuad(Span<const XMFLOAT2> xz, Fn fn)const
+{
+	const XMVECTOR halfWidth = XMVectorReplicate(mHalfWidth);
+	const XMVECTOR halfDepth = XMVectorReplicate(mHalfDepth);
+	const XMVECTOR invStep = XMVectorReplicate(1.0f / mSpatialStep);
+	const XMVECTOR lastCol = XMVectorReplicate((float)(mNumCols - 1));
+	const XMVECTOR lastRow = XMVectorReplicate((float)(mNumRows - 1));
+	const XMVECTOR lastCellCol = XMVectorReplicate((float)(mNumCols - 2));
+	const XMVECTOR lastCellRow = XMVectorReplicate((float)(mNumRows - 2));
+	const XMVECTOR zero = XMVectorZero();
+
+	// 1K points per job: each costs a few dozen loads, and small batches
+	// (the common case) stay on the calling thread.
+	JobSystem::Get().ParallelFor(0, (int)xz.Size(), 1024, [&](int first, int last)
+	{
+		XMFLOAT2 tail[4];
+		for(int k = first; k < last; k += 4)
+		{
+			int count = std::min(4, last - k);
+			const XMFLOAT2* p = &xz[k];
+			if(count < 4)
+			{
+				for(int t = 0; t < 4; ++t)
+					tail[t] = p[std::min(t, count - 1)];
+				p = tail;
+			}
+
+			// Fractional grid coordinates, clamped to the grid; the cell is
+			// clamped one further so the far edge lands on weight 1. Infinities
+			// clamp to an edge, but NaN would pass through min/max on some
+			// backends (NEON), so it is mapped to the first row/column first:
+			// the indices below must stay inside the grid.
+			XMVECTOR u = XMVectorMultiply(XMVectorAdd(XMVectorSet(p[0].x, p[1].x, p[2].x, p[3].x), halfWidth), invStep);
+			XMVECTOR v = XMVectorMultiply(XMVectorSubtract(halfDepth, XMVectorSet(p[0].y, p[1].y, p[2].y, p[3].y)), invStep);
+			u = XMVectorSelect(u, zero, XMVectorIsNaN(u));
+			v = XMVectorSelect(v, zero, XMVectorIsNaN(v));
+			u = XMVectorMin(XMVectorMax(u, zero), lastCol);
+			v = XMVectorMin(XMVectorMax(v, zero), lastRow);
+			XMVECTOR col = XMVectorMin(XMVectorFloor(u), lastCellCol);
+			XMVECTOR row = XMVectorMin(XMVectorFloor(v), lastCellRow);
+
+			XMFLOAT4A colf, rowf;
+			XMStoreFloat4A(&colf, col);
+			XMStoreFloat4A(&rowf, row);
+			const int cols[4] = { (int)colf.x, (int)colf.y, (int)colf.z, (int)colf.w };
+			const int rows[4] = { (int)rowf.x, (int)rowf.y, (int)rowf.z, (int)rowf.w };
+			fn(rows, cols, XMVectorSubtract(u, col), XMVectorSubtract(v, row), k, count);
+		}
+	});
+}
+
+void Waves::SampleHeights(Span<const XMFLOAT2> xz, Span<float> heights)const
+{
+	assert(heights.Size() >= xz.Size());
+
+	ForEachSampleQuad(xz, [&](const int* rows, const int* cols, XMVECTOR fx, XMVECTOR fz, int first, int count)
+	{
+		float corners[4][4];
+		for(int t = 0; t < 4; ++t)
+		{
+			corners[0][t] = Height(rows[t], cols[t]);
+			corners[1][t] = Height(rows[t], cols[t] + 1);
+			corners[2][t] = Height(rows[t] + 1, cols[t]);
+			corners[3][t] = Height(rows[t] + 1, cols[t] + 1);
+		}
+
+		XMVECTOR h00 = XMLoadFloat4((const XMFLOAT4*)corners[0]);
+		XMVECTOR h01 = XMLoadFloat4((const XMFLOAT4*)corners[1]);
+		XMVECTOR h10 = XMLoadFloat4((const XMFLOAT4*)corners[2]);
+		XMVECTOR h11 = XMLoadFloat4((const XMFLOAT4*)corners[3]);
+		XMVECTOR top = XMVectorMultiplyAdd(XMVectorSubtract(h01, h00), fx, h00);
+		XMVECTOR bottom = XMVectorMultiplyAdd(XMVectorSubtract(h11, h10), fx, h10);
+
+		XMFLOAT4 h;
+		XMStoreFloat4(&h, XMVectorMultiplyAdd(XMVectorSubtract(bottom, top), fz, top));
+		const float* values = &h.x;
+		for(int t = 0; t < count; ++t)
+			heights[first + t] = values[t];
+	});
+}
+
+void Waves::SampleNormals(Span<const XMFLOAT2> xz, Span<XMFLOAT3> normals)const
+{
+	assert(normals.Size() >= xz.Size());
+
+	ForEachSampleQuad(xz, [&](const int* rows, const int* cols, XMVECTOR fx, XMVECTOR fz, int first, int count)
+	{
+		// Corners transposed to one vector per component: [corner][axis][point].
+		float corners[4][3][4];
+		for(int t = 0; t < 4; ++t)
+		{
+			int i = rows[t]*mNumCols + cols[t];
+			const XMFLOAT3 n[4] = { Normal(i), Normal(i + 1), Normal(i + mNumCols), Normal(i + mNumCols + 1) };
+			for(int c = 0; c < 4; ++c)
+			{
+				corners[c][0][t] = n[c].x;
+				corners[c][1][t] = n[c].y;
+				corners[c][2][t] = n[c].z;
+			}
+		}
+
+		XMVECTOR axes[3];
+		for(int a = 0; a < 3; ++a)
+		{
+			XMVECTOR n00 = XMLoadFloat4((const XMFLOAT4*)corners[0][a]);
+			XMVECTOR n01 = XMLoadFloat4((const XMFLOAT4*)corners[1][a]);
+			XMVECTOR n10 = XMLoadFloat4((const XMFLOAT4*)corners[2][a]);
+			XMVECTOR n11 = XMLoadFloat4((const XMFLOAT4*)corners[3][a]);
+			XMVECTOR top = XMVectorMultiplyAdd(XMVectorSubtract(n01, n00), fx, n00);
+			XMVECTOR bottom = XMVectorMultiplyAdd(XMVectorSubtract(n11, n10), fx, n10);
+			axes[a] = XMVectorMultiplyAdd(XMVectorSubtract(bottom, top), fz, top);
+		}
+
+		XMVECTOR lengthSq = XMVectorMultiplyAdd(axes[0], axes[0],
+			XMVectorMultiplyAdd(axes[1], axes[1], XMVectorMultiply(axes[2], axes[2])));
+		XMVECTOR invLength = XMVectorReciprocalSqrt(lengthSq);
+
+		XMFLOAT4 x, y, z;
+		XMStoreFloat4(&x, XMVectorMultiply(axes[0], invLength));
+		XMStoreFloat4(&y, XMVectorMultiply(axes[1], invLength));
+		XMStoreFloat4(&z, XMVectorMultiply(axes[2], invLength));
+		const float* xs = &x.x;
+		const float* ys = &y.x;
+		const float* zs = &z.x;
+		for(int t = 0; t < count; ++t)
+			normals[first + t] = XMFLOAT3(xs[t], ys[t], zs[t]);
+	});
+}
+
+float Waves::Height(int i, int j)const
+{
+    size_t index = (size_t)i*mRowPitch + j;
+    if(mStorage == WavesStorage::Planar)
+        return mCurrHeights[index];
+    if(IsCompact())
+    {
+        float height;
+        DecodeHeights(&mCurrPacked[index], 1, &height);
+        return height;
+    }
+    return mCurrSolution[i*mNumCols + j].y;
+}
+
+void Waves::AddHeight(int i, int j, float delta)
+{
+    size_t index = (size_t)i*mRowPitch + j;
+    if(mStorage == WavesStorage::Planar)
+    {
+        mCurrHeights[index] += delta;
+    }
+    else if(IsCompact())
+    {
+        float height = Height(i, j) + delta;
+        EncodeHeights(&height, 1, &mCurrPacked[index]);
+    }
+    else
+    {
+        mCurrSolution[i*mNumCols + j].y += delta;
+    }
+}
+
+void Waves::Update(float dt)
+{
+	if(mAdaptiveTimeStep && dt > 0.0f)
+		SelectTimeStep(dt);
+
+	// Accumulate time.
+	mAccumulator += dt;
+
+	// Only update the simulation at the specified time step. Large frame times
+	// are covered with several substeps; the remainder carries over.
+	int steps = (int)(mAccumulator / mTimeStep);
+	if(steps == 0)
+		return;
+
+	mAccumulator = std::min(std::max(mAccumulator - steps*mTimeStep, 0.0f), mTimeStep);
+	if(steps > mMaxSubsteps)
+	{
+		mDroppedSteps += steps - mMaxSubsteps;
+		steps = mMaxSubsteps;
+	}
+
+	Step(steps);
+}
+
+void Waves::SetMaxSubsteps(int maxSubsteps)
+{
+	mMaxSubsteps = std::max(maxSubsteps, 1);
+}
+
+int Waves::MaxSubsteps()const
+{
+	return mMaxSubsteps;
+}
+
+u64 Waves::DroppedSteps()const
+{
+	return mDroppedSteps;
+}
+
+float Waves::MaxStableTimeStep(float dx, float speed)
+{
+	// With e = (speed*dt/dx)^2 the checkerboard mode, whose neighbours sum to
+	// -4 times its own height, sees z' = K1 z'' + (4 - 16e)/d z. Both roots of
+	// that recurrence stay inside the unit circle iff |4 - 16e| < 4 (Schur-Cohn
+	// with d = damping*dt + 2 and d + (2 - damping*dt) = 4), i.e. e < 1/2. All
+	// other modes are bounded by the same e.
+	if(speed <= 0.0f)
+		return std::numeric_limits<float>::infinity();
+	return dx / (speed*std::sqrt(2.0f));
+}
+
+float Waves::MaxStableTimeStep()const
+{
+	return MaxStableTimeStep(mSpatialStep, mSpeed);
+}
+
+bool Waves::IsStable()const
+{
+	return mTimeStep < MaxStableTimeStep();
+}
+
+float Waves::TimeStep()const
+{
+	return mTimeStep;
+}
+
+void Waves::SetAdaptiveTimeStep(bool enabled, float safety)
+{
+	mAdaptiveTimeStep = enabled;
+	mStabilitySafety = std::min(std::max(safety, 0.01f), 0.999f);
+}
+
+bool Waves::AdaptiveTimeStep()const
+{
+	return mAdaptiveTimeStep;
+}
+
+const Waves::StepCoefficients& Waves::CoefficientsFor(float dt)
+{
+	for(const StepCoefficients& k : mCoefficientCache)
+	{
+		if(k.TimeStep == dt)
+			return k;
+	}
+
+	// The sizes come from a short ladder, so the cache only fills up when the
+	// safety factor keeps changing; start over then.
+	if(mCoefficientCache.size() >= 32)
+		mCoefficientCache.clear();
+
+	StepCoefficients k;
+	k.TimeStep = dt;
+
+	float d = mDamping*dt + 2.0f;
+	float e = (mSpeed*mSpeed)*(dt*dt) / (mSpatialStep*mSpatialStep);
+	k.K1 = (mDamping*dt - 2.0f) / d;
+	k.K2 = (4.0f - 8.0f*e) / d;
+	k.K3 = (2.0f*e) / d;
+
+	mCoefficientCache.push_back(k);
+	return mCoefficientCache.back();
+}
+
+void Waves::SelectTimeStep(float frameTime)
+{
+	const float rungsPerOctave = 16.0f;
+	const float rung = std::exp2(1.0f / rungsPerOctave);
+
+	float limit = mStabilitySafety*MaxStableTimeStep();
+	if(!std::isfinite(limit))
+		return;
+
+	float substeps = std::ceil(frameTime / limit);
+	float target = frameTime / substeps;
+
+	// Keep the current size while it is stable and within a rung of the
+	// target, so jitter in the frame time does not keep switching sizes. Once
+	// a frame needs several steps any stable size above the target will do:
+	// the accumulator absorbs the fraction, and a frame time near a multiple
+	// of the limit does not flip between step counts.
+	float upper = substeps > 1.0f ? limit : std::min(target*rung, limit);
+	if(mTimeStep >= target / rung && mTimeStep <= upper)
+		return;
+
+	float rungs = std::max(std::round(rungsPerOctave*std::log2(limit / target)), 0.0f);
+	SetTimeStep(limit*std::exp2(-rungs / rungsPerOctave));
+}
+
+void Waves::SetTimeStep(float dt)
+{
+	if(dt == mTimeStep)
+		return;
+
+	// The previous solution stands for curr - dt*v; move it to the new dt.
+	const float ratio = dt / mTimeStep;
+	JobSystem::Get().ParallelFor(0, mNumRows, RowGrain(), [this, ratio](int firstRow, int lastRow)
+	{
+		std::vector<float> prev, curr;
+		for(int i = firstRow; i < lastRow; ++i)
+		{
+			if(mStorage == WavesStorage::Planar)
+			{
+				float* p = mPrevHeights.Data() + (size_t)i*mRowPitch;
+				const float* c = mCurrHeights.Data() + (size_t)i*mRowPitch;
+				for(int j = 0; j < mNumCols; ++j)
+					p[j] = c[j] + (p[j] - c[j])*ratio;
+			}
+			else if(IsCompact())
+			{
+				prev.resize(mNumCols);
+				curr.resize(mNumCols);
+				u16* p = mPrevPacked.Data() + (size_t)i*mRowPitch;
+				DecodeHeights(p, mNumCols, prev.data());
+				DecodeHeights(mCurrPacked.Data() + (size_t)i*mRowPitch, mNumCols, curr.data());
+				for(int j = 0; j < mNumCols; ++j)
+					prev[j] = curr[j] + (prev[j] - curr[j])*ratio;
+				EncodeHeights(prev.data(), mNumCols, p);
+			}
+			else
+			{
+				for(int j = i*mNumCols; j < (i + 1)*mNumCols; ++j)
+					mPrevSolution[j].y = mCurrSolution[j].y + (mPrevSolution[j].y - mCurrSolution[j].y)*ratio;
+			}
+		}
+	});
+
+	const StepCoefficients& k = CoefficientsFor(dt);
+	mTimeStep = dt;
+	mK1 = k.K1;
+	mK2 = k.K2;
+	mK3 = k.K3;
+}
+
+float Waves::InterpolationAlpha()const
+{
+	return mAccumulator / mTimeStep;
+}
+
+void Waves::Step(int count)
+{
+	++mVersion;
+
+	bool normalsDone = false;
+	while(count > 0)
+	{
+		ApplyDueImpulses();
+
+		// A temporal block must not run past the step the next impulse is due on.
+		int k = (mTileSteps > 1 && mSleepTileSize == 0) ? std::min(count, mTileSteps) : 1;
+		k = (int)std::min<u64>((u64)k, std::max<u64>(1, StepsUntilNextImpulse()));
+		count -= k;
+		mStepCount += k;
+
+		if(k > 1)
+		{
+			StepTemporalBlocked(k);
+			continue;
+		}
+
+		if(count == 0 && mPipeline == WavesPipeline::Fused)
+		{
+			StepFused();
+			normalsDone = true;
+		}
+		else
+		{
+			// Only update interior points; we use zero boundary conditions.
+			JobSystem::Get().ParallelFor(1, mNumRows - 1, RowGrain(), [this](int firstRow, int lastRow)
+			{
+				StepRows(firstRow, lastRow);
+			});
+		}
+
+		// We just overwrote the previous buffer with the new data, so
+		// this data needs to become the current solution and the old
+		// current solution becomes the new previous solution.
+		SwapSolutions();
+
+		if(mSleepTileSize > 0)
+			UpdateActivity();
+	}
+
+	//
+	// Compute normals using finite difference scheme.
+	//
+	if(!normalsDone)
+		UpdateNormals();
+
+	// Tiles that went to sleep were stamped when they were flattened.
+	for(int tile = 0; tile < TileCount(); ++tile)
+	{
+		if(mTileAwake[tile])
+			mTileVersion[tile] = mVersion;
+	}
+}
+
+void Waves::UpdateNormals()
+{
+	JobSystem::Get().ParallelFor(1, mNumRows - 1, RowGrain(), [this](int firstRow, int lastRow)
+	{
+		ComputeNormalRows(firstRow, lastRow);
+	});
+}
+
+void Waves::SwapSolutions()
+{
+	if(mStorage == WavesStorage::Planar)
+		mPrevHeights.Swap(mCurrHeights);
+	else if(IsCompact())
+		mPrevPacked.Swap(mCurrPacked);
+	else
+		std::swap(mPrevSolution, mCurrSolution);
+}
+
+void Waves::StepTemporalBlocked(int stepCount)
+{
+	const int K = stepCount;
+	const int T = mTileSize;
+	const int tileRows = (mNumRows + T - 1) / T;
+	const int tileCols = (mNumCols + T - 1) / T;
+
+	JobSystem::Get().ParallelFor(0, tileRows*tileCols, 1, [this, K, T, tileCols](int firstTile, int lastTile)
+	{
+		// Per-thread scratch holding one tile plus its halo for both time levels.
+		thread_local AlignedBuffer<float> scratch;
+
+		for(int tile = firstTile; tile < lastTile; ++tile)
+		{
+			// Core of the tile and the halo-extended region it is computed from.
+			int r0 = (tile / tileCols)*T;
+			int c0 = (tile % tileCols)*T;
+			int r1 = std::min(r0 + T, mNumRows);
+			int c1 = std::min(c0 + T, mNumCols);
+
+			int rowOrigin = std::max(0, r0 - K);
+			int colOrigin = std::max(0, c0 - K);
+			int rows = std::min(mNumRows, r1 + K) - rowOrigin;
+			int cols = std::min(mNumCols, c1 + K) - colOrigin;
+			int pitch = (cols + 15) & ~15;
+
+			size_t planeSize = (size_t)rows*pitch;
+			if(scratch.Size() < 2*planeSize)
+				scratch.Reset(2*planeSize, 64);
+
+			float* P = scratch.Data();
+			float* C = scratch.Data() + planeSize;
+			for(int r = 0; r < rows; ++r)
+			{
+				size_t src = (size_t)(rowOrigin + r)*mRowPitch + colOrigin;
+				memcpy(P + (size_t)r*pitch, mPrevHeights.Data() + src, cols*sizeof(float));
+				memcpy(C + (size_t)r*pitch, mCurrHeights.Data() + src, cols*sizeof(float));
+			}
+
+			// Step s is valid on the core grown by K-s cells; everything further
+			// out only feeds cells we never read back. Global boundary cells keep
+			// their (fixed) values.
+			for(int s = 1; s <= K; ++s)
+			{
+				int ra = std::max(1, r0 - K + s);
+				int rb = std::min(mNumRows - 1, r1 + K - s);
+				int ca = std::max(1, c0 - K + s);
+				int cb = std::min(mNumCols - 1, c1 + K - s);
+
+				for(int gr = ra; gr < rb && ca < cb; ++gr)
+				{
+					// Offset so that the kernel's column 1 lands on global column ca.
+					size_t row = (size_t)(gr - rowOrigin)*pitch + (ca - colOrigin - 1);
+					WavesKernels::StencilRow(P + row, C + row, C + row - pitch, C + row + pitch,
+						cb - ca + 2, mK1, mK2, mK3);
+				}
+
+				std::swap(P, C);
+			}
+
+			for(int r = r0; r < r1; ++r)
+			{
+				size_t dst = (size_t)r*mRowPitch + c0;
+				size_t src = (size_t)(r - rowOrigin)*pitch + (c0 - colOrigin);
+				memcpy(mNextPrevHeights.Data() + dst, P + src, (c1 - c0)*sizeof(float));
+				memcpy(mNextCurrHeights.Data() + dst, C + src, (c1 - c0)*sizeof(float));
+			}
+		}
+	});
+
+	mPrevHeights.Swap(mNextPrevHeights);
+	mCurrHeights.Swap(mNextCurrHeights);
+}
+
+void Waves::StepFused()
+{
+	// Larger blocks than the two-pass grain: each block leaves its first and last
+	// row for the fix-up below, so the blocks should be tall relative to that.
+	int interiorRows = mNumRows - 2;
+	int blocks = 4 * (int)JobSystem::Get().ThreadCount();
+	int grain = std::max(RowGrain(), (interiorRows + blocks - 1) / blocks);
+	grain = std::max(grain, 4);
+
+	JobSystem::Get().ParallelFor(1, mNumRows - 1, grain, [this](int firstRow, int lastRow)
+	{
+		// Normals of row r need the new heights of rows r-1..r+1. Inside the block
+		// that holds for every row except the ones bordering another block; the
+		// boundary rows 0 and m-1 never change, so they count as available.
+		int lo = (firstRow == 1) ? 1 : firstRow + 1;
+		int hi = (lastRow == mNumRows - 1) ? lastRow : lastRow - 1;
+
+		for(int i = firstRow; i < lastRow; ++i)
+		{
+			StepRows(i, i + 1);
+
+			int r = i - 1;
+			if(r >= lo && r < hi)
+				ComputeNormalRows(r, r + 1, true);
+		}
+
+		// The last row of the block when its lower neighbour is the boundary.
+		if(lastRow - 1 >= lo && lastRow - 1 < hi)
+			ComputeNormalRows(lastRow - 1, lastRow, true);
+	});
+
+	// Rows on block seams depend on heights produced by the neighbouring block.
+	std::vector<int> seams;
+	for(int first = 1; first < mNumRows - 1; first += grain)
+	{
+		int last = std::min(first + grain, mNumRows - 1);
+		if(first != 1)
+			seams.push_back(first);
+		if(last != mNumRows - 1 && last - 1 != first)
+			seams.push_back(last - 1);
+	}
+
+	JobSystem::Get().ParallelFor(0, (int)seams.size(), 16, [this, &seams](int first, int last)
+	{
+		for(int k = first; k < last; ++k)
+			ComputeNormalRows(seams[k], seams[k] + 1, true);
+	});
+}
+
+int Waves::RowGrain()const
+{
+	// Hand out blocks of roughly 16K cells per job: enough work to amortize
+	// scheduling, while large grids still split across many cores.
+	return std::max(1, (16 * 1024) / mNumCols);
+}
+
+void Waves::StepRows(int firstRow, int lastRow)
+{
+	for(int i = firstRow; i < lastRow; ++i)
+	{
+		if(mSleepTileSize == 0)
+		{
+			StepRowSpan(i, 1, mNumCols - 1);
+			continue;
+		}
+
+		// Only the awake tiles of this row, recording how much energy each has left.
+		const int T = mSleepTileSize;
+		const u8* awake = &mTileAwake[(i / T)*mTileCols];
+		ForEachRun(mTileCols, [awake](int tc) { return awake[tc] != 0; }, [this, i, T](int first, int last)
+		{
+			StepRowSpan(i, std::max(1, first*T), std::min(mNumCols - 1, last*T));
+			for(int tc = first; tc < last; ++tc)
+			{
+				mRowAmplitude[(size_t)i*mTileCols + tc] =
+					NextRowAmplitude(i, std::max(1, tc*T), std::min(mNumCols - 1, (tc + 1)*T));
+			}
+		});
+	}
+}
+
+void Waves::StepRowSpan(int i, int firstCol, int lastCol)
+{
+	if(firstCol >= lastCol)
+		return;
+
+	if(mStorage == WavesStorage::Planar)
+	{
+		// Offset the rows so that the kernel's column 1 lands on firstCol.
+		size_t offset = (size_t)i*mRowPitch + firstCol - 1;
+		float* prev = mPrevHeights.Data() + offset;
+		const float* curr = mCurrHeights.Data() + offset;
+		WavesKernels::StencilRow(prev, curr, curr - mRowPitch, curr + mRowPitch,
+			lastCol - firstCol + 2, mK1, mK2, mK3);
+		return;
+	}
+
+	if(IsCompact())
+	{
+		// Widen the neighbourhood to f32, step it, and round the result back.
+		int pitch = 0;
+		float* curr = DecodeNeighbourhood(mCurrPacked, i, firstCol, lastCol, pitch);
+		float* prev = curr + 2*pitch;
+		u16* packed = mPrevPacked.Data() + (size_t)i*mRowPitch + firstCol;
+
+		DecodeHeights(packed, lastCol - firstCol, prev + 1);
+		WavesKernels::StencilRow(prev, curr, curr - pitch, curr + pitch,
+			lastCol - firstCol + 2, mK1, mK2, mK3);
+		EncodeHeights(prev + 1, lastCol - firstCol, packed);
+		return;
+	}
+
+	for(int j = firstCol; j < lastCol; ++j)
+	{
+		// After this update we will be discarding the old previous
+		// buffer, so overwrite that buffer with the new update.
+		// Note how we can do this inplace (read/write to same element) 
+		// because we won't need prev_ij again and the assignment happens last.
+
+		// Note j indexes x and i indexes z: h(x_j, z_i, t_k)
+		// Moreover, our +z axis goes "down"; this is just to 
+		// keep consistent with our row indices going down.
+
+		mPrevSolution[i*mNumCols+j].y = 
+			mK1*mPrevSolution[i*mNumCols+j].y +
+			mK2*mCurrSolution[i*mNumCols+j].y +
+			mK3*(mCurrSolution[(i+1)*mNumCols+j].y + 
+			     mCurrSolution[(i-1)*mNumCols+j].y + 
+			     mCurrSolution[i*mNumCols+j+1].y + 
+				 mCurrSolution[i*mNumCols+j-1].y);
+	}
+}
+
+float Waves::NextRowAmplitude(int i, int firstCol, int lastCol)const
+{
+	if(firstCol >= lastCol)
+		return 0.0f;
+
+	if(mStorage == WavesStorage::Planar)
+		return WavesKernels::MaxAbsRow(mPrevHeights.Data() + (size_t)i*mRowPitch + firstCol, lastCol - firstCol);
+
+	if(IsCompact())
+	{
+		// Both formats order magnitudes like their integer magnitudes, so find the
+		// largest one and decode only that.
+		const u16* row = mPrevPacked.Data() + (size_t)i*mRowPitch;
+		u16 largest = 0;
+		if(mStorage == WavesStorage::Half)
+		{
+			for(int j = firstCol; j < lastCol; ++j)
+				largest = std::max<u16>(largest, row[j] & 0x7fff);
+		}
+		else
+		{
+			const i16* fixed = reinterpret_cast<const i16*>(row);
+			for(int j = firstCol; j < lastCol; ++j)
+				largest = std::max<u16>(largest, (u16)std::abs(fixed[j]));
+		}
+
+		float amplitude = 0.0f;
+		DecodeHeights(&largest, 1, &amplitude);
+		return amplitude;
+	}
+
+	float amplitude = 0.0f;
+	for(int j = firstCol; j < lastCol; ++j)
+		amplitude = std::max(amplitude, fabsf(mPrevSolution[i*mNumCols+j].y));
+	return amplitude;
+}
+
+void Waves::ComputeNormalRows(int firstRow, int lastRow, bool fromNext)
+{
+	for(int i = firstRow; i < lastRow; ++i)
+	{
+		if(mSleepTileSize == 0)
+		{
+			NormalRowSpan(i, 1, mNumCols - 1, fromNext);
+			continue;
+		}
+
+		const int T = mSleepTileSize;
+		const u8* awake = &mTileAwake[(i / T)*mTileCols];
+		ForEachRun(mTileCols, [awake](int tc) { return awake[tc] != 0; }, [this, i, T, fromNext](int first, int last)
+		{
+			NormalRowSpan(i, std::max(1, first*T), std::min(mNumCols - 1, last*T), fromNext);
+		});
+	}
+}
+
+void Waves::NormalRowSpan(int i, int firstCol, int lastCol, bool fromNext)
+{
+	if(firstCol >= lastCol)
+		return;
+
+	if(mStorage == WavesStorage::Planar)
+	{
+		const AlignedBuffer<float>& heights = fromNext ? mPrevHeights : mCurrHeights;
+		const float* mid = heights.Data() + (size_t)i*mRowPitch + firstCol - 1;
+		WavesKernels::NormalRow(mid - mRowPitch, mid, mid + mRowPitch, lastCol - firstCol + 2, mSpatialStep,
+			&mNormals[i*mNumCols + firstCol - 1], &mTangentX[i*mNumCols + firstCol - 1]);
+		return;
+	}
+
+	if(IsCompact())
+	{
+		int pitch = 0;
+		const float* mid = DecodeNeighbourhood(fromNext ? mPrevPacked : mCurrPacked, i, firstCol, lastCol, pitch);
+		WavesKernels::NormalRowOct(mid - pitch, mid, mid + pitch, lastCol - firstCol + 2, mSpatialStep,
+			&mOctNormals[(size_t)i*mNumCols + firstCol - 1]);
+		return;
+	}
+
+	const PageVector<XMFLOAT3>& solution = fromNext ? mPrevSolution : mCurrSolution;
+	for(int j = firstCol; j < lastCol; ++j)
+	{
+		float l = solution[i*mNumCols+j-1].y;
+		float r = solution[i*mNumCols+j+1].y;
+		float t = solution[(i-1)*mNumCols+j].y;
+		float b = solution[(i+1)*mNumCols+j].y;
+		mNormals[i*mNumCols+j].x = -r+l;
+		mNormals[i*mNumCols+j].y = 2.0f*mSpatialStep;
+		mNormals[i*mNumCols+j].z = b-t;
+
+		XMVECTOR n = XMVector3Normalize(XMLoadFloat3(&mNormals[i*mNumCols+j]));
+		XMStoreFloat3(&mNormals[i*mNumCols+j], n);
+
+		mTangentX[i*mNumCols+j] = XMFLOAT3(2.0f*mSpatialStep, r-l, 0.0f);
+		XMVECTOR T = XMVector3Normalize(XMLoadFloat3(&mTangentX[i*mNumCols+j]));
+		XMStoreFloat3(&mTangentX[i*mNumCols+j], T);
+	}
+}
+
+void Waves::UpdateActivity()
+{
+	const int T = mSleepTileSize;
+	mNextAwake = mTileAwake;
+
+	for(int tr = 0; tr < mTileRows; ++tr)
+	{
+		for(int tc = 0; tc < mTileCols; ++tc)
+		{
+			int tile = tr*mTileCols + tc;
+			if(!mTileAwake[tile])
+				continue;
+
+			// Interior part of the tile; the boundary never moves.
+			int r0 = std::max(1, tr*T);
+			int r1 = std::min(mNumRows - 1, (tr + 1)*T);
+			int c0 = std::max(1, tc*T);
+			int c1 = std::min(mNumCols - 1, (tc + 1)*T);
+
+			float amplitude = 0.0f;
+			for(int i = r0; i < r1; ++i)
+				amplitude = std::max(amplitude, mRowAmplitude[(size_t)i*mTileCols + tc]);
+
+			bool quiet = amplitude < mSleepEpsilon && mTileAmplitude[tile] < mSleepEpsilon;
+			mTileAmplitude[tile] = amplitude;
+			if(quiet)
+			{
+				mNextAwake[tile] = 0;
+				continue;
+			}
+
+			// No edge can exceed the tile maximum.
+			if(amplitude <= mWakeThreshold)
+				continue;
+
+			// The stencil moves energy one cell per step, so a neighbour only needs
+			// to wake once the cells along the shared edge carry some.
+			if(tr > 0 && mRowAmplitude[(size_t)r0*mTileCols + tc] > mWakeThreshold)
+				mNextAwake[tile - mTileCols] = 1;
+			if(tr + 1 < mTileRows && mRowAmplitude[(size_t)(r1 - 1)*mTileCols + tc] > mWakeThreshold)
+				mNextAwake[tile + mTileCols] = 1;
+
+			float left = 0.0f;
+			float right = 0.0f;
+			for(int i = r0; i < r1; ++i)
+			{
+				left = std::max(left, fabsf(Height(i, c0)));
+				right = std::max(right, fabsf(Height(i, c1 - 1)));
+			}
+			if(tc > 0 && left > mWakeThreshold)
+				mNextAwake[tile - 1] = 1;
+			if(tc + 1 < mTileCols && right > mWakeThreshold)
+				mNextAwake[tile + 1] = 1;
+		}
+	}
+
+	mActiveTiles = 0;
+	for(int tile = 0; tile < TileCount(); ++tile)
+	{
+		if(mTileAwake[tile] && !mNextAwake[tile])
+			FlattenTile(tile);
+		else if(!mTileAwake[tile] && mNextAwake[tile])
+			mTileAmplitude[tile] = mSleepEpsilon; // Not quiet until it has stepped twice.
+
+		mTileAwake[tile] = mNextAwake[tile];
+		mActiveTiles += mTileAwake[tile];
+	}
+}
+
+void Waves::WakeTiles(int r0, int r1, int c0, int c1)
+{
+	r0 = std::max(0, r0);
+	r1 = std::min(mNumRows, r1);
+	c0 = std::max(0, c0);
+	c1 = std::min(mNumCols, c1);
+	if(r0 >= r1 || c0 >= c1)
+		return;
+
+	const int T = mSleepTileSize;
+	int tr0 = r0 / T;
+	int tr1 = (r1 - 1) / T;
+	int tc0 = c0 / T;
+	int tc1 = (c1 - 1) / T;
+
+	for(int tr = tr0; tr <= tr1; ++tr)
+	{
+		for(int tc = tc0; tc <= tc1; ++tc)
+		{
+			// The amplitude measured last step predates the new energy, so the
+			// tile must not be considered quiet on its next step either.
+			int tile = tr*mTileCols + tc;
+			mTileVersion[tile] = mVersion;
+			mTileAmplitude[tile] = std::max(mTileAmplitude[tile], mSleepEpsilon);
+			if(mTileAwake[tile])
+				continue;
+
+			mTileAwake[tile] = 1;
+			++mActiveTiles;
+		}
+	}
+}
+
+void Waves::FlattenTile(int tile)
+{
+	// A sleeping tile is exactly flat in both time levels, so skipping it is the
+	// same as stepping it.
+	const int T = mSleepTileSize;
+	int r0 = (tile / mTileCols)*T;
+	int c0 = (tile % mTileCols)*T;
+	int r1 = std::min(mNumRows, r0 + T);
+	int c1 = std::min(mNumCols, c0 + T);
+
+	for(int i = r0; i < r1; ++i)
+	{
+		if(mStorage == WavesStorage::Planar)
+		{
+			size_t row = (size_t)i*mRowPitch + c0;
+			memset(mPrevHeights.Data() + row, 0, (c1 - c0)*sizeof(float));
+			memset(mCurrHeights.Data() + row, 0, (c1 - c0)*sizeof(float));
+		}
+		else if(IsCompact())
+		{
+			// All-zero words are a flat height and the up normal.
+			size_t row = (size_t)i*mRowPitch + c0;
+			memset(mPrevPacked.Data() + row, 0, (c1 - c0)*sizeof(u16));
+			memset(mCurrPacked.Data() + row, 0, (c1 - c0)*sizeof(u16));
+			memset(mOctNormals.Data() + (size_t)i*mNumCols + c0, 0, (c1 - c0)*sizeof(u16));
+			continue;
+		}
+		else
+		{
+			for(int j = c0; j < c1; ++j)
+			{
+				mPrevSolution[i*mNumCols+j].y = 0.0f;
+				mCurrSolution[i*mNumCols+j].y = 0.0f;
+			}
+		}
+
+		for(int j = c0; j < c1; ++j)
+		{
+			mNormals[i*mNumCols+j] = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			mTangentX[i*mNumCols+j] = XMFLOAT3(1.0f, 0.0f, 0.0f);
+		}
+	}
+
+	mTileVersion[tile] = mVersion;
+}
+
+template <typename Fn>
+void Waves::ForEachStaleSpan(u64* dstVersion, float alpha, WavesWriteStats* stats, u32 bytesPerPoint, Fn writeSpan)const
+{
+	if(stats)
+	{
+		stats->BytesWritten = 0;
+		stats->DirtyRows.clear();
+	}
+
+	// The top bit of *dstVersion marks a destination holding interpolated heights;
+	// its awake tiles have to be rewritten whatever the version says.
+	const u64 InterpolatedBit = 1ull << 63;
+	const bool interpolate = alpha < 1.0f;
+
+	u64 since = 0;
+	bool awakeStale = interpolate;
+	if(dstVersion)
+	{
+		since = *dstVersion & ~InterpolatedBit;
+		awakeStale = awakeStale || (*dstVersion & InterpolatedBit) != 0;
+		*dstVersion = mVersion | (interpolate ? InterpolatedBit : 0);
+	}
+
+	if(since >= mVersion && !awakeStale)
+		return;
+
+	// Rows are disjoint between jobs, so the flags need no synchronization.
+	std::vector<u8> rowWritten(stats ? mNumRows : 0);
+	std::atomic<u64> bytesWritten{ 0 };
+
+	JobSystem::Get().ParallelFor(0, mNumRows, RowGrain(), [&](int firstRow, int lastRow)
+	{
+		u64 points = 0;
+		auto write = [&](int i, int firstCol, int lastCol)
+		{
+			writeSpan(i, firstCol, lastCol);
+			points += lastCol - firstCol;
+			if(stats)
+				rowWritten[i] = 1;
+		};
+
+		for(int i = firstRow; i < lastRow; ++i)
+		{
+			if(mSleepTileSize == 0)
+			{
+				write(i, 0, mNumCols);
+				continue;
+			}
+
+			// Skip the tiles dst already holds. Sleeping tiles are flat in both
+			// time levels, so interpolation does not change them.
+			const int T = mSleepTileSize;
+			const u64* versions = &mTileVersion[(i / T)*mTileCols];
+			const u8* awake = &mTileAwake[(i / T)*mTileCols];
+			auto stale = [versions, awake, since, awakeStale](int tc)
+			{
+				return versions[tc] > since || (awakeStale && awake[tc]);
+			};
+			ForEachRun(mTileCols, stale, [&](int first, int last)
+			{
+				write(i, first*T, std::min(mNumCols, last*T));
+			});
+		}
+
+		// Each worker flushes its own write-combining buffers.
+		WavesKernels::StreamFence();
+		bytesWritten += points*bytesPerPoint;
+	});
+
+	if(!stats)
+		return;
+
+	stats->BytesWritten = bytesWritten;
+	ForEachRun(mNumRows, [&rowWritten](int i) { return rowWritten[i] != 0; }, [stats](int first, int last)
+	{
+		WavesRowRange range;
+		range.First = first;
+		range.Last = last;
+		stats->DirtyRows.push_back(range);
+	});
+}
+
+const float* Waves::RowHeights(int i, int firstCol, int lastCol, float alpha, std::vector<float>& scratch)const
+{
+	const bool interpolate = alpha < 1.0f;
+	if(mStorage == WavesStorage::Planar && !interpolate)
+		return mCurrHeights.Data() + (size_t)i*mRowPitch;
+
+	scratch.resize(2*(size_t)mNumCols);
+	float* heights = scratch.data();
+	float* prevHeights = scratch.data() + mNumCols;
+	int count = lastCol - firstCol;
+
+	if(mStorage == WavesStorage::Planar)
+	{
+		memcpy(heights + firstCol, mCurrHeights.Data() + (size_t)i*mRowPitch + firstCol, count*sizeof(float));
+		memcpy(prevHeights + firstCol, mPrevHeights.Data() + (size_t)i*mRowPitch + firstCol, count*sizeof(float));
+	}
+	else if(IsCompact())
+	{
+		size_t row = (size_t)i*mRowPitch + firstCol;
+		DecodeHeights(mCurrPacked.Data() + row, count, heights + firstCol);
+		if(interpolate)
+			DecodeHeights(mPrevPacked.Data() + row, count, prevHeights + firstCol);
+	}
+	else
+	{
+		for(int j = firstCol; j < lastCol; ++j)
+			heights[j] = mCurrSolution[i*mNumCols + j].y;
+		for(int j = firstCol; interpolate && j < lastCol; ++j)
+			prevHeights[j] = mPrevSolution[i*mNumCols + j].y;
+	}
+
+	if(interpolate)
+	{
+		for(int j = firstCol; j < lastCol; ++j)
+			heights[j] = prevHeights[j] + alpha*(heights[j] - prevHeights[j]);
+	}
+	return heights;
+}
+
+void Waves::WriteVertices(Span<WavesVertex> dst, u64* dstVersion, float alpha, WavesWriteStats* stats)const
+{
+	assert(dst.Size() >= (size_t)mVertexCount);
+
+	static_assert(sizeof(WavesVertex) == 8*sizeof(float), "WriteVertexRow emits 8 floats per vertex.");
+	float* out = reinterpret_cast<float*>(dst.Data());
+
+	ForEachStaleSpan(dstVersion, alpha, stats, sizeof(WavesVertex), [this, out, alpha](int i, int firstCol, int lastCol)
+	{
+		// Widened rows of the compact modes and interleaved storage.
+		thread_local std::vector<float> heights;
+		thread_local std::vector<XMFLOAT3> normals;
+
+		const XMFLOAT3* rowNormals = nullptr;
+		if(IsCompact())
+		{
+			normals.resize(mNumCols);
+			WavesKernels::DecodeOctRow(mOctNormals.Data() + (size_t)i*mNumCols + firstCol, lastCol - firstCol,
+				normals.data() + firstCol);
+			rowNormals = normals.data();
+		}
+		else
+		{
+			rowNormals = &mNormals[i*mNumCols];
+		}
+
+		WavesKernels::WriteVertexRow(RowHeights(i, firstCol, lastCol, alpha, heights), 1, rowNormals,
+			firstCol, lastCol, -mHalfWidth, mSpatialStep, mHalfDepth - i*mSpatialStep, Width(), Depth(),
+			out + (size_t)i*mNumCols*8);
+	});
+}
+
+bool Waves::SaveSnapshot(const char* path)const
+{
+	WavesSnapshotHeader header;
+	header.HeaderBytes = sizeof(WavesSnapshotHeader);
+	header.Storage = (u32)mStorage;
+	header.Rows = mNumRows;
+	header.Cols = mNumCols;
+	header.SpatialStep = mSpatialStep;
+	header.TimeStep = mTimeStep;
+	header.Speed = mSpeed;
+	header.Damping = mDamping;
+	header.K1 = mK1;
+	header.K2 = mK2;
+	header.K3 = mK3;
+	header.Accumulator = mAccumulator;
+	header.FixedStep = mFixedStep;
+	header.MaxSubsteps = mMaxSubsteps;
+	header.StepCount = mStepCount;
+	header.SolutionVersion = mVersion;
+	header.DroppedSteps = mDroppedSteps;
+
+	const void* prev = nullptr;
+	const void* curr = nullptr;
+	if(mStorage == WavesStorage::Planar)
+	{
+		header.RowPitch = mRowPitch;
+		header.ElementBytes = sizeof(float);
+		prev = mPrevHeights.Data();
+		curr = mCurrHeights.Data();
+	}
+	else if(IsCompact())
+	{
+		header.RowPitch = mRowPitch;
+		header.ElementBytes = sizeof(u16);
+		prev = mPrevPacked.Data();
+		curr = mCurrPacked.Data();
+	}
+	else
+	{
+		header.RowPitch = mNumCols;
+		header.ElementBytes = sizeof(XMFLOAT3);
+		prev = mPrevSolution.data();
+		curr = mCurrSolution.data();
+	}
+
+	const u64 alignment = WavesSnapshotHeader::Alignment;
+	auto alignUp = [alignment](u64 offset) { return (offset + alignment - 1) & ~(alignment - 1); };
+	header.PlaneBytes = (u64)mNumRows*header.RowPitch*header.ElementBytes;
+	header.PrevOffset = alignUp(sizeof(WavesSnapshotHeader));
+	header.CurrOffset = alignUp(header.PrevOffset + header.PlaneBytes);
+
+	FILE* file = fopen(path, "wb");
+	if(file == nullptr)
+		return false;
+
+	// Writes bytes at offset, zero-filling the gap after the previous write.
+	static const u8 zeros[WavesSnapshotHeader::Alignment] = {};
+	u64 position = 0;
+	auto put = [file, &position](u64 offset, const void* data, u64 bytes)
+	{
+		while(position < offset)
+		{
+			size_t pad = (size_t)std::min<u64>(offset - position, sizeof(zeros));
+			if(fwrite(zeros, 1, pad, file) != pad)
+				return false;
+			position += pad;
+		}
+		position += bytes;
+		return fwrite(data, 1, (size_t)bytes, file) == bytes;
+	};
+
+	bool written = put(0, &header, sizeof(header)) &&
+		put(header.PrevOffset, prev, header.PlaneBytes) &&
+		put(header.CurrOffset, curr, header.PlaneBytes);
+	return fclose(file) == 0 && written;
+}
+
+int Waves::PlaneRowPitch(WavesStorage storage, int n)
+{
+	// Planar rows are rounded up to 16 floats and compact ones to 32 halves, one
+	// cache line, so every row is aligned for full-width vector loads.
+	if(storage == WavesStorage::Planar)
+		return (n + 15) & ~15;
+	if(storage == WavesStorage::Half || storage == WavesStorage::Fixed16)
+		return (n + 31) & ~31;
+	return n;
+}
+
+bool Waves::SnapshotLayout(const WavesSnapshotHeader& header, int& rowPitch, u32& elementBytes, u64& planeBytes)
+{
+	if(header.Storage > (u32)WavesStorage::Fixed16 || header.Rows < 3 || header.Cols < 3 ||
+		header.Rows > WavesSnapshotHeader::MaxDimension || header.Cols > WavesSnapshotHeader::MaxDimension)
+		return false;
+
+	WavesStorage storage = (WavesStorage)header.Storage;
+	rowPitch = PlaneRowPitch(storage, header.Cols);
+	elementBytes = storage == WavesStorage::Planar ? (u32)sizeof(float) :
+		storage == WavesStorage::Interleaved ? (u32)sizeof(XMFLOAT3) : (u32)sizeof(u16);
+	planeBytes = (u64)header.Rows*rowPitch*elementBytes;
+	return true;
+}
+
+std::unique_ptr<Waves> Waves::LoadSnapshot(const char* path)
+{
+	auto file = std::make_unique<MappedFile>();
+	if(!file->Open(path, MappedFileAccess::CopyOnWrite) || file->Size() < sizeof(WavesSnapshotHeader))
+		return nullptr;
+
+	WavesSnapshotHeader header;
+	memcpy(&header, file->Data(), sizeof(header));
+	if(header.Magic != WavesSnapshotHeader::MagicValue || header.FormatVersion != WavesSnapshotHeader::CurrentVersion ||
+		header.HeaderBytes != sizeof(WavesSnapshotHeader) || !(header.SpatialStep > 0.0f) ||
+		!(header.TimeStep > 0.0f) || !(header.Speed >= 0.0f) || !(header.TimeStep < MaxStableTimeStep(header.SpatialStep, header.Speed)))
+		return nullptr;
+
+	// The solver state must be one Update can run from: a finite accumulator
+	// of less than a step, at least one substep and, for Fixed16, a usable
+	// fixed-point step. The comparisons fail for NaN.
+	if(!std::isfinite(header.SpatialStep) || !std::isfinite(header.Speed) ||
+		!(header.Damping >= 0.0f) || !std::isfinite(header.Damping) ||
+		!(header.Accumulator >= 0.0f && header.Accumulator <= header.TimeStep) || header.MaxSubsteps < 1 ||
+		(header.Storage == (u32)WavesStorage::Fixed16 && !(header.FixedStep > 0.0f && std::isfinite(header.FixedStep))))
+		return nullptr;
+
+	// Check the layout against the file before allocating anything for it.
+	int rowPitch = 0;
+	u32 elementBytes = 0;
+	u64 planeBytes = 0;
+	const u64 fileBytes = file->Size();
+	if(!SnapshotLayout(header, rowPitch, elementBytes, planeBytes) || header.RowPitch != rowPitch ||
+		header.ElementBytes != elementBytes || header.PlaneBytes != planeBytes ||
+		header.PrevOffset % 64 != 0 || header.CurrOffset % 64 != 0 ||
+		header.PrevOffset > fileBytes || planeBytes > fileBytes - header.PrevOffset ||
+		header.CurrOffset > fileBytes || planeBytes > fileBytes - header.CurrOffset)
+		return nullptr;
+
+	// The constructor computes the stencil coefficients from the constants
+	// just checked; the ones in the file are ignored.
+	WavesStorage storage = (WavesStorage)header.Storage;
+	std::unique_ptr<Waves> waves(new Waves(header.Rows, header.Cols, header.SpatialStep, header.TimeStep,
+		header.Speed, header.Damping, storage, false));
+	bool planar = storage == WavesStorage::Planar;
+	bool compact = waves->IsCompact();
+
+	waves->mAccumulator = header.Accumulator;
+	if(storage == WavesStorage::Fixed16)
+		waves->mFixedStep = header.FixedStep;
+	waves->mMaxSubsteps = header.MaxSubsteps;
+	waves->mStepCount = header.StepCount;
+	waves->mVersion = header.SolutionVersion;
+	waves->mDroppedSteps = header.DroppedSteps;
+
+	u8* prev = file->Data() + header.PrevOffset;
+	u8* curr = file->Data() + header.CurrOffset;
+	size_t elements = (size_t)header.Rows*rowPitch;
+	if(planar)
+	{
+		waves->mPrevHeights.Adopt(reinterpret_cast<float*>(prev), elements);
+		waves->mCurrHeights.Adopt(reinterpret_cast<float*>(curr), elements);
+		waves->mSnapshotFile = std::move(file);
+	}
+	else if(compact)
+	{
+		waves->mPrevPacked.Adopt(reinterpret_cast<u16*>(prev), elements);
+		waves->mCurrPacked.Adopt(reinterpret_cast<u16*>(curr), elements);
+		waves->mSnapshotFile = std::move(file);
+	}
+	else
+	{
+		memcpy(waves->mPrevSolution.data(), prev, (size_t)planeBytes);
+		memcpy(waves->mCurrSolution.data(), curr, (size_t)planeBytes);
+	}
+
+	waves->UpdateNormals();
+	return waves;
+}
+
+void Waves::ReleaseSnapshot()
+{
+	if(!mSnapshotFile)
+		return;
+
+	// Stepping swaps planes around, so any of them may be a view into the file.
+	auto own = [](auto& plane)
+	{
+		if(plane.Owned() || plane.Empty())
+			return;
+		std::decay_t<decltype(plane)> copy(plane.Size(), 64);
+		memcpy(copy.Data(), plane.Data(), plane.ByteSize());
+		plane.Swap(copy);
+	};
+	own(mPrevHeights);
+	own(mCurrHeights);
+	own(mNextPrevHeights);
+	own(mNextCurrHeights);
+	own(mPrevPacked);
+	own(mCurrPacked);
+
+	mSnapshotFile.reset();
+}
+
+u32 Waves::HeightmapRowPitch(WavesHeightFormat format, u32 alignment)const
+{
+	u32 texelSize = (format == WavesHeightFormat::R16F) ? 2 : 4;
+	return (mNumCols*texelSize + alignment - 1) / alignment*alignment;
+}
+
+u32 Waves::NormalmapRowPitch(u32 alignment)const
+{
+	return (mNumCols*2 + alignment - 1) / alignment*alignment;
+}
+
+void Waves::WriteHeightmap(const WavesHeightmap& dst, u64* dstVersion, float alpha, WavesWriteStats* stats)const
+{
+	const bool half = dst.HeightFormat == WavesHeightFormat::R16F;
+	assert(dst.HeightRowPitch >= (u32)mNumCols*(half ? 2 : 4));
+	assert(dst.Heights.Size() >= (size_t)(mNumRows - 1)*dst.HeightRowPitch + mNumCols*(half ? 2 : 4));
+	assert(dst.Normals.Empty() || dst.NormalRowPitch >= (u32)mNumCols*2);
+	assert(dst.Normals.Empty() || dst.Normals.Size() >= (size_t)(mNumRows - 1)*dst.NormalRowPitch + mNumCols*2);
+
+	u32 bytesPerPoint = (half ? 2 : 4) + (dst.Normals.Empty() ? 0 : 2);
+	ForEachStaleSpan(dstVersion, alpha, stats, bytesPerPoint, [this, &dst, half, alpha](int i, int firstCol, int lastCol)
+	{
+		thread_local std::vector<float> heights;
+
+		int count = lastCol - firstCol;
+		u8* heightRow = dst.Heights.Data() + (size_t)i*dst.HeightRowPitch;
+		if(half && mStorage == WavesStorage::Half && alpha >= 1.0f)
+		{
+			// Already in the texel format.
+			memcpy(reinterpret_cast<u16*>(heightRow) + firstCol,
+				mCurrPacked.Data() + (size_t)i*mRowPitch + firstCol, count*sizeof(u16));
+		}
+		else
+		{
+			const float* row = RowHeights(i, firstCol, lastCol, alpha, heights);
+			if(half)
+				WavesKernels::FloatToHalfRow(row + firstCol, count, reinterpret_cast<u16*>(heightRow) + firstCol);
+			else
+				memcpy(reinterpret_cast<float*>(heightRow) + firstCol, row + firstCol, count*sizeof(float));
+		}
+
+		if(dst.Normals.Empty())
+			return;
+
+		u16* normalRow = reinterpret_cast<u16*>(dst.Normals.Data() + (size_t)i*dst.NormalRowPitch);
+		if(IsCompact())
+		{
+			memcpy(normalRow + firstCol, mOctNormals.Data() + (size_t)i*mNumCols + firstCol, count*sizeof(u16));
+			return;
+		}
+
+		WavesKernels::EncodeOctRow(&mNormals[i*mNumCols + firstCol], count, normalRow + firstCol);
+	});
+}
+
+void Waves::DisturbBatch(Span<const WavesImpulse> impulses)
+{
+	for(const WavesImpulse& impulse : impulses)
+	{
+		if(!std::isfinite(impulse.Row) || !std::isfinite(impulse.Col) || !std::isfinite(impulse.Magnitude) ||
+			!std::isfinite(impulse.Radius) || !std::isfinite(impulse.Delay))
+			continue;
+
+		// Round to the nearest step boundary. The clamp, in float, keeps the
+		// conversion defined; no simulation runs for 2^62 steps.
+		float steps = impulse.Delay / mTimeStep;
+
+		PendingImpulse pending;
+		pending.Impulse = impulse;
+		pending.Step = mStepCount + (steps > 0.0f ? (u64)std::min(steps + 0.5f, 4.0e18f) : 0);
+		mPendingImpulses.push_back(pending);
+	}
+}
+
+int Waves::PendingImpulseCount()const
+{
+	return (int)mPendingImpulses.size();
+}
+
+u64 Waves::StepsUntilNextImpulse()const
+{
+	u64 steps = ~0ull;
+	for(const PendingImpulse& pending : mPendingImpulses)
+		steps = std::min(steps, pending.Step > mStepCount ? pending.Step - mStepCount : 0);
+	return steps;
+}
+
+void Waves::ApplyDueImpulses()
+{
+	if(mPendingImpulses.empty())
+		return;
+
+	// Move the due impulses out, keeping the rest in submission order.
+	mDueImpulses.clear();
+	size_t kept = 0;
+	for(const PendingImpulse& pending : mPendingImpulses)
+	{
+		if(pending.Step <= mStepCount)
+			mDueImpulses.push_back(pending.Impulse);
+		else
+			mPendingImpulses[kept++] = pending;
+	}
+	mPendingImpulses.resize(kept);
+
+	const int count = (int)mDueImpulses.size();
+	if(count == 0)
+		return;
+
+	// No footprint reaches further than across the grid.
+	float maxRadius = 0.0f;
+	for(const WavesImpulse& impulse : mDueImpulses)
+	{
+		maxRadius = std::max(maxRadius, std::min(impulse.Radius, (float)std::max(mNumRows, mNumCols)));
+
+		// The footprint plus the one cell the stencil reaches into next step,
+		// clamped in float to just past the grid (WakeTiles clips the rest) so
+		// that the conversions stay defined.
+		if(mSleepTileSize > 0)
+		{
+			auto bound = [](float x, int size) { return std::min(std::max(x, -2.0f), (float)(size + 2)); };
+			WakeTiles((int)floorf(bound(impulse.Row - impulse.Radius, mNumRows)) - 1,
+				(int)ceilf(bound(impulse.Row + impulse.Radius, mNumRows)) + 2,
+				(int)floorf(bound(impulse.Col - impulse.Radius, mNumCols)) - 1,
+				(int)ceilf(bound(impulse.Col + impulse.Radius, mNumCols)) + 2);
+		}
+	}
+
+	// A handful of impulses is not worth a parallel pass.
+	if(count < 32)
+	{
+		for(const WavesImpulse& impulse : mDueImpulses)
+			ApplyImpulse(impulse);
+		return;
+	}
+
+	// Bucket the impulses by the tile holding their (clamped) centre. A footprint
+	// reaches at most ceil(radius) cells from that cell, so with tiles wider than
+	// twice that, impulses whose tiles share a colour of a 2x2 checkerboard never
+	// touch the same cell. Each colour is then applied in parallel, one job per
+	// tile, with the impulses of a tile in submission order.
+	const int T = std::max(16, 2*(int)ceilf(maxRadius) + 1);
+	const int tileRows = (mNumRows + T - 1) / T;
+	const int tileCols = (mNumCols + T - 1) / T;
+	auto tileOf = [this, T, tileCols](const WavesImpulse& impulse)
+	{
+		int r = (int)floorf(std::min(std::max(impulse.Row + 0.5f, 0.0f), (float)(mNumRows - 1)));
+		int c = (int)floorf(std::min(std::max(impulse.Col + 0.5f, 0.0f), (float)(mNumCols - 1)));
+		return (r / T)*tileCols + c / T;
+	};
+
+	mBucketStart.assign(tileRows*tileCols + 1, 0);
+	for(const WavesImpulse& impulse : mDueImpulses)
+		++mBucketStart[tileOf(impulse) + 1];
+	for(int t = 0; t < tileRows*tileCols; ++t)
+		mBucketStart[t + 1] += mBucketStart[t];
+
+	// mColorTiles doubles as the fill cursor here.
+	mImpulseOrder.resize(count);
+	mColorTiles.assign(mBucketStart.begin(), mBucketStart.end() - 1);
+	for(int k = 0; k < count; ++k)
+		mImpulseOrder[mColorTiles[tileOf(mDueImpulses[k])]++] = k;
+
+	for(int color = 0; color < 4; ++color)
+	{
+		mColorTiles.clear();
+		for(int tr = color / 2; tr < tileRows; tr += 2)
+		{
+			for(int tc = color % 2; tc < tileCols; tc += 2)
+			{
+				int tile = tr*tileCols + tc;
+				if(mBucketStart[tile + 1] > mBucketStart[tile])
+					mColorTiles.push_back(tile);
+			}
+		}
+
+		JobSystem::Get().ParallelFor(0, (int)mColorTiles.size(), 1, [this](int first, int last)
+		{
+			for(int t = first; t < last; ++t)
+			{
+				int tile = mColorTiles[t];
+				for(int k = mBucketStart[tile]; k < mBucketStart[tile + 1]; ++k)
+					ApplyImpulse(mDueImpulses[mImpulseOrder[k]]);
+			}
+		});
+	}
+}
+
+void Waves::ApplyImpulse(const WavesImpulse& impulse)
+{
+	const float radius = impulse.Radius;
+	if(radius <= 0.0f)
+		return;
+
+	// Clip to the interior; the boundary stays fixed. The bounds are clamped to
+	// the grid in float first, so that a centre or radius far outside it still
+	// converts to int: a huge radius covers the whole interior.
+	auto clip = [](float x, int size) { return std::min(std::max(x, 0.0f), (float)(size - 1)); };
+	int i0 = std::max(1, (int)ceilf(clip(impulse.Row - radius, mNumRows)));
+	int i1 = std::min(mNumRows - 2, (int)floorf(clip(impulse.Row + radius, mNumRows)));
+	int j0 = std::max(1, (int)ceilf(clip(impulse.Col - radius, mNumCols)));
+	int j1 = std::min(mNumCols - 2, (int)floorf(clip(impulse.Col + radius, mNumCols)));
+
+	const float invRadiusSq = 1.0f / (radius*radius);
+	for(int i = i0; i <= i1; ++i)
+	{
+		float di = i - impulse.Row;
+		for(int j = j0; j <= j1; ++j)
+		{
+			float dj = j - impulse.Col;
+			float q = (di*di + dj*dj)*invRadiusSq;
+			if(q >= 1.0f)
+				continue;
+
+			float w = (impulse.Shape == WavesImpulseShape::Gaussian)
+				? expf(-4.5f*q)
+				: 0.5f*(1.0f + cosf(XM_PI*sqrtf(q)));
+			AddHeight(i, j, impulse.Magnitude*w);
+		}
+	}
+}
+
+void Waves::Disturb(int i, int j, float magnitude)
+{
+	// Don't disturb boundaries.
+	assert(i > 1 && i < mNumRows-2);
+	assert(j > 1 && j < mNumCols-2);
+
+	float halfMag = 0.5f*magnitude;
+
+	// The footprint plus the one cell the stencil reaches into next step.
+	++mVersion;
+	if(mSleepTileSize > 0)
+		WakeTiles(i - 2, i + 3, j - 2, j + 3);
+
+	// Disturb the ijth vertex height and its neighbors.
+	AddHeight(i, j, magnitude);
+	AddHeight(i, j+1, halfMag);
+	AddHeight(i, j-1, halfMag);
+	AddHeight(i+1, j, halfMag);
+	AddHeight(i-1, j, halfMag);
+}
\ No newline at end of file
@@ -0,0 +1,649 @@
+//***************************************************************************************
+// Waves.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Performs the calculations for the wave simulation.  After the simulation has been
+// updated, the client must copy the current solution into vertex buffers for rendering.
+// This class only does the calculations, it does not do any drawing.
+//
+// Shared by all of the wave demos; see WavesStorage for the memory layouts and
+// AsyncWaves for running it behind rendering.
+//***************************************************************************************
+
+#ifndef WAVES_H
+#define WAVES_H
+
+#include <memory>
+#include <vector>
+#include <DirectXMath.h>
+#include <Common/AlignedBuffer.hpp>
+#include <Common/defines.hpp>
+#include <Common/Span.hpp>
+
+// How the simulation keeps its state in memory.
+//   Interleaved: one XMFLOAT3 per grid point for the previous and current solution.
+//   Planar:      packed, 64-byte aligned f32 height planes with a padded row pitch;
+//                x/z are derived from the grid indices and the stencil is vectorized.
+//   Half:        like Planar with fp16 heights, 16-bit octahedral normals and no
+//                stored tangents (derived on demand): 6 bytes per grid point
+//                instead of 32 (Planar) or 48 (Interleaved).
+//   Fixed16:     as Half, but heights are 16-bit fixed point over a fixed range
+//                (see SetFixedPointRange): uniform precision instead of relative.
+// The compact modes convert rows to f32 around the stencil, so the arithmetic is
+// the same; only the stored state is rounded after every step.
+enum class WavesStorage
+{
+    Interleaved,
+    Planar,
+    Half,
+    Fixed16
+};
+
+// How an Update step walks the grid.
+//   TwoPass: one sweep advances the heights, a second sweep recomputes normals/tangents.
+//   Fused:   a single sweep per row block; normals for row i-1 are produced right
+//            after the heights of row i, while the rows are still in cache.
+enum class WavesPipeline
+{
+    TwoPass,
+    Fused
+};
+
+// Interleaved vertex produced by Waves::WriteVertices. Layout-compatible with the
+// {Pos, Normal, TexC} vertex the wave demos upload.
+struct WavesVertex
+{
+    DirectX::XMFLOAT3 Pos;
+    DirectX::XMFLOAT3 Normal;
+    DirectX::XMFLOAT2 TexC;
+};
+
+// Texel format of the height plane written by Waves::WriteHeightmap.
+enum class WavesHeightFormat
+{
+	R16F,
+	R32F
+};
+
+// Destination of Waves::WriteHeightmap: planes with one texel per grid point
+// and rows RowPitch bytes apart, laid out for a texture copy (e.g. an upload
+// buffer footprint for CopyTextureRegion). Normals are optional; they are
+// octahedral-encoded as two snorm8 values, i.e. R8G8_SNORM texels (see
+// WavesKernels::EncodeOct).
+struct WavesHeightmap
+{
+	Span<u8> Heights;
+	u32 HeightRowPitch = 0;
+	WavesHeightFormat HeightFormat = WavesHeightFormat::R16F;
+
+	Span<u8> Normals;
+	u32 NormalRowPitch = 0;
+};
+
+// Rows [First, Last) of the grid.
+struct WavesRowRange
+{
+	int First = 0;
+	int Last = 0;
+};
+
+// Optional report of Waves::WriteVertices / WriteHeightmap.
+struct WavesWriteStats
+{
+	// Bytes stored into the destination.
+	u64 BytesWritten = 0;
+
+	// Ascending, disjoint runs of rows that were (partly) rewritten.
+	std::vector<WavesRowRange> DirtyRows;
+};
+
+// Radial falloff of a WavesImpulse; d is the distance from the centre in cells.
+//   Gaussian: exp(-4.5 d^2 / r^2), i.e. sigma = r/3, cut off at d = r.
+//   Cosine:   0.5 (1 + cos(pi d / r)) for d < r.
+enum class WavesImpulseShape
+{
+	Gaussian,
+	Cosine
+};
+
+// One disturbance for Waves::DisturbBatch. Row/Col are (fractional) grid
+// coordinates and Radius is in cells; cells within Radius of the centre get
+// Magnitude times the falloff added to their height. Delay is in seconds after
+// the current solution and selects the time step the impulse is applied before.
+struct WavesImpulse
+{
+	float Row = 0.0f;
+	float Col = 0.0f;
+	float Magnitude = 0.0f;
+	float Radius = 1.0f;
+	float Delay = 0.0f;
+	WavesImpulseShape Shape = WavesImpulseShape::Gaussian;
+};
+
+// Header at offset 0 of a Waves::SaveSnapshot file. The two solutions follow
+// as planes at Alignment-aligned offsets, in the storage mode's own in-memory
+// layout (row pitch and padding included), so a mapped file can be used in
+// place. Fields are in native (little-endian) byte order.
+struct WavesSnapshotHeader
+{
+	static constexpr u32 MagicValue = 0x4e535657; // "WVSN"
+	static constexpr u32 CurrentVersion = 2;
+
+	// Page size, so that the planes of a mapped file start on a page.
+	static constexpr u64 Alignment = 4096;
+
+	// Largest Rows and Cols LoadSnapshot accepts, which keeps the vertex and
+	// triangle counts within an int.
+	static constexpr int MaxDimension = 16384;
+
+	u32 Magic = MagicValue;
+	u32 FormatVersion = CurrentVersion;
+	u32 HeaderBytes = 0;
+	u32 Storage = 0;
+
+	int Rows = 0;
+	int Cols = 0;
+
+	// Elements between plane rows, and bytes per element: 4 (Planar), 2 (Half,
+	// Fixed16) or 12 (Interleaved, one XMFLOAT3 per point).
+	int RowPitch = 0;
+	u32 ElementBytes = 0;
+
+	float SpatialStep = 0.0f;
+	float TimeStep = 0.0f;
+	float Speed = 0.0f;
+	float Damping = 0.0f;
+	float K1 = 0.0f;
+	float K2 = 0.0f;
+	float K3 = 0.0f;
+	float Accumulator = 0.0f;
+	float FixedStep = 0.0f;
+	int MaxSubsteps = 0;
+
+	u64 StepCount = 0;
+	u64 SolutionVersion = 0;
+	u64 DroppedSteps = 0;
+
+	u64 PrevOffset = 0;
+	u64 CurrOffset = 0;
+	u64 PlaneBytes = 0;
+};
+
+class MappedFile;
+
+// What the demos need from a simulated water surface: the grid, per-point
+// accessors and vertex output. Implemented by Waves, by the fixed-size
+// FixedWaves (see MakeWaves) and by the spectral OceanWaves.
+class WavesSurface
+{
+public:
+	virtual ~WavesSurface() = default;
+
+	virtual int RowCount()const = 0;
+	virtual int ColumnCount()const = 0;
+	virtual int VertexCount()const = 0;
+	virtual int TriangleCount()const = 0;
+	virtual float Width()const = 0;
+	virtual float Depth()const = 0;
+
+	// Incremented whenever the solution changes.
+	virtual u64 Version()const = 0;
+
+	virtual DirectX::XMFLOAT3 Position(int i)const = 0;
+	virtual DirectX::XMFLOAT3 Normal(int i)const = 0;
+	virtual DirectX::XMFLOAT3 TangentX(int i)const = 0;
+
+	// Advances by dt seconds in fixed time steps, carrying over the remainder.
+	virtual void Update(float dt) = 0;
+	virtual float InterpolationAlpha()const = 0;
+	virtual void Step(int count) = 0;
+	virtual void Disturb(int i, int j, float magnitude) = 0;
+
+	// Writes the solution as VertexCount() vertices (see Waves::WriteVertices).
+	virtual void WriteVertices(Span<WavesVertex> dst, u64* dstVersion = nullptr, float alpha = 1.0f,
+		WavesWriteStats* stats = nullptr)const = 0;
+};
+
+class Waves : public WavesSurface
+{
+public:
+    Waves(int m, int n, float dx, float dt, float speed, float damping,
+          WavesStorage storage = WavesStorage::Interleaved);
+    Waves(const Waves& rhs) = delete;
+    Waves& operator=(const Waves& rhs) = delete;
+    ~Waves() override;
+
+	int RowCount()const override;
+	int ColumnCount()const override;
+	int VertexCount()const override;
+	int TriangleCount()const override;
+	float Width()const override;
+	float Depth()const override;
+	WavesStorage Storage()const;
+
+	// Bytes held by the simulation state (solutions, normals, tangents).
+	size_t StateBytes()const;
+
+	// Moves the state arrays (height planes, normals, tangents) to memory
+	// under policy, e.g. TransparentHuge for large grids to cut TLB misses.
+	// The contents are copied by the job system with the same row partition the
+	// stencil and normal passes use, so under any policy but Heap each page is
+	// first touched, and placed, on the NUMA node of the worker that will most
+	// likely step those rows. Placement is best effort: workers are not pinned
+	// and stealing can move rows. Default Heap.
+	void SetStatePagePolicy(PagePolicy policy);
+	PagePolicy StatePagePolicy()const;
+
+	// Residency, huge page and TLB counts summed over the state arrays.
+	PageStats StatePageStats()const;
+
+	// Largest |height| representable by Fixed16 storage; heights beyond it
+	// saturate. Existing heights are requantized. Default 4.
+	void SetFixedPointRange(float maxHeight);
+	float FixedPointRange()const;
+
+	WavesPipeline Pipeline()const;
+	void SetPipeline(WavesPipeline pipeline);
+
+	// Enables the temporally blocked solver for multi-step updates (planar storage
+	// only). The grid is cut into tileSize x tileSize tiles; each tile plus a halo
+	// of stepsPerTile cells is advanced stepsPerTile time steps while it stays in
+	// cache before moving on. stepsPerTile <= 1 disables blocking. Blocking is
+	// bypassed while quiescence tracking is on, which needs per-step activity.
+	void SetTemporalBlocking(int tileSize, int stepsPerTile);
+	int TemporalTileSize()const;
+	int TemporalStepsPerTile()const;
+
+	// Enables per-tile activity tracking. The grid is cut into tileSize x tileSize
+	// tiles that are skipped by the stencil, normal and vertex passes while they
+	// sleep. An awake tile falls asleep (and is flattened) once its heights stay
+	// below sleepEpsilon for two consecutive steps; a sleeping tile is woken by
+	// Disturb, or when an awake neighbour's heights along their shared edge
+	// exceed wakeThreshold. tileSize <= 0 disables tracking.
+	void SetQuiescence(int tileSize, float sleepEpsilon, float wakeThreshold);
+	int QuiescenceTileSize()const;
+
+	// Number of activity tiles, and how many of them are awake. Both are 0 while
+	// quiescence tracking is disabled.
+	int TileCount()const;
+	int ActiveTileCount()const;
+
+	// Incremented whenever the solution changes (Step, Disturb).
+	u64 Version()const override;
+
+	// Returns the solution at the ith grid point.
+    DirectX::XMFLOAT3 Position(int i)const override;
+
+	// Returns the ith grid point blended between the previous (alpha = 0) and the
+	// current (alpha = 1) solution.
+    DirectX::XMFLOAT3 InterpolatedPosition(int i, float alpha)const;
+
+	// Returns the solution normal at the ith grid point.
+    DirectX::XMFLOAT3 Normal(int i)const override;
+
+	// Returns the unit tangent vector at the ith grid point in the local x-axis direction.
+    DirectX::XMFLOAT3 TangentX(int i)const override;
+
+	// Batched queries of the current solution at arbitrary world (x, z) points,
+	// e.g. for floating objects: heights[k] / normals[k] receive the bilinear
+	// interpolation of the four grid points around xz[k] (normals renormalized).
+	// Points off the grid are clamped to its edge; a NaN coordinate samples the
+	// first row or column. Four points are interpolated
+	// at a time with SIMD, and large batches are split across the job system.
+	void SampleHeights(Span<const DirectX::XMFLOAT2> xz, Span<float> heights)const;
+	void SampleNormals(Span<const DirectX::XMFLOAT2> xz, Span<DirectX::XMFLOAT3> normals)const;
+
+	// Advances the simulation by dt seconds in fixed time steps. Time that does not
+	// fill a whole step carries over to the next call. At most MaxSubsteps() steps
+	// run per call; any further backlog is dropped (see DroppedSteps()) so that a
+	// long frame cannot make the following ones even longer.
+	void Update(float dt) override;
+
+	void SetMaxSubsteps(int maxSubsteps);
+	int MaxSubsteps()const;
+	u64 DroppedSteps()const;
+
+	// Largest time step for which the explicit scheme stays bounded on a grid
+	// with spacing dx: dt < dx / (speed * sqrt(2)), from the von Neumann analysis
+	// of the checkerboard mode. Damping only makes the solution decay faster and
+	// does not move the bound. Infinite for speed 0.
+	static float MaxStableTimeStep(float dx, float speed);
+	float MaxStableTimeStep()const;
+
+	// Whether the current time step is below MaxStableTimeStep(). An unstable
+	// simulation grows without bound within a few hundred steps.
+	bool IsStable()const;
+
+	// Seconds advanced per step; changes with the frame time in adaptive mode.
+	float TimeStep()const;
+
+	// Adaptive mode. Update then runs each frame in the fewest steps that stay
+	// below safety * MaxStableTimeStep(), instead of in steps of the constructor's
+	// dt: a frame of dt seconds takes ceil(dt / limit) equal steps. Step sizes are
+	// snapped to a ladder of 16 per octave below the limit and kept while the frame
+	// time only jitters, so the stencil coefficients are computed once per size
+	// and cached. Switching sizes re-times the previous solution to the new step
+	// (one pass over the grid). Disabling keeps the current step size.
+	void SetAdaptiveTimeStep(bool enabled, float safety = 0.95f);
+	bool AdaptiveTimeStep()const;
+
+	// Fraction of a time step accumulated since the last step, in [0, 1]. Drawing
+	// the solution interpolated by this alpha (see WriteVertices) keeps the
+	// motion smooth when the frame rate and step rate differ.
+	float InterpolationAlpha()const override;
+	void Disturb(int i, int j, float magnitude) override;
+
+	// Queues impulses for the coming time steps. Each one is applied right before
+	// the step nearest to its Delay (Delay <= 0: before the next step, counted in
+	// steps of the current TimeStep()), with the
+	// footprint clipped to the interior; boundary points stay fixed. Impulses
+	// with a non-finite field are dropped. Impulses landing on the same step
+	// are applied in parallel.
+	void DisturbBatch(Span<const WavesImpulse> impulses);
+	int PendingImpulseCount()const;
+
+	// Advances the simulation count time steps, then refreshes normals/tangents.
+	void Step(int count) override;
+
+	// Recomputes the normals/tangents of the current solution. Step does this
+	// itself; only needed after the heights were replaced some other way.
+	void UpdateNormals();
+
+	// Writes the current solution straight into dst (at least VertexCount()
+	// elements), typically the persistently mapped upload buffer. Rows are written
+	// in parallel with non-temporal stores; TexC maps [-w/2,w/2] --> [0,1].
+	// If dstVersion is given it holds the Version() dst was last written at: only
+	// tiles that changed since then are rewritten, and it is advanced to Version().
+	// alpha < 1 writes heights interpolated towards the previous solution (normals
+	// stay current); awake tiles of such a destination are always rewritten.
+	// stats, if given, receives the bytes and rows written.
+	void WriteVertices(Span<WavesVertex> dst, u64* dstVersion = nullptr, float alpha = 1.0f,
+		WavesWriteStats* stats = nullptr)const override;
+
+	// Checkpointing. SaveSnapshot writes the grid, the constants, both time
+	// levels and the step counters to path (see WavesSnapshotHeader); it returns
+	// false if the file cannot be written. Pending impulses and the solver
+	// settings (pipeline, temporal blocking, quiescence) are not part of the
+	// snapshot.
+	bool SaveSnapshot(const char* path)const;
+
+	// Recreates the simulation saved by SaveSnapshot, or returns null if the
+	// file is missing, truncated, of another format version or holds constants
+	// or solver state the simulation cannot run from (an unstable or
+	// non-finite step, an accumulator outside [0, TimeStep], no substeps). The
+	// stencil coefficients are recomputed rather than read back. The file is
+	// mapped copy-on-write and the header is checked against the file size
+	// before anything is allocated. Only Planar and the compact modes restore
+	// zero-copy: their planes are used in place, so nothing is read or copied
+	// up front, pages fault in as the first step touches them, and the file
+	// itself is never modified. Interleaved solutions live in vectors and are
+	// copied out. Normals are recomputed.
+	static std::unique_ptr<Waves> LoadSnapshot(const char* path);
+
+	// Copies the planes a LoadSnapshot simulation still shares with its file
+	// into memory of their own and unmaps the file, e.g. before saving over it.
+	void ReleaseSnapshot();
+
+	// Smallest row pitch for WriteHeightmap planes, rounded up to alignment bytes
+	// (D3D12_TEXTURE_DATA_PITCH_ALIGNMENT by default).
+	u32 HeightmapRowPitch(WavesHeightFormat format, u32 alignment = 256)const;
+	u32 NormalmapRowPitch(u32 alignment = 256)const;
+
+	// Writes only the heights (and optionally normals) of the current solution,
+	// for renderers that keep the x/z grid in a static vertex buffer and displace
+	// it in the vertex shader: 2-4 bytes per grid point for the heights and 2 for
+	// the normals instead of a 32-byte vertex. dstVersion and alpha work as for
+	// WriteVertices; pass a separate version per destination.
+	void WriteHeightmap(const WavesHeightmap& dst, u64* dstVersion = nullptr, float alpha = 1.0f,
+		WavesWriteStats* stats = nullptr)const;
+
+private:
+    // Number of rows handed to each job of the parallel passes.
+    int RowGrain()const;
+
+    // Shared by the output functions: resolves *dstVersion, then calls
+    // writeSpan(row, firstCol, lastCol) in parallel for every span the
+    // destination does not hold yet, recording them in stats.
+    template <typename Fn>
+    void ForEachStaleSpan(u64* dstVersion, float alpha, WavesWriteStats* stats, u32 bytesPerPoint, Fn writeSpan)const;
+
+    // Current (and, for alpha < 1, interpolated) heights of columns
+    // [firstCol, lastCol) of row i, indexed by column. Returns either the
+    // storage itself or scratch.
+    const float* RowHeights(int i, int firstCol, int lastCol, float alpha, std::vector<float>& scratch)const;
+
+    // Advances the height field one time step for the interior rows in [firstRow, lastRow).
+    void StepRows(int firstRow, int lastRow);
+
+    // Recomputes normals and tangents for the interior rows in [firstRow, lastRow).
+    // While a step is in flight the new heights live in the previous-solution
+    // buffer; fromNext selects that buffer instead of the current one.
+    void ComputeNormalRows(int firstRow, int lastRow, bool fromNext = false);
+
+    // One time step using the fused pipeline. Leaves the new solution in the
+    // previous-solution buffer, like StepRows.
+    void StepFused();
+
+    // Advances every tile stepCount time steps with the temporally blocked
+    // solver and swaps the result into the solution planes.
+    void StepTemporalBlocked(int stepCount);
+
+    void SwapSolutions();
+
+    // LoadSnapshot's constructor: allocateSolution false leaves the Planar and
+    // compact planes empty for the caller to adopt, and the solution and the
+    // interior normals uninitialized for it to fill in.
+    Waves(int m, int n, float dx, float dt, float speed, float damping, WavesStorage storage,
+          bool allocateSolution);
+
+    // Elements between solution plane rows in the given storage mode.
+    static int PlaneRowPitch(WavesStorage storage, int n);
+
+    // Plane layout a snapshot of header's storage and size must have; false if
+    // the storage mode or the size is out of range.
+    static bool SnapshotLayout(const WavesSnapshotHeader& header, int& rowPitch, u32& elementBytes,
+                               u64& planeBytes);
+
+    // Stencil coefficients of one time step size.
+    struct StepCoefficients
+    {
+        float TimeStep = 0.0f;
+        float K1 = 0.0f;
+        float K2 = 0.0f;
+        float K3 = 0.0f;
+    };
+
+    // Coefficients for time step dt, from mCoefficientCache or computed.
+    const StepCoefficients& CoefficientsFor(float dt);
+
+    // Adaptive mode: picks the step size for a frame of frameTime seconds.
+    void SelectTimeStep(float frameTime);
+
+    // Switches to time step dt, re-timing the previous solution so that the
+    // velocity (curr - prev) / dt it represents is unchanged.
+    void SetTimeStep(float dt);
+
+    // Applies (and dequeues) the pending impulses due before the next step.
+    void ApplyDueImpulses();
+
+    // Number of steps that can be taken before another impulse is due.
+    u64 StepsUntilNextImpulse()const;
+
+    // Adds one impulse's falloff to the current solution, clipped to the interior.
+    void ApplyImpulse(const WavesImpulse& impulse);
+
+    // Quiescence helpers. UpdateActivity runs between steps: it puts quiet tiles
+    // to sleep and wakes the neighbours of tiles with energy on their edges.
+    // WakeTiles wakes every tile overlapping rows [r0, r1) x columns [c0, c1).
+    void UpdateActivity();
+    void WakeTiles(int r0, int r1, int c0, int c1);
+    void FlattenTile(int tile);
+
+    // Advances / re-derives normals for columns [firstCol, lastCol) of row i.
+    void StepRowSpan(int i, int firstCol, int lastCol);
+    void NormalRowSpan(int i, int firstCol, int lastCol, bool fromNext);
+
+    // Largest |height| of the solution just produced by StepRowSpan (it lives in
+    // the previous-solution buffer until the swap) over columns [firstCol, lastCol).
+    float NextRowAmplitude(int i, int firstCol, int lastCol)const;
+
+    // Calls fn(row, col, fx, fz, first, count) for the points of xz in groups of
+    // four (the last group padded with copies of its final point): row/col hold
+    // the top-left grid point of each point's cell and fx/fz its bilinear
+    // weights along the columns and rows; results go to [first, first + count).
+    template <typename Fn>
+    void ForEachSampleQuad(Span<const DirectX::XMFLOAT2> xz, Fn fn)const;
+
+    // Current solution height at row i, column j.
+    float Height(int i, int j)const;
+    void AddHeight(int i, int j, float delta);
+
+    bool IsCompact()const;
+
+    // Row conversions between f32 and the compact height format.
+    void DecodeHeights(const u16* src, int count, float* dst)const;
+    void EncodeHeights(const float* src, int count, u16* dst)const;
+
+    // Decodes rows i-1..i+1 of plane, columns [firstCol-1, lastCol+1), into three
+    // rows of the calling thread's scratch; returns the middle one.
+    float* DecodeNeighbourhood(const AlignedBuffer<u16>& plane, int i, int firstCol, int lastCol, int& scratchPitch)const;
+
+private:
+    WavesStorage mStorage = WavesStorage::Interleaved;
+    WavesPipeline mPipeline = WavesPipeline::TwoPass;
+
+    int mNumRows = 0;
+    int mNumCols = 0;
+
+    int mVertexCount = 0;
+    int mTriangleCount = 0;
+
+    // Simulation constants we can precompute.
+    float mK1 = 0.0f;
+    float mK2 = 0.0f;
+    float mK3 = 0.0f;
+
+    float mTimeStep = 0.0f;
+    float mSpatialStep = 0.0f;
+    float mSpeed = 0.0f;
+    float mDamping = 0.0f;
+
+    // Adaptive time stepping; the cache holds the coefficients of every step
+    // size used so far.
+    bool mAdaptiveTimeStep = false;
+    float mStabilitySafety = 0.95f;
+    std::vector<StepCoefficients> mCoefficientCache;
+
+    // Fixed-step scheduling for Update.
+    float mAccumulator = 0.0f;
+    int mMaxSubsteps = 8;
+    u64 mDroppedSteps = 0;
+
+    float mHalfWidth = 0.0f;
+    float mHalfDepth = 0.0f;
+
+    PagePolicy mPagePolicy = PagePolicy::Heap;
+
+    // Interleaved storage.
+    PageVector<DirectX::XMFLOAT3> mPrevSolution;
+    PageVector<DirectX::XMFLOAT3> mCurrSolution;
+
+    // Planar storage. Rows are mRowPitch floats apart so every row starts on a
+    // 64-byte boundary; columns [mNumCols, mRowPitch) are padding.
+    int mRowPitch = 0;
+    AlignedBuffer<float> mPrevHeights;
+    AlignedBuffer<float> mCurrHeights;
+
+    // Compact storage: the same layout with 16-bit heights (fp16 bits or i16
+    // fixed point in units of mFixedStep) and octahedral normals.
+    AlignedBuffer<u16> mPrevPacked;
+    AlignedBuffer<u16> mCurrPacked;
+    AlignedBuffer<u16> mOctNormals;
+    float mFixedStep = 4.0f / 32767.0f;
+
+    // Temporal blocking. Tiles write their cores into the Next planes so that
+    // neighbouring tiles still read the untouched input halos.
+    int mTileSize = 0;
+    int mTileSteps = 0;
+    AlignedBuffer<float> mNextPrevHeights;
+    AlignedBuffer<float> mNextCurrHeights;
+
+    // Quiescence tracking; tiles are stored row-major, mTileCols per tile row.
+    // mRowAmplitude holds, per grid row and tile column, the largest |height| the
+    // last step produced there. mTileAmplitude is the per-tile maximum of the step
+    // before, so a tile only sleeps once both time levels are quiet.
+    int mSleepTileSize = 0;
+    int mTileRows = 0;
+    int mTileCols = 0;
+    int mActiveTiles = 0;
+    float mSleepEpsilon = 0.0f;
+    float mWakeThreshold = 0.0f;
+    std::vector<u8> mTileAwake;
+    std::vector<u8> mNextAwake;
+    std::vector<float> mTileAmplitude;
+    std::vector<float> mRowAmplitude;
+
+    // Impulses waiting for their time step. mStepCount counts the steps taken
+    // so far; the rest are scratch for bucketing impulses by tile.
+    struct PendingImpulse
+    {
+        WavesImpulse Impulse;
+        u64 Step = 0;
+    };
+    u64 mStepCount = 0;
+    std::vector<PendingImpulse> mPendingImpulses;
+    std::vector<WavesImpulse> mDueImpulses;
+    std::vector<int> mImpulseOrder;
+    std::vector<int> mBucketStart;
+    std::vector<int> mColorTiles;
+
+    // Solution version, and the version at which each tile last changed.
+    u64 mVersion = 1;
+    std::vector<u64> mTileVersion;
+
+    PageVector<DirectX::XMFLOAT3> mNormals;
+    PageVector<DirectX::XMFLOAT3> mTangentX;
+
+    // Snapshot the solution planes were restored from; they point into it.
+    std::unique_ptr<MappedFile> mSnapshotFile;
+};
+
+// Compile-time spelling of WavesStorage for code that fixes its storage up
+// front: the scalar type the heights are kept in, and whether the solution is
+// an array of XMFLOAT3 points (AoS) or packed height planes (SoA).
+enum class WavesLayout
+{
+	AoS,
+	SoA
+};
+
+// Scalar tags for the 16-bit height formats.
+struct WavesHalf {};
+struct WavesFixed16 {};
+
+// Maps <Scalar, Layout> to the storage mode implementing it. Combinations
+// without a specialization (e.g. 16-bit AoS) are not supported.
+template <typename Scalar, WavesLayout Layout>
+struct WavesStorageOf;
+
+template <> struct WavesStorageOf<float, WavesLayout::AoS>        { static constexpr WavesStorage Value = WavesStorage::Interleaved; };
+template <> struct WavesStorageOf<float, WavesLayout::SoA>        { static constexpr WavesStorage Value = WavesStorage::Planar; };
+template <> struct WavesStorageOf<WavesHalf, WavesLayout::SoA>    { static constexpr WavesStorage Value = WavesStorage::Half; };
+template <> struct WavesStorageOf<WavesFixed16, WavesLayout::SoA> { static constexpr WavesStorage Value = WavesStorage::Fixed16; };
+
+// A Waves whose scalar type and layout are part of its type, e.g.
+// BasicWaves<WavesHalf> for a compact pond. All instantiations share the one
+// engine above; the kernels behind it are picked per storage mode and CPU at
+// run time.
+template <typename Scalar = float, WavesLayout Layout = WavesLayout::SoA>
+class BasicWaves : public Waves
+{
+public:
+	static constexpr WavesStorage StorageMode = WavesStorageOf<Scalar, Layout>::Value;
+
+	BasicWaves(int m, int n, float dx, float dt, float speed, float damping)
+		: Waves(m, n, dx, dt, speed, damping, StorageMode)
+	{
+	}
+};
+
+#endif // WAVES_H
\ No newline at end of file
@@ -0,0 +1,1241 @@
+#include <Common/WavesKernels.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define WAVES_KERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define WAVES_KERNELS_X86 0
+#endif
+
+// MSVC accepts AVX intrinsics in any translation unit; GCC and Clang need the
+// target enabled per function so the rest of the file stays baseline x86-64.
+// The AVX2 tier also relies on F16C, which every AVX2 CPU provides.
+#if WAVES_KERNELS_X86 && !defined(_MSC_VER)
+#define WAVES_TARGET_AVX2 __attribute__((target("avx2,f16c")))
+#else
+#define WAVES_TARGET_AVX2
+#endif
+
+using DirectX::XMFLOAT3;
+
+namespace
+{
+    using StencilRowFn = void (*)(f32*, const f32*, const f32*, const f32*, i32, f32, f32, f32);
+    using NormalRowFn  = void (*)(const f32*, const f32*, const f32*, i32, f32, XMFLOAT3*, XMFLOAT3*);
+    using VertexRowFn  = void (*)(const f32*, i32, const XMFLOAT3*, i32, i32, f32, f32, f32, f32, f32, f32*);
+    using MaxAbsRowFn  = f32 (*)(const f32*, i32);
+    using ToHalfRowFn  = void (*)(const f32*, i32, u16*);
+    using FromHalfRowFn = void (*)(const u16*, i32, f32*);
+    using ToFixedRowFn = void (*)(const f32*, i32, f32, i16*);
+    using FromFixedRowFn = void (*)(const i16*, i32, f32, f32*);
+    using NormalRowOctFn = void (*)(const f32*, const f32*, const f32*, i32, f32, u16*);
+    using EncodeOctRowFn = void (*)(const XMFLOAT3*, i32, u16*);
+    using DecodeOctRowFn = void (*)(const u16*, i32, XMFLOAT3*);
+    using FftRadix2Fn = void (*)(const WavesKernels::FftRow*, const WavesKernels::FftRow*, const f32*, i32);
+    using FftRadix4Fn = void (*)(const WavesKernels::FftRow*, const WavesKernels::FftRow*, const f32*, f32, i32);
+
+    u32 FloatBits(f32 value)
+    {
+        u32 bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    f32 BitsToFloat(u32 bits)
+    {
+        f32 value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    // Round-to-nearest-even float -> half, matching _mm_cvtps_ph.
+    u16 FloatToHalfScalar(f32 value)
+    {
+        u32 bits = FloatBits(value);
+        u32 sign = (bits >> 16) & 0x8000u;
+        u32 abs = bits & 0x7fffffffu;
+
+        if (abs >= 0x7f800000u)
+        {
+            // Inf stays inf; NaN stays a quiet NaN with the top payload bits.
+            return (u16)(sign | 0x7c00u | (abs > 0x7f800000u ? 0x0200u | ((abs >> 13) & 0x03ffu) : 0u));
+        }
+        if (abs >= 0x477ff000u)
+        {
+            // 65520 and up round to infinity.
+            return (u16)(sign | 0x7c00u);
+        }
+        if (abs < 0x38800000u)
+        {
+            // Subnormal half: adding 0.5f lines the mantissa up so that the FPU's
+            // own rounding does the work.
+            const u32 magic = 126u << 23;
+            f32 shifted = BitsToFloat(abs) + BitsToFloat(magic);
+            return (u16)(sign | (FloatBits(shifted) - magic));
+        }
+
+        u32 odd = (abs >> 13) & 1u;
+        abs += ((u32)(15 - 127) << 23) + 0x0fffu + odd;
+        return (u16)(sign | (abs >> 13));
+    }
+
+    f32 HalfToFloatScalar(u16 value)
+    {
+        u32 sign = (u32)(value & 0x8000u) << 16;
+        u32 exponent = (value >> 10) & 0x1fu;
+        u32 mantissa = value & 0x03ffu;
+
+        if (exponent == 0)
+        {
+            // Zero or subnormal: mantissa * 2^-24, exact in f32.
+            f32 magnitude = (f32)mantissa * 5.9604644775390625e-8f;
+            return BitsToFloat(FloatBits(magnitude) | sign);
+        }
+        if (exponent == 31)
+        {
+            return BitsToFloat(sign | 0x7f800000u | (mantissa << 13));
+        }
+        return BitsToFloat(sign | ((exponent + 112u) << 23) | (mantissa << 13));
+    }
+
+    void FloatToHalfRowScalar(const f32* src, i32 n, u16* dst)
+    {
+        for (i32 j = 0; j < n; ++j)
+        {
+            dst[j] = FloatToHalfScalar(src[j]);
+        }
+    }
+
+    void HalfToFloatRowScalar(const u16* src, i32 n, f32* dst)
+    {
+        for (i32 j = 0; j < n; ++j)
+        {
+            dst[j] = HalfToFloatScalar(src[j]);
+        }
+    }
+
+    i16 FloatToFixedScalar(f32 value, f32 invStep)
+    {
+        f32 v = std::min(std::max(value * invStep, -32767.0f), 32767.0f);
+        return (i16)lrintf(v);
+    }
+
+    void FloatToFixedRowScalar(const f32* src, i32 n, f32 step, i16* dst)
+    {
+        f32 invStep = 1.0f / step;
+        for (i32 j = 0; j < n; ++j)
+        {
+            dst[j] = FloatToFixedScalar(src[j], invStep);
+        }
+    }
+
+    void FixedToFloatRowScalar(const i16* src, i32 n, f32 step, f32* dst)
+    {
+        for (i32 j = 0; j < n; ++j)
+        {
+            dst[j] = (f32)src[j] * step;
+        }
+    }
+
+    u16 PackOct(i32 u, i32 v)
+    {
+        return (u16)((u & 0xff) | ((v & 0xff) << 8));
+    }
+
+    u16 EncodeOctScalar(f32 x, f32 y, f32 z)
+    {
+        f32 s = fabsf(x) + fabsf(y) + fabsf(z);
+        if (s == 0.0f)
+        {
+            return 0;
+        }
+
+        f32 u = x / s;
+        f32 v = z / s;
+        if (y < 0.0f)
+        {
+            f32 fu = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+            f32 fv = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+            u = fu;
+            v = fv;
+        }
+        return PackOct((i32)lrintf(u * 127.0f), (i32)lrintf(v * 127.0f));
+    }
+
+    XMFLOAT3 DecodeOctScalar(u16 encoded)
+    {
+        // snorm8: -128 decodes like -127.
+        f32 u = (f32)std::max((i32)(i8)(encoded & 0xff), -127) / 127.0f;
+        f32 v = (f32)std::max((i32)(i8)(encoded >> 8), -127) / 127.0f;
+
+        f32 x = u;
+        f32 z = v;
+        f32 y = 1.0f - fabsf(u) - fabsf(v);
+        if (y < 0.0f)
+        {
+            x = (1.0f - fabsf(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+            z = (1.0f - fabsf(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        f32 len = sqrtf(x * x + y * y + z * z);
+        return XMFLOAT3(x / len, y / len, z / len);
+    }
+
+    void NormalRowOctScalar(const f32* up, const f32* mid, const f32* down, i32 n, f32 spatialStep, u16* normals)
+    {
+        f32 twoDx = 2.0f * spatialStep;
+        for (i32 j = 1; j < n - 1; ++j)
+        {
+            normals[j] = EncodeOctScalar(mid[j - 1] - mid[j + 1], twoDx, down[j] - up[j]);
+        }
+    }
+
+    void EncodeOctRowScalar(const XMFLOAT3* src, i32 n, u16* dst)
+    {
+        for (i32 j = 0; j < n; ++j)
+        {
+            dst[j] = EncodeOctScalar(src[j].x, src[j].y, src[j].z);
+        }
+    }
+
+    void DecodeOctRowScalar(const u16* src, i32 n, XMFLOAT3* dst)
+    {
+        for (i32 j = 0; j < n; ++j)
+        {
+            dst[j] = DecodeOctScalar(src[j]);
+        }
+    }
+
+    void WriteVertexRowScalar(const f32* heights, i32 heightStride, const XMFLOAT3* normals,
+                              i32 first, i32 last, f32 x0, f32 dx, f32 z, f32 width, f32 depth, f32* dst)
+    {
+        f32 v = 0.5f - z / depth;
+        dst += (size_t)first * 8;
+        for (i32 j = first; j < last; ++j, dst += 8)
+        {
+            f32 x = x0 + j * dx;
+            dst[0] = x;
+            dst[1] = heights[(size_t)j * heightStride];
+            dst[2] = z;
+            dst[3] = normals[j].x;
+            dst[4] = normals[j].y;
+            dst[5] = normals[j].z;
+            dst[6] = 0.5f + x / width;
+            dst[7] = v;
+        }
+    }
+
+    void NormalScalar(f32 l, f32 r, f32 t, f32 b, f32 twoDx, XMFLOAT3& normal, XMFLOAT3& tangent)
+    {
+        f32 nx = l - r;
+        f32 nz = b - t;
+        f32 nLen = sqrtf(nx * nx + twoDx * twoDx + nz * nz);
+        normal = XMFLOAT3(nx / nLen, twoDx / nLen, nz / nLen);
+
+        f32 ty = r - l;
+        f32 tLen = sqrtf(twoDx * twoDx + ty * ty);
+        tangent = XMFLOAT3(twoDx / tLen, ty / tLen, 0.0f);
+    }
+
+    void NormalRowScalar(const f32* up, const f32* mid, const f32* down, i32 n, f32 spatialStep,
+                         XMFLOAT3* normals, XMFLOAT3* tangents)
+    {
+        f32 twoDx = 2.0f * spatialStep;
+        for (i32 j = 1; j < n - 1; ++j)
+        {
+            NormalScalar(mid[j - 1], mid[j + 1], up[j], down[j], twoDx, normals[j], tangents[j]);
+        }
+    }
+
+    // Scatters lanes of the component vectors computed by the SIMD normal
+    // kernels into the interleaved XMFLOAT3 outputs.
+    void StoreNormals(const f32* nx, const f32* ny, const f32* nz, const f32* tx, const f32* ty,
+                      i32 count, XMFLOAT3* normals, XMFLOAT3* tangents)
+    {
+        for (i32 k = 0; k < count; ++k)
+        {
+            normals[k]  = XMFLOAT3(nx[k], ny[k], nz[k]);
+            tangents[k] = XMFLOAT3(tx[k], ty[k], 0.0f);
+        }
+    }
+
+    f32 MaxAbsRowScalar(const f32* row, i32 n)
+    {
+        f32 m = 0.0f;
+        for (i32 j = 0; j < n; ++j)
+        {
+            m = std::max(m, fabsf(row[j]));
+        }
+        return m;
+    }
+
+    void StencilRowScalar(f32* prev, const f32* curr, const f32* up, const f32* down,
+                          i32 n, f32 k1, f32 k2, f32 k3)
+    {
+        for (i32 j = 1; j < n - 1; ++j)
+        {
+            prev[j] = k1 * prev[j] + k2 * curr[j] + k3 * (down[j] + up[j] + curr[j + 1] + curr[j - 1]);
+        }
+    }
+
+    // Lane j of the FFT butterflies; also the tail of the SIMD versions.
+    void FftRadix2Lane(const WavesKernels::FftRow* in, const WavesKernels::FftRow* out, const f32* w, i32 j)
+    {
+        f32 ar = in[0].Re[j], ai = in[0].Im[j];
+        f32 br = in[1].Re[j], bi = in[1].Im[j];
+        f32 dr = ar - br;
+        f32 di = ai - bi;
+        out[0].Re[j] = ar + br;
+        out[0].Im[j] = ai + bi;
+        out[1].Re[j] = w[0] * dr - w[1] * di;
+        out[1].Im[j] = w[0] * di + w[1] * dr;
+    }
+
+    void FftRadix4Lane(const WavesKernels::FftRow* in, const WavesKernels::FftRow* out, const f32* w, f32 jSign, i32 j)
+    {
+        f32 ar = in[0].Re[j], ai = in[0].Im[j];
+        f32 br = in[1].Re[j], bi = in[1].Im[j];
+        f32 cr = in[2].Re[j], ci = in[2].Im[j];
+        f32 dr = in[3].Re[j], di = in[3].Im[j];
+
+        f32 apcR = ar + cr, apcI = ai + ci;
+        f32 amcR = ar - cr, amcI = ai - ci;
+        f32 bpdR = br + dr, bpdI = bi + di;
+        f32 bmdR = br - dr, bmdI = bi - di;
+
+        // J (b - d) with J = jSign * i.
+        f32 jR = -jSign * bmdI;
+        f32 jI = jSign * bmdR;
+
+        f32 u1R = amcR + jR, u1I = amcI + jI;
+        f32 u2R = apcR - bpdR, u2I = apcI - bpdI;
+        f32 u3R = amcR - jR, u3I = amcI - jI;
+
+        out[0].Re[j] = apcR + bpdR;
+        out[0].Im[j] = apcI + bpdI;
+        out[1].Re[j] = w[0] * u1R - w[1] * u1I;
+        out[1].Im[j] = w[0] * u1I + w[1] * u1R;
+        out[2].Re[j] = w[2] * u2R - w[3] * u2I;
+        out[2].Im[j] = w[2] * u2I + w[3] * u2R;
+        out[3].Re[j] = w[4] * u3R - w[5] * u3I;
+        out[3].Im[j] = w[4] * u3I + w[5] * u3R;
+    }
+
+    void FftRadix2Scalar(const WavesKernels::FftRow* in, const WavesKernels::FftRow* out, const f32* w, i32 n)
+    {
+        for (i32 j = 0; j < n; ++j)
+        {
+            FftRadix2Lane(in, out, w, j);
+        }
+    }
+
+    void FftRadix4Scalar(const WavesKernels::FftRow* in, const WavesKernels::FftRow* out, const f32* w, f32 jSign, i32 n)
+    {
+        for (i32 j = 0; j < n; ++j)
+        {
+            FftRadix4Lane(in, out, w, jSign, j);
+        }
+    }
+
+#if WAVES_KERNELS_X86
+    void StencilRowSSE(f32* prev, const f32* curr, const f32* up, const f32* down,
+                       i32 n, f32 k1, f32 k2, f32 k3)
+    {
+        const __m128 K1 = _mm_set1_ps(k1);
+        const __m128 K2 = _mm_set1_ps(k2);
+        const __m128 K3 = _mm_set1_ps(k3);
+
+        // Two 4-wide halves per iteration so the SSE path walks the row in the
+        // same 8-column steps as the AVX2 path.
+        i32 j = 1;
+        for (; j + 8 <= n - 1; j += 8)
+        {
+            for (i32 h = 0; h < 8; h += 4)
+            {
+                __m128 p = _mm_loadu_ps(prev + j + h);
+                __m128 c = _mm_loadu_ps(curr + j + h);
+                __m128 s = _mm_add_ps(_mm_loadu_ps(down + j + h), _mm_loadu_ps(up + j + h));
+                s = _mm_add_ps(s, _mm_loadu_ps(curr + j + h + 1));
+                s = _mm_add_ps(s, _mm_loadu_ps(curr + j + h - 1));
+                __m128 r = _mm_add_ps(_mm_mul_ps(K1, p), _mm_mul_ps(K2, c));
+                r = _mm_add_ps(r, _mm_mul_ps(K3, s));
+                _mm_storeu_ps(prev + j + h, r);
+            }
+        }
+
+        for (; j < n - 1; ++j)
+        {
+            prev[j] = k1 * prev[j] + k2 * curr[j] + k3 * (down[j] + up[j] + curr[j + 1] + curr[j - 1]);
+        }
+    }
+
+    void NormalRowSSE(const f32* up, const f32* mid, const f32* down, i32 n, f32 spatialStep,
+                      XMFLOAT3* normals, XMFLOAT3* tangents)
+    {
+        f32 twoDx = 2.0f * spatialStep;
+        const __m128 TwoDx = _mm_set1_ps(twoDx);
+        const __m128 TwoDxSq = _mm_set1_ps(twoDx * twoDx);
+
+        alignas(16) f32 nx[4], ny[4], nz[4], tx[4], ty[4];
+
+        i32 j = 1;
+        for (; j + 4 <= n - 1; j += 4)
+        {
+            __m128 l = _mm_loadu_ps(mid + j - 1);
+            __m128 r = _mm_loadu_ps(mid + j + 1);
+            __m128 x = _mm_sub_ps(l, r);
+            __m128 z = _mm_sub_ps(_mm_loadu_ps(down + j), _mm_loadu_ps(up + j));
+
+            __m128 nLen = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), TwoDxSq), _mm_mul_ps(z, z));
+            nLen = _mm_sqrt_ps(nLen);
+            _mm_store_ps(nx, _mm_div_ps(x, nLen));
+            _mm_store_ps(ny, _mm_div_ps(TwoDx, nLen));
+            _mm_store_ps(nz, _mm_div_ps(z, nLen));
+
+            __m128 y = _mm_sub_ps(r, l);
+            __m128 tLen = _mm_sqrt_ps(_mm_add_ps(TwoDxSq, _mm_mul_ps(y, y)));
+            _mm_store_ps(tx, _mm_div_ps(TwoDx, tLen));
+            _mm_store_ps(ty, _mm_div_ps(y, tLen));
+
+            StoreNormals(nx, ny, nz, tx, ty, 4, normals + j, tangents + j);
+        }
+
+        for (; j < n - 1; ++j)
+        {
+            NormalScalar(mid[j - 1], mid[j + 1], up[j], down[j], twoDx, normals[j], tangents[j]);
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void NormalRowAVX2(const f32* up, const f32* mid, const f32* down, i32 n, f32 spatialStep,
+                       XMFLOAT3* normals, XMFLOAT3* tangents)
+    {
+        f32 twoDx = 2.0f * spatialStep;
+        const __m256 TwoDx = _mm256_set1_ps(twoDx);
+        const __m256 TwoDxSq = _mm256_set1_ps(twoDx * twoDx);
+
+        alignas(32) f32 nx[8], ny[8], nz[8], tx[8], ty[8];
+
+        i32 j = 1;
+        for (; j + 8 <= n - 1; j += 8)
+        {
+            __m256 l = _mm256_loadu_ps(mid + j - 1);
+            __m256 r = _mm256_loadu_ps(mid + j + 1);
+            __m256 x = _mm256_sub_ps(l, r);
+            __m256 z = _mm256_sub_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+
+            __m256 nLen = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), TwoDxSq), _mm256_mul_ps(z, z));
+            nLen = _mm256_sqrt_ps(nLen);
+            _mm256_store_ps(nx, _mm256_div_ps(x, nLen));
+            _mm256_store_ps(ny, _mm256_div_ps(TwoDx, nLen));
+            _mm256_store_ps(nz, _mm256_div_ps(z, nLen));
+
+            __m256 y = _mm256_sub_ps(r, l);
+            __m256 tLen = _mm256_sqrt_ps(_mm256_add_ps(TwoDxSq, _mm256_mul_ps(y, y)));
+            _mm256_store_ps(tx, _mm256_div_ps(TwoDx, tLen));
+            _mm256_store_ps(ty, _mm256_div_ps(y, tLen));
+
+            StoreNormals(nx, ny, nz, tx, ty, 8, normals + j, tangents + j);
+        }
+
+        for (; j < n - 1; ++j)
+        {
+            NormalScalar(mid[j - 1], mid[j + 1], up[j], down[j], twoDx, normals[j], tangents[j]);
+        }
+    }
+
+    void WriteVertexRowSSE(const f32* heights, i32 heightStride, const XMFLOAT3* normals,
+                           i32 first, i32 last, f32 x0, f32 dx, f32 z, f32 width, f32 depth, f32* dst)
+    {
+        if (((uintptr_t)dst & 15) != 0)
+        {
+            WriteVertexRowScalar(heights, heightStride, normals, first, last, x0, dx, z, width, depth, dst);
+            return;
+        }
+
+        f32 v = 0.5f - z / depth;
+        dst += (size_t)first * 8;
+        for (i32 j = first; j < last; ++j, dst += 8)
+        {
+            f32 x = x0 + j * dx;
+            const XMFLOAT3& nrm = normals[j];
+            _mm_stream_ps(dst,     _mm_setr_ps(x, heights[(size_t)j * heightStride], z, nrm.x));
+            _mm_stream_ps(dst + 4, _mm_setr_ps(nrm.y, nrm.z, 0.5f + x / width, v));
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void WriteVertexRowAVX2(const f32* heights, i32 heightStride, const XMFLOAT3* normals,
+                            i32 first, i32 last, f32 x0, f32 dx, f32 z, f32 width, f32 depth, f32* dst)
+    {
+        if (((uintptr_t)dst & 31) != 0)
+        {
+            WriteVertexRowSSE(heights, heightStride, normals, first, last, x0, dx, z, width, depth, dst);
+            return;
+        }
+
+        const __m256 X0 = _mm256_set1_ps(x0);
+        const __m256 Dx = _mm256_set1_ps(dx);
+        const __m256 Half = _mm256_set1_ps(0.5f);
+        const __m256 Width = _mm256_set1_ps(width);
+        const __m256 Lane = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+
+        f32 v = 0.5f - z / depth;
+        alignas(32) f32 xs[8], us[8];
+
+        // x and u for eight columns at a time; each vertex is then one 32-byte
+        // non-temporal store.
+        dst += (size_t)first * 8;
+        i32 j = first;
+        for (; j + 8 <= last; j += 8)
+        {
+            __m256 jf = _mm256_add_ps(_mm256_set1_ps((f32)j), Lane);
+            __m256 x = _mm256_add_ps(X0, _mm256_mul_ps(jf, Dx));
+            _mm256_store_ps(xs, x);
+            _mm256_store_ps(us, _mm256_add_ps(Half, _mm256_div_ps(x, Width)));
+
+            for (i32 k = 0; k < 8; ++k, dst += 8)
+            {
+                const XMFLOAT3& nrm = normals[j + k];
+                _mm256_stream_ps(dst, _mm256_setr_ps(xs[k], heights[(size_t)(j + k) * heightStride], z,
+                    nrm.x, nrm.y, nrm.z, us[k], v));
+            }
+        }
+
+        for (; j < last; ++j, dst += 8)
+        {
+            f32 x = x0 + j * dx;
+            const XMFLOAT3& nrm = normals[j];
+            _mm256_stream_ps(dst, _mm256_setr_ps(x, heights[(size_t)j * heightStride], z,
+                nrm.x, nrm.y, nrm.z, 0.5f + x / width, v));
+        }
+    }
+
+    f32 MaxAbsRowSSE(const f32* row, i32 n)
+    {
+        const __m128 AbsMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 m = _mm_setzero_ps();
+
+        i32 j = 0;
+        for (; j + 4 <= n; j += 4)
+        {
+            m = _mm_max_ps(m, _mm_and_ps(_mm_loadu_ps(row + j), AbsMask));
+        }
+
+        alignas(16) f32 lanes[4];
+        _mm_store_ps(lanes, m);
+        f32 result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        for (; j < n; ++j)
+        {
+            result = std::max(result, fabsf(row[j]));
+        }
+        return result;
+    }
+
+    WAVES_TARGET_AVX2
+    f32 MaxAbsRowAVX2(const f32* row, i32 n)
+    {
+        const __m256 AbsMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        __m256 m = _mm256_setzero_ps();
+
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            m = _mm256_max_ps(m, _mm256_and_ps(_mm256_loadu_ps(row + j), AbsMask));
+        }
+
+        __m128 half = _mm_max_ps(_mm256_castps256_ps128(m), _mm256_extractf128_ps(m, 1));
+        alignas(16) f32 lanes[4];
+        _mm_store_ps(lanes, half);
+        f32 result = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+        for (; j < n; ++j)
+        {
+            result = std::max(result, fabsf(row[j]));
+        }
+        return result;
+    }
+
+    void FloatToFixedRowSSE(const f32* src, i32 n, f32 step, i16* dst)
+    {
+        f32 invStep = 1.0f / step;
+        const __m128 InvStep = _mm_set1_ps(invStep);
+        const __m128 Lo = _mm_set1_ps(-32767.0f);
+        const __m128 Hi = _mm_set1_ps(32767.0f);
+
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            __m128 a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + j), InvStep), Lo), Hi);
+            __m128 b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_loadu_ps(src + j + 4), InvStep), Lo), Hi);
+            __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+            _mm_storeu_si128((__m128i*)(dst + j), packed);
+        }
+
+        for (; j < n; ++j)
+        {
+            dst[j] = FloatToFixedScalar(src[j], invStep);
+        }
+    }
+
+    void FixedToFloatRowSSE(const i16* src, i32 n, f32 step, f32* dst)
+    {
+        const __m128 Step = _mm_set1_ps(step);
+
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            // Sign-extend by unpacking into the high halves and shifting back down.
+            __m128i v = _mm_loadu_si128((const __m128i*)(src + j));
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            _mm_storeu_ps(dst + j, _mm_mul_ps(_mm_cvtepi32_ps(lo), Step));
+            _mm_storeu_ps(dst + j + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), Step));
+        }
+
+        for (; j < n; ++j)
+        {
+            dst[j] = (f32)src[j] * step;
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void FloatToHalfRowAVX2(const f32* src, i32 n, u16* dst)
+    {
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(src + j), _MM_FROUND_TO_NEAREST_INT);
+            _mm_storeu_si128((__m128i*)(dst + j), h);
+        }
+
+        for (; j < n; ++j)
+        {
+            dst[j] = FloatToHalfScalar(src[j]);
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void HalfToFloatRowAVX2(const u16* src, i32 n, f32* dst)
+    {
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            _mm256_storeu_ps(dst + j, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + j))));
+        }
+
+        for (; j < n; ++j)
+        {
+            dst[j] = HalfToFloatScalar(src[j]);
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void FloatToFixedRowAVX2(const f32* src, i32 n, f32 step, i16* dst)
+    {
+        f32 invStep = 1.0f / step;
+        const __m256 InvStep = _mm256_set1_ps(invStep);
+        const __m256 Lo = _mm256_set1_ps(-32767.0f);
+        const __m256 Hi = _mm256_set1_ps(32767.0f);
+
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            __m256 v = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(src + j), InvStep), Lo), Hi);
+            __m256i q = _mm256_cvtps_epi32(v);
+            __m128i packed = _mm_packs_epi32(_mm256_castsi256_si128(q), _mm256_extracti128_si256(q, 1));
+            _mm_storeu_si128((__m128i*)(dst + j), packed);
+        }
+
+        for (; j < n; ++j)
+        {
+            dst[j] = FloatToFixedScalar(src[j], invStep);
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void FixedToFloatRowAVX2(const i16* src, i32 n, f32 step, f32* dst)
+    {
+        const __m256 Step = _mm256_set1_ps(step);
+
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            __m256i v = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i*)(src + j)));
+            _mm256_storeu_ps(dst + j, _mm256_mul_ps(_mm256_cvtepi32_ps(v), Step));
+        }
+
+        for (; j < n; ++j)
+        {
+            dst[j] = (f32)src[j] * step;
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void NormalRowOctAVX2(const f32* up, const f32* mid, const f32* down, i32 n, f32 spatialStep, u16* normals)
+    {
+        f32 twoDx = 2.0f * spatialStep;
+        const __m256 TwoDx = _mm256_set1_ps(twoDx);
+        const __m256 AbsMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        const __m256 Scale = _mm256_set1_ps(127.0f);
+        const __m256i ByteMask = _mm256_set1_epi32(0xff);
+
+        // y = 2*dx is always positive, so the lower-hemisphere fold never applies.
+        i32 j = 1;
+        for (; j + 8 <= n - 1; j += 8)
+        {
+            __m256 x = _mm256_sub_ps(_mm256_loadu_ps(mid + j - 1), _mm256_loadu_ps(mid + j + 1));
+            __m256 z = _mm256_sub_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+            __m256 s = _mm256_add_ps(_mm256_add_ps(_mm256_and_ps(x, AbsMask), TwoDx), _mm256_and_ps(z, AbsMask));
+
+            __m256i u = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_div_ps(x, s), Scale));
+            __m256i v = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_div_ps(z, s), Scale));
+            __m256i packed = _mm256_or_si256(_mm256_and_si256(u, ByteMask),
+                _mm256_slli_epi32(_mm256_and_si256(v, ByteMask), 8));
+
+            __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+            _mm_storeu_si128((__m128i*)(normals + j), words);
+        }
+
+        for (; j < n - 1; ++j)
+        {
+            normals[j] = EncodeOctScalar(mid[j - 1] - mid[j + 1], twoDx, down[j] - up[j]);
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void EncodeOctRowAVX2(const XMFLOAT3* src, i32 n, u16* dst)
+    {
+        const __m256 AbsMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        const __m256 Zero = _mm256_setzero_ps();
+        const __m256 One = _mm256_set1_ps(1.0f);
+        const __m256 MinusOne = _mm256_set1_ps(-1.0f);
+        const __m256 Scale = _mm256_set1_ps(127.0f);
+        const __m256i ByteMask = _mm256_set1_epi32(0xff);
+
+        alignas(32) f32 xs[8], ys[8], zs[8];
+
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            for (i32 k = 0; k < 8; ++k)
+            {
+                xs[k] = src[j + k].x;
+                ys[k] = src[j + k].y;
+                zs[k] = src[j + k].z;
+            }
+
+            __m256 x = _mm256_load_ps(xs);
+            __m256 y = _mm256_load_ps(ys);
+            __m256 z = _mm256_load_ps(zs);
+            __m256 s = _mm256_add_ps(_mm256_add_ps(_mm256_and_ps(x, AbsMask), _mm256_and_ps(y, AbsMask)),
+                _mm256_and_ps(z, AbsMask));
+
+            __m256 u = _mm256_div_ps(x, s);
+            __m256 v = _mm256_div_ps(z, s);
+
+            // Fold the lower hemisphere; the signs come from comparisons so that
+            // -0 counts as positive, like the scalar path.
+            __m256 fold = _mm256_cmp_ps(y, Zero, _CMP_LT_OQ);
+            __m256 su = _mm256_blendv_ps(One, MinusOne, _mm256_cmp_ps(u, Zero, _CMP_LT_OQ));
+            __m256 sv = _mm256_blendv_ps(One, MinusOne, _mm256_cmp_ps(v, Zero, _CMP_LT_OQ));
+            __m256 fu = _mm256_mul_ps(_mm256_sub_ps(One, _mm256_and_ps(v, AbsMask)), su);
+            __m256 fv = _mm256_mul_ps(_mm256_sub_ps(One, _mm256_and_ps(u, AbsMask)), sv);
+            u = _mm256_blendv_ps(u, fu, fold);
+            v = _mm256_blendv_ps(v, fv, fold);
+
+            __m256i qu = _mm256_cvtps_epi32(_mm256_mul_ps(u, Scale));
+            __m256i qv = _mm256_cvtps_epi32(_mm256_mul_ps(v, Scale));
+            __m256i packed = _mm256_or_si256(_mm256_and_si256(qu, ByteMask),
+                _mm256_slli_epi32(_mm256_and_si256(qv, ByteMask), 8));
+
+            // A zero vector encodes as 0.
+            packed = _mm256_andnot_si256(_mm256_castps_si256(_mm256_cmp_ps(s, Zero, _CMP_EQ_OQ)), packed);
+
+            __m128i words = _mm_packus_epi32(_mm256_castsi256_si128(packed), _mm256_extracti128_si256(packed, 1));
+            _mm_storeu_si128((__m128i*)(dst + j), words);
+        }
+
+        for (; j < n; ++j)
+        {
+            dst[j] = EncodeOctScalar(src[j].x, src[j].y, src[j].z);
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void DecodeOctRowAVX2(const u16* src, i32 n, XMFLOAT3* dst)
+    {
+        const __m256 AbsMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+        const __m256 SignMask = _mm256_castsi256_ps(_mm256_set1_epi32((i32)0x80000000u));
+        const __m256 One = _mm256_set1_ps(1.0f);
+        const __m256 Scale = _mm256_set1_ps(127.0f);
+        const __m256i MinSnorm = _mm256_set1_epi32(-127);
+
+        alignas(32) f32 xs[8], ys[8], zs[8];
+
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            // Sign-extend the low and high bytes of each word.
+            __m256i w = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src + j)));
+            __m256i lo = _mm256_max_epi32(_mm256_srai_epi32(_mm256_slli_epi32(w, 24), 24), MinSnorm);
+            __m256i hi = _mm256_max_epi32(_mm256_srai_epi32(_mm256_slli_epi32(w, 16), 24), MinSnorm);
+            __m256 u = _mm256_div_ps(_mm256_cvtepi32_ps(lo), Scale);
+            __m256 v = _mm256_div_ps(_mm256_cvtepi32_ps(hi), Scale);
+
+            __m256 au = _mm256_and_ps(u, AbsMask);
+            __m256 av = _mm256_and_ps(v, AbsMask);
+            __m256 y = _mm256_sub_ps(_mm256_sub_ps(One, au), av);
+
+            // Unfold the lower hemisphere: (1 - |v|, 1 - |u|) with the signs of (u, v).
+            __m256 fold = _mm256_cmp_ps(y, _mm256_setzero_ps(), _CMP_LT_OQ);
+            __m256 fx = _mm256_or_ps(_mm256_and_ps(u, SignMask), _mm256_sub_ps(One, av));
+            __m256 fz = _mm256_or_ps(_mm256_and_ps(v, SignMask), _mm256_sub_ps(One, au));
+            __m256 x = _mm256_blendv_ps(u, fx, fold);
+            __m256 z = _mm256_blendv_ps(v, fz, fold);
+
+            __m256 len = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z));
+            len = _mm256_sqrt_ps(len);
+            _mm256_store_ps(xs, _mm256_div_ps(x, len));
+            _mm256_store_ps(ys, _mm256_div_ps(y, len));
+            _mm256_store_ps(zs, _mm256_div_ps(z, len));
+
+            for (i32 k = 0; k < 8; ++k)
+            {
+                dst[j + k] = XMFLOAT3(xs[k], ys[k], zs[k]);
+            }
+        }
+
+        for (; j < n; ++j)
+        {
+            dst[j] = DecodeOctScalar(src[j]);
+        }
+    }
+
+    WAVES_TARGET_AVX2
+    void StencilRowAVX2(f32* prev, const f32* curr, const f32* up, const f32* down,
+                        i32 n, f32 k1, f32 k2, f32 k3)
+    {
+        const __m256 K1 = _mm256_set1_ps(k1);
+        const __m256 K2 = _mm256_set1_ps(k2);
+        const __m256 K3 = _mm256_set1_ps(k3);
+
+        // Eight columns per instruction. The additions are kept in the same order
+        // as the scalar kernel so every path produces bit-identical results.
+        i32 j = 1;
+        for (; j + 8 <= n - 1; j += 8)
+        {
+            __m256 p = _mm256_loadu_ps(prev + j);
+            __m256 c = _mm256_loadu_ps(curr + j);
+            __m256 s = _mm256_add_ps(_mm256_loadu_ps(down + j), _mm256_loadu_ps(up + j));
+            s = _mm256_add_ps(s, _mm256_loadu_ps(curr + j + 1));
+            s = _mm256_add_ps(s, _mm256_loadu_ps(curr + j - 1));
+            __m256 r = _mm256_add_ps(_mm256_mul_ps(K1, p), _mm256_mul_ps(K2, c));
+            r = _mm256_add_ps(r, _mm256_mul_ps(K3, s));
+            _mm256_storeu_ps(prev + j, r);
+        }
+
+        for (; j < n - 1; ++j)
+        {
+            prev[j] = k1 * prev[j] + k2 * curr[j] + k3 * (down[j] + up[j] + curr[j + 1] + curr[j - 1]);
+        }
+    }
+
+    // Complex multiply of the twiddle (wr, wi) with lanes (ur, ui), in the
+    // same operation order as the scalar lane.
+    inline void ComplexMulSSE(__m128 wr, __m128 wi, __m128 ur, __m128 ui, __m128& outR, __m128& outI)
+    {
+        outR = _mm_sub_ps(_mm_mul_ps(wr, ur), _mm_mul_ps(wi, ui));
+        outI = _mm_add_ps(_mm_mul_ps(wr, ui), _mm_mul_ps(wi, ur));
+    }
+
+    void FftRadix2SSE(const WavesKernels::FftRow* in, const WavesKernels::FftRow* out, const f32* w, i32 n)
+    {
+        const __m128 wr = _mm_set1_ps(w[0]);
+        const __m128 wi = _mm_set1_ps(w[1]);
+
+        i32 j = 0;
+        for (; j + 4 <= n; j += 4)
+        {
+            __m128 ar = _mm_loadu_ps(in[0].Re + j), ai = _mm_loadu_ps(in[0].Im + j);
+            __m128 br = _mm_loadu_ps(in[1].Re + j), bi = _mm_loadu_ps(in[1].Im + j);
+            __m128 r, i;
+            ComplexMulSSE(wr, wi, _mm_sub_ps(ar, br), _mm_sub_ps(ai, bi), r, i);
+            _mm_storeu_ps(out[0].Re + j, _mm_add_ps(ar, br));
+            _mm_storeu_ps(out[0].Im + j, _mm_add_ps(ai, bi));
+            _mm_storeu_ps(out[1].Re + j, r);
+            _mm_storeu_ps(out[1].Im + j, i);
+        }
+
+        for (; j < n; ++j)
+        {
+            FftRadix2Lane(in, out, w, j);
+        }
+    }
+
+    void FftRadix4SSE(const WavesKernels::FftRow* in, const WavesKernels::FftRow* out, const f32* w, f32 jSign, i32 n)
+    {
+        const __m128 w1r = _mm_set1_ps(w[0]), w1i = _mm_set1_ps(w[1]);
+        const __m128 w2r = _mm_set1_ps(w[2]), w2i = _mm_set1_ps(w[3]);
+        const __m128 w3r = _mm_set1_ps(w[4]), w3i = _mm_set1_ps(w[5]);
+        const __m128 js = _mm_set1_ps(jSign);
+        const __m128 negJs = _mm_set1_ps(-jSign);
+
+        i32 j = 0;
+        for (; j + 4 <= n; j += 4)
+        {
+            __m128 ar = _mm_loadu_ps(in[0].Re + j), ai = _mm_loadu_ps(in[0].Im + j);
+            __m128 br = _mm_loadu_ps(in[1].Re + j), bi = _mm_loadu_ps(in[1].Im + j);
+            __m128 cr = _mm_loadu_ps(in[2].Re + j), ci = _mm_loadu_ps(in[2].Im + j);
+            __m128 dr = _mm_loadu_ps(in[3].Re + j), di = _mm_loadu_ps(in[3].Im + j);
+
+            __m128 apcR = _mm_add_ps(ar, cr), apcI = _mm_add_ps(ai, ci);
+            __m128 amcR = _mm_sub_ps(ar, cr), amcI = _mm_sub_ps(ai, ci);
+            __m128 bpdR = _mm_add_ps(br, dr), bpdI = _mm_add_ps(bi, di);
+            __m128 bmdR = _mm_sub_ps(br, dr), bmdI = _mm_sub_ps(bi, di);
+
+            __m128 jR = _mm_mul_ps(negJs, bmdI);
+            __m128 jI = _mm_mul_ps(js, bmdR);
+
+            __m128 r, i;
+            _mm_storeu_ps(out[0].Re + j, _mm_add_ps(apcR, bpdR));
+            _mm_storeu_ps(out[0].Im + j, _mm_add_ps(apcI, bpdI));
+            ComplexMulSSE(w1r, w1i, _mm_add_ps(amcR, jR), _mm_add_ps(amcI, jI), r, i);
+            _mm_storeu_ps(out[1].Re + j, r);
+            _mm_storeu_ps(out[1].Im + j, i);
+            ComplexMulSSE(w2r, w2i, _mm_sub_ps(apcR, bpdR), _mm_sub_ps(apcI, bpdI), r, i);
+            _mm_storeu_ps(out[2].Re + j, r);
+            _mm_storeu_ps(out[2].Im + j, i);
+            ComplexMulSSE(w3r, w3i, _mm_sub_ps(amcR, jR), _mm_sub_ps(amcI, jI), r, i);
+            _mm_storeu_ps(out[3].Re + j, r);
+            _mm_storeu_ps(out[3].Im + j, i);
+        }
+
+        for (; j < n; ++j)
+        {
+            FftRadix4Lane(in, out, w, jSign, j);
+        }
+    }
+
+    WAVES_TARGET_AVX2 inline void ComplexMulAVX2(__m256 wr, __m256 wi, __m256 ur, __m256 ui, __m256& outR, __m256& outI)
+    {
+        outR = _mm256_sub_ps(_mm256_mul_ps(wr, ur), _mm256_mul_ps(wi, ui));
+        outI = _mm256_add_ps(_mm256_mul_ps(wr, ui), _mm256_mul_ps(wi, ur));
+    }
+
+    WAVES_TARGET_AVX2 void FftRadix2AVX2(const WavesKernels::FftRow* in, const WavesKernels::FftRow* out, const f32* w, i32 n)
+    {
+        const __m256 wr = _mm256_set1_ps(w[0]);
+        const __m256 wi = _mm256_set1_ps(w[1]);
+
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            __m256 ar = _mm256_loadu_ps(in[0].Re + j), ai = _mm256_loadu_ps(in[0].Im + j);
+            __m256 br = _mm256_loadu_ps(in[1].Re + j), bi = _mm256_loadu_ps(in[1].Im + j);
+            __m256 r, i;
+            ComplexMulAVX2(wr, wi, _mm256_sub_ps(ar, br), _mm256_sub_ps(ai, bi), r, i);
+            _mm256_storeu_ps(out[0].Re + j, _mm256_add_ps(ar, br));
+            _mm256_storeu_ps(out[0].Im + j, _mm256_add_ps(ai, bi));
+            _mm256_storeu_ps(out[1].Re + j, r);
+            _mm256_storeu_ps(out[1].Im + j, i);
+        }
+
+        for (; j < n; ++j)
+        {
+            FftRadix2Lane(in, out, w, j);
+        }
+    }
+
+    WAVES_TARGET_AVX2 void FftRadix4AVX2(const WavesKernels::FftRow* in, const WavesKernels::FftRow* out, const f32* w, f32 jSign, i32 n)
+    {
+        const __m256 w1r = _mm256_set1_ps(w[0]), w1i = _mm256_set1_ps(w[1]);
+        const __m256 w2r = _mm256_set1_ps(w[2]), w2i = _mm256_set1_ps(w[3]);
+        const __m256 w3r = _mm256_set1_ps(w[4]), w3i = _mm256_set1_ps(w[5]);
+        const __m256 js = _mm256_set1_ps(jSign);
+        const __m256 negJs = _mm256_set1_ps(-jSign);
+
+        i32 j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            __m256 ar = _mm256_loadu_ps(in[0].Re + j), ai = _mm256_loadu_ps(in[0].Im + j);
+            __m256 br = _mm256_loadu_ps(in[1].Re + j), bi = _mm256_loadu_ps(in[1].Im + j);
+            __m256 cr = _mm256_loadu_ps(in[2].Re + j), ci = _mm256_loadu_ps(in[2].Im + j);
+            __m256 dr = _mm256_loadu_ps(in[3].Re + j), di = _mm256_loadu_ps(in[3].Im + j);
+
+            __m256 apcR = _mm256_add_ps(ar, cr), apcI = _mm256_add_ps(ai, ci);
+            __m256 amcR = _mm256_sub_ps(ar, cr), amcI = _mm256_sub_ps(ai, ci);
+            __m256 bpdR = _mm256_add_ps(br, dr), bpdI = _mm256_add_ps(bi, di);
+            __m256 bmdR = _mm256_sub_ps(br, dr), bmdI = _mm256_sub_ps(bi, di);
+
+            __m256 jR = _mm256_mul_ps(negJs, bmdI);
+            __m256 jI = _mm256_mul_ps(js, bmdR);
+
+            __m256 r, i;
+            _mm256_storeu_ps(out[0].Re + j, _mm256_add_ps(apcR, bpdR));
+            _mm256_storeu_ps(out[0].Im + j, _mm256_add_ps(apcI, bpdI));
+            ComplexMulAVX2(w1r, w1i, _mm256_add_ps(amcR, jR), _mm256_add_ps(amcI, jI), r, i);
+            _mm256_storeu_ps(out[1].Re + j, r);
+            _mm256_storeu_ps(out[1].Im + j, i);
+            ComplexMulAVX2(w2r, w2i, _mm256_sub_ps(apcR, bpdR), _mm256_sub_ps(apcI, bpdI), r, i);
+            _mm256_storeu_ps(out[2].Re + j, r);
+            _mm256_storeu_ps(out[2].Im + j, i);
+            ComplexMulAVX2(w3r, w3i, _mm256_sub_ps(amcR, jR), _mm256_sub_ps(amcI, jI), r, i);
+            _mm256_storeu_ps(out[3].Re + j, r);
+            _mm256_storeu_ps(out[3].Im + j, i);
+        }
+
+        for (; j < n; ++j)
+        {
+            FftRadix4Lane(in, out, w, jSign, j);
+        }
+    }
+
+    bool CpuHasAvx2()
+    {
+#if defined(_MSC_VER)
+        i32 info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+
+        // AVX needs both CPU support and the OS saving the YMM state.
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        bool avx     = (info[2] & (1 << 28)) != 0;
+        bool f16c    = (info[2] & (1 << 29)) != 0;
+        if (!osxsave || !avx || !f16c || (_xgetbv(0) & 0x6) != 0x6)
+        {
+            return false;
+        }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c");
+#endif
+    }
+#endif
+
+    WavesKernels::Isa DetectIsa()
+    {
+#if WAVES_KERNELS_X86
+        return CpuHasAvx2() ? WavesKernels::Isa::AVX2 : WavesKernels::Isa::SSE;
+#else
+        return WavesKernels::Isa::Scalar;
+#endif
+    }
+
+    struct Dispatch
+    {
+        WavesKernels::Isa Isa = WavesKernels::Isa::Scalar;
+        StencilRowFn StencilRow = &StencilRowScalar;
+        NormalRowFn NormalRow = &NormalRowScalar;
+        VertexRowFn WriteVertexRow = &WriteVertexRowScalar;
+        MaxAbsRowFn MaxAbsRow = &MaxAbsRowScalar;
+        ToHalfRowFn FloatToHalfRow = &FloatToHalfRowScalar;
+        FromHalfRowFn HalfToFloatRow = &HalfToFloatRowScalar;
+        ToFixedRowFn FloatToFixedRow = &FloatToFixedRowScalar;
+        FromFixedRowFn FixedToFloatRow = &FixedToFloatRowScalar;
+        NormalRowOctFn NormalRowOct = &NormalRowOctScalar;
+        EncodeOctRowFn EncodeOctRow = &EncodeOctRowScalar;
+        DecodeOctRowFn DecodeOctRow = &DecodeOctRowScalar;
+        FftRadix2Fn FftRadix2 = &FftRadix2Scalar;
+        FftRadix4Fn FftRadix4 = &FftRadix4Scalar;
+    };
+
+    Dispatch MakeDispatch(WavesKernels::Isa isa)
+    {
+        Dispatch d;
+        d.Isa = isa;
+        switch (isa)
+        {
+#if WAVES_KERNELS_X86
+        case WavesKernels::Isa::AVX2:
+            d.StencilRow = &StencilRowAVX2;
+            d.NormalRow = &NormalRowAVX2;
+            d.WriteVertexRow = &WriteVertexRowAVX2;
+            d.MaxAbsRow = &MaxAbsRowAVX2;
+            d.FloatToHalfRow = &FloatToHalfRowAVX2;
+            d.HalfToFloatRow = &HalfToFloatRowAVX2;
+            d.FloatToFixedRow = &FloatToFixedRowAVX2;
+            d.FixedToFloatRow = &FixedToFloatRowAVX2;
+            d.NormalRowOct = &NormalRowOctAVX2;
+            d.EncodeOctRow = &EncodeOctRowAVX2;
+            d.DecodeOctRow = &DecodeOctRowAVX2;
+            d.FftRadix2 = &FftRadix2AVX2;
+            d.FftRadix4 = &FftRadix4AVX2;
+            break;
+        case WavesKernels::Isa::SSE:
+            d.StencilRow = &StencilRowSSE;
+            d.NormalRow = &NormalRowSSE;
+            d.WriteVertexRow = &WriteVertexRowSSE;
+            d.MaxAbsRow = &MaxAbsRowSSE;
+            d.FloatToFixedRow = &FloatToFixedRowSSE;
+            d.FixedToFloatRow = &FixedToFloatRowSSE;
+            d.FftRadix2 = &FftRadix2SSE;
+            d.FftRadix4 = &FftRadix4SSE;
+            break;
+#endif
+        default:
+            d.Isa = WavesKernels::Isa::Scalar;
+            d.StencilRow = &StencilRowScalar;
+            d.NormalRow = &NormalRowScalar;
+            d.WriteVertexRow = &WriteVertexRowScalar;
+            d.MaxAbsRow = &MaxAbsRowScalar;
+            d.FloatToHalfRow = &FloatToHalfRowScalar;
+            d.HalfToFloatRow = &HalfToFloatRowScalar;
+            d.FloatToFixedRow = &FloatToFixedRowScalar;
+            d.FixedToFloatRow = &FixedToFloatRowScalar;
+            d.NormalRowOct = &NormalRowOctScalar;
+            d.EncodeOctRow = &EncodeOctRowScalar;
+            d.DecodeOctRow = &DecodeOctRowScalar;
+            d.FftRadix2 = &FftRadix2Scalar;
+            d.FftRadix4 = &FftRadix4Scalar;
+            break;
+        }
+        return d;
+    }
+
+    Dispatch& GetDispatch()
+    {
+        static Dispatch dispatch = MakeDispatch(DetectIsa());
+        return dispatch;
+    }
+}
+
+namespace WavesKernels
+{
+    Isa ActiveIsa()
+    {
+        return GetDispatch().Isa;
+    }
+
+    Isa BestIsa()
+    {
+        static const Isa best = DetectIsa();
+        return best;
+    }
+
+    void SetIsa(Isa isa)
+    {
+        if ((u8)isa > (u8)BestIsa())
+        {
+            isa = BestIsa();
+        }
+        GetDispatch() = MakeDispatch(isa);
+    }
+
+    const char* IsaName(Isa isa)
+    {
+        switch (isa)
+        {
+        case Isa::AVX2: return "avx2";
+        case Isa::SSE:  return "sse";
+        default:        return "scalar";
+        }
+    }
+
+    void StencilRow(f32* prev, const f32* curr, const f32* up, const f32* down,
+                    i32 n, f32 k1, f32 k2, f32 k3)
+    {
+        GetDispatch().StencilRow(prev, curr, up, down, n, k1, k2, k3);
+    }
+
+    void NormalRow(const f32* up, const f32* mid, const f32* down, i32 n, f32 spatialStep,
+                   XMFLOAT3* normals, XMFLOAT3* tangents)
+    {
+        GetDispatch().NormalRow(up, mid, down, n, spatialStep, normals, tangents);
+    }
+
+    void WriteVertexRow(const f32* heights, i32 heightStride, const XMFLOAT3* normals,
+                        i32 first, i32 last, f32 x0, f32 dx, f32 z, f32 width, f32 depth, f32* dst)
+    {
+        GetDispatch().WriteVertexRow(heights, heightStride, normals, first, last, x0, dx, z, width, depth, dst);
+    }
+
+    f32 MaxAbsRow(const f32* row, i32 n)
+    {
+        return GetDispatch().MaxAbsRow(row, n);
+    }
+
+    void FloatToHalfRow(const f32* src, i32 n, u16* dst)
+    {
+        GetDispatch().FloatToHalfRow(src, n, dst);
+    }
+
+    void HalfToFloatRow(const u16* src, i32 n, f32* dst)
+    {
+        GetDispatch().HalfToFloatRow(src, n, dst);
+    }
+
+    void FloatToFixedRow(const f32* src, i32 n, f32 step, i16* dst)
+    {
+        GetDispatch().FloatToFixedRow(src, n, step, dst);
+    }
+
+    void FixedToFloatRow(const i16* src, i32 n, f32 step, f32* dst)
+    {
+        GetDispatch().FixedToFloatRow(src, n, step, dst);
+    }
+
+    u16 FloatToHalf(f32 value)
+    {
+        return FloatToHalfScalar(value);
+    }
+
+    f32 HalfToFloat(u16 value)
+    {
+        return HalfToFloatScalar(value);
+    }
+
+    u16 EncodeOct(const XMFLOAT3& normal)
+    {
+        return EncodeOctScalar(normal.x, normal.y, normal.z);
+    }
+
+    XMFLOAT3 DecodeOct(u16 encoded)
+    {
+        return DecodeOctScalar(encoded);
+    }
+
+    void NormalRowOct(const f32* up, const f32* mid, const f32* down, i32 n, f32 spatialStep, u16* normals)
+    {
+        GetDispatch().NormalRowOct(up, mid, down, n, spatialStep, normals);
+    }
+
+    void EncodeOctRow(const XMFLOAT3* src, i32 n, u16* dst)
+    {
+        GetDispatch().EncodeOctRow(src, n, dst);
+    }
+
+    void DecodeOctRow(const u16* src, i32 n, XMFLOAT3* dst)
+    {
+        GetDispatch().DecodeOctRow(src, n, dst);
+    }
+
+    void FftRadix2(const FftRow in[2], const FftRow out[2], const f32 twiddle[2], i32 n)
+    {
+        GetDispatch().FftRadix2(in, out, twiddle, n);
+    }
+
+    void FftRadix4(const FftRow in[4], const FftRow out[4], const f32 twiddles[6], f32 jSign, i32 n)
+    {
+        GetDispatch().FftRadix4(in, out, twiddles, jSign, n);
+    }
+
+    void StreamFence()
+    {
+#if WAVES_KERNELS_X86
+        _mm_sfence();
+#endif
+    }
+}
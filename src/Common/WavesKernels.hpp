@@ -0,0 +1,103 @@
+#pragma once
+
+#include <Common/defines.hpp>
+#include <DirectXMath.h>
+
+// Row kernels for the planar (structure-of-arrays) wave solver. Each kernel works
+// on tightly packed f32 rows so that the inner loops can be vectorized; the
+// widest instruction set supported by the running CPU is selected on first use.
+namespace WavesKernels
+{
+    enum class Isa : u8
+    {
+        Scalar,
+        SSE,
+        AVX2
+    };
+
+    // Instruction set the kernels currently dispatch to.
+    Isa ActiveIsa();
+
+    // Widest instruction set supported by this CPU.
+    Isa BestIsa();
+
+    // Forces the kernels onto a narrower instruction set (useful for comparing
+    // code paths). Requests wider than BestIsa() are clamped.
+    void SetIsa(Isa isa);
+
+    const char* IsaName(Isa isa);
+
+    // Advances one interior row of the height field by one time step:
+    //   prev[j] = k1*prev[j] + k2*curr[j] + k3*(down[j] + up[j] + curr[j+1] + curr[j-1])
+    // for j in [1, n-1). The result overwrites prev, which becomes the next solution.
+    // up/down are the rows above and below curr in the current solution.
+    void StencilRow(f32* prev, const f32* curr, const f32* up, const f32* down,
+                    i32 n, f32 k1, f32 k2, f32 k3);
+
+    // Computes the unit normal and unit x-tangent for columns [1, n-1) of one
+    // interior row from central differences of the surrounding heights. normals
+    // and tangents point at the first element of the row.
+    void NormalRow(const f32* up, const f32* mid, const f32* down, i32 n, f32 spatialStep,
+                   DirectX::XMFLOAT3* normals, DirectX::XMFLOAT3* tangents);
+
+    // Writes columns [first, last) of one grid row as interleaved {Pos, Normal, TexC}
+    // vertices (8 floats each). heights, normals and dst point at column 0. Vertex j
+    // is at (x0 + j*dx, heights[j*heightStride], z) and its TexC maps
+    // [-width/2, width/2] x [depth/2, -depth/2] onto [0, 1]^2.
+    // Full vertices are written with non-temporal stores when dst is aligned, so
+    // write-combined upload memory is filled in whole lines without being read;
+    // call StreamFence() before the data is handed to another thread or the GPU.
+    void WriteVertexRow(const f32* heights, i32 heightStride, const DirectX::XMFLOAT3* normals,
+                        i32 first, i32 last, f32 x0, f32 dx, f32 z, f32 width, f32 depth, f32* dst);
+
+    // Largest |row[j]| for j in [0, n); 0 for an empty row.
+    f32 MaxAbsRow(const f32* row, i32 n);
+
+    // Conversions between f32 rows and the 16-bit height formats of the compact
+    // storage modes. Halves round to nearest even (F16C on the AVX2 path); fixed
+    // point stores round(x / step) saturated to +-32767. Every path produces the
+    // same bits.
+    void FloatToHalfRow(const f32* src, i32 n, u16* dst);
+    void HalfToFloatRow(const u16* src, i32 n, f32* dst);
+    void FloatToFixedRow(const f32* src, i32 n, f32 step, i16* dst);
+    void FixedToFloatRow(const i16* src, i32 n, f32 step, f32* dst);
+
+    u16 FloatToHalf(f32 value);
+    f32 HalfToFloat(u16 value);
+
+    // 16-bit octahedral normal encoding: the direction is projected onto the
+    // octahedron |x| + |y| + |z| = 1, the lower half folded over, and the (x, z)
+    // coordinates stored as two snorm8 values (x in the low byte).
+    u16 EncodeOct(const DirectX::XMFLOAT3& normal);
+    DirectX::XMFLOAT3 DecodeOct(u16 encoded);
+
+    // NormalRow for the compact modes: stores octahedral-encoded normals for
+    // columns [1, n-1) and no tangents. normals points at the first element.
+    void NormalRowOct(const f32* up, const f32* mid, const f32* down, i32 n, f32 spatialStep, u16* normals);
+
+    // Encodes / decodes n octahedral normals.
+    void EncodeOctRow(const DirectX::XMFLOAT3* src, i32 n, u16* dst);
+    void DecodeOctRow(const u16* src, i32 n, DirectX::XMFLOAT3* dst);
+
+    // n complex values in split form, for the FFT butterflies.
+    struct FftRow
+    {
+        f32* Re;
+        f32* Im;
+    };
+
+    // Stockham FFT butterflies applied lane by lane to n values of each row
+    // (see Fft2D). With a..d = in[0..3] and J = jSign * i (jSign = -1 for the
+    // forward transform, +1 for the inverse):
+    //   out[0] = (a + c) + (b + d)
+    //   out[1] = w1 * ((a - c) + J (b - d))
+    //   out[2] = w2 * ((a + c) - (b + d))
+    //   out[3] = w3 * ((a - c) - J (b - d))
+    // twiddles holds w1, w2, w3 as (re, im) pairs. The radix-2 butterfly is
+    // out[0] = a + b, out[1] = w * (a - b). in and out must not overlap.
+    void FftRadix2(const FftRow in[2], const FftRow out[2], const f32 twiddle[2], i32 n);
+    void FftRadix4(const FftRow in[4], const FftRow out[4], const f32 twiddles[6], f32 jSign, i32 n);
+
+    // Orders the calling thread's non-temporal stores before any later stores.
+    void StreamFence();
+}